@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "mutex.h"
+
+/**
+ * @file
+ *
+ * Combining-tree barrier.
+ *
+ * Participants arrive at the leaf of the tree their rank maps to; each
+ * node counts the arrivals of at most BARRIER_FANIN participants or
+ * children, and the last one to arrive at a node carries on to its
+ * parent, so arriving takes O(log n) steps and no counter is shared by
+ * more than BARRIER_FANIN threads.  The thread completing the root
+ * releases the tree top down along the path it came up, and every
+ * winner releases the node it won, so the release fans out in
+ * O(log n) steps as well.
+ *
+ * Every node counts its episodes, which replaces the per-thread sense
+ * of a sense-reversing barrier: a waiter only waits for the episode of
+ * its node to move on.  How it waits is the barrier's policy:
+ * BARRIER_SPIN polls, BARRIER_YIELD polls and then yields to the
+ * backend, BARRIER_PARK polls and then blocks on the node's condition,
+ * which at most BARRIER_FANIN - 1 threads share.
+ */
+
+#define BARRIER_FANIN 4
+
+#define BARRIER_SPIN 0
+#define BARRIER_YIELD 1
+#define BARRIER_PARK 2
+
+/* Returned by barrier_wait to the one thread that completed it */
+#define BARRIER_SERIAL 1
+
+typedef struct barrier_node_t {
+  atomic_int32_t count;
+  int32_t expected;
+  int32_t parent;
+  volatile int32_t episode;
+  /* waiters blocked on cond, under lock */
+  int32_t parked;
+  thread_internal_mutex_t lock;
+  thread_internal_cond_t cond;
+} __attribute__((aligned(64))) barrier_node_t;
+
+typedef struct barrier_t {
+  barrier_node_t *b_nodes;
+  int32_t b_participants;
+  int32_t b_policy;
+} barrier_t;
+
+/**
+ * Initialize a barrier.
+ *
+ * @param barrier       Address of the barrier.
+ * @param participants  Number of participants, at least 1.
+ * @param policy        BARRIER_SPIN, BARRIER_YIELD or BARRIER_PARK.
+ *
+ * @retval SUCCESS              Barrier initialized
+ * @retval ERR_BAD_PARAM        No participant
+ * @retval ERR_OUT_OF_RESOURCE  No memory for the tree
+ */
+DECLSPEC int barrier_init(barrier_t *barrier, int participants, int policy);
+
+/**
+ * Destroy a barrier nobody waits on.
+ */
+DECLSPEC void barrier_destroy(barrier_t *barrier);
+
+/**
+ * Wait until all participants reached the barrier.
+ *
+ * @param barrier       Address of the barrier.
+ * @param rank          Rank of the caller, unique among the
+ *                      participants, in [0, participants).
+ *
+ * @return              BARRIER_SERIAL for one of the participants, 0
+ *                      for the others.
+ */
+DECLSPEC int barrier_wait(barrier_t *barrier, int rank);
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "mutex.h"
+
+/**
+ * @file
+ *
+ * NUMA-aware cohort lock.
+ *
+ * A cohort lock is made of one ticket lock per NUMA node and a global
+ * ticket lock.  A thread first takes the lock of the node it runs on,
+ * then the global lock unless it inherited it.  On release, if another
+ * thread of the same node is queued, the lock and the global lock it
+ * implies are passed to it without touching the global lock, so the
+ * lock and the data it protects stay on one socket.  After
+ * cohort_lock_batch consecutive handoffs within a node the global lock
+ * is released anyway, to give the other nodes their turn.
+ *
+ * The node of each CPU is read from /sys/devices/system/node on first
+ * use; without it every thread is on node 0 and the lock behaves as a
+ * ticket lock.  Waiters spin and then yield to the backend, so the lock
+ * works with every backend.
+ */
+
+/* Nodes told apart, further nodes share the local locks */
+#define COHORT_LOCK_MAX_NODES 8
+
+/* Default batch bound, LIBULT_COHORT_BATCH overrides it */
+#define COHORT_LOCK_BATCH 64
+
+typedef struct {
+  atomic_int32_t next;
+  volatile int32_t serving;
+  /* the holder got the global lock from a thread of this node */
+  int32_t global_owned;
+  /* consecutive handoffs within the node */
+  int32_t batch;
+} __attribute__((aligned(64))) cohort_lock_local_t;
+
+typedef struct cohort_lock_t {
+  object_t super;
+  cohort_lock_local_t c_local[COHORT_LOCK_MAX_NODES];
+  atomic_int32_t c_next;
+  volatile int32_t c_serving;
+  /* local lock the holder acquired through */
+  int32_t c_owner_node;
+  /* handoffs within a node before the global lock is released, 0 for
+   * the default */
+  int32_t c_batch;
+} cohort_lock_t;
+
+DECLSPEC OBJ_CLASS_DECLARATION(cohort_lock_t);
+
+#define COHORT_LOCK_STATIC_INIT                                                \
+  {                                                                            \
+    .super = OBJ_STATIC_INIT(cohort_lock_t), .c_next = 0, .c_serving = 0,      \
+    .c_owner_node = 0, .c_batch = 0,                                           \
+  }
+
+/**
+ * Set how many times in a row a cohort lock may be handed over within a
+ * NUMA node.
+ *
+ * @param lock          Address of the lock.
+ * @param batch         Bound, 0 for the default.
+ */
+static inline void cohort_lock_set_batch(cohort_lock_t *lock, int batch) {
+  lock->c_batch = batch;
+}
+
+/**
+ * NUMA node of the calling thread's CPU, 0 if unknown.
+ */
+DECLSPEC int cohort_lock_current_node(void);
+
+/**
+ * Acquire a cohort lock.
+ *
+ * @param lock          Address of the lock.
+ */
+DECLSPEC void cohort_lock_lock(cohort_lock_t *lock);
+
+/**
+ * Try to acquire a cohort lock.
+ *
+ * @param lock          Address of the lock.
+ * @return              0 if the lock was acquired, 1 otherwise.
+ */
+DECLSPEC int cohort_lock_trylock(cohort_lock_t *lock);
+
+/**
+ * Release a cohort lock.
+ *
+ * @param lock          Address of the lock.
+ */
+DECLSPEC void cohort_lock_unlock(cohort_lock_t *lock);
+
+/**
+ * Lock a cohort lock if using_threads() says that multiple threads may
+ * be active in the process.
+ *
+ * @param lock Pointer to a cohort_lock_t to lock.
+ */
+#define THREAD_COHORT_LOCK(lock)                                               \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      cohort_lock_lock(lock);                                                  \
+    }                                                                          \
+  } while (0)
+
+/**
+ * Unlock a cohort lock if using_threads() says that multiple threads
+ * may be active in the process.
+ *
+ * @param lock Pointer to a cohort_lock_t to unlock.
+ */
+#define THREAD_COHORT_UNLOCK(lock)                                             \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      cohort_lock_unlock(lock);                                                \
+    }                                                                          \
+  } while (0)
+
+/**
+ * Hold a cohort lock for the duration of the specified action if
+ * using_threads() says that multiple threads may be active in the
+ * process.
+ *
+ * @param lock     Pointer to a cohort_lock_t to lock.
+ * @param action   A scope over which the lock is held.
+ */
+#define THREAD_SCOPED_COHORT_LOCK(lock, action)                                \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      cohort_lock_lock(lock);                                                  \
+      action;                                                                  \
+      cohort_lock_unlock(lock);                                                \
+    } else {                                                                   \
+      action;                                                                  \
+    }                                                                          \
+  } while (0)
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "mutex.h"
+
+/**
+ * @file
+ *
+ * Flat-combining lock.
+ *
+ * Instead of taking a lock and running its critical section itself, a
+ * thread publishes the critical section as a request (function and
+ * argument) on the combiner.  One of the publishing threads becomes the
+ * combiner: it takes all published requests at once and runs them back
+ * to back, so the protected data stays in its cache instead of moving
+ * to every caller in turn.  The other callers wait on the completion
+ * flag of their own request, which lives on their stack, and take over
+ * combining if nobody is at it any more.
+ *
+ * Requests from one thread run in the order they were published, and
+ * one at a time: a combiner is a mutual exclusion lock for them.  A
+ * request must not publish to the combiner that runs it.
+ */
+
+typedef void (*combiner_fn_t)(void *arg);
+
+typedef struct combiner_request_t {
+  combiner_fn_t fn;
+  void *arg;
+  struct combiner_request_t *next;
+  /* set once fn returned */
+  volatile int32_t done;
+} combiner_request_t;
+
+typedef struct combiner_t {
+  object_t super;
+  /* requests published and not taken yet, newest first */
+  atomic_intptr_t pending;
+  /* whether a thread is combining */
+  atomic_int32_t combining;
+} combiner_t;
+
+DECLSPEC OBJ_CLASS_DECLARATION(combiner_t);
+
+#define COMBINER_STATIC_INIT                                                   \
+  { .super = OBJ_STATIC_INIT(combiner_t), .pending = 0, .combining = 0 }
+
+/* Batches a combiner runs before it hands the role over */
+#define COMBINER_MAX_PASSES 8
+
+/**
+ * Run fn(arg) under the combiner's mutual exclusion, possibly on
+ * another thread, and return once it ran.
+ *
+ * @param combiner      Address of the combiner.
+ * @param fn            Critical section.
+ * @param arg           Argument of the critical section.
+ */
+DECLSPEC void combiner_execute(combiner_t *combiner, combiner_fn_t fn,
+                               void *arg);
+
+/**
+ * Run a critical section through a combiner if using_threads() says
+ * that multiple threads may be active in the process, or right away
+ * otherwise.
+ *
+ * @param combiner Pointer to a combiner_t.
+ * @param fn       Critical section, a combiner_fn_t.
+ * @param arg      Argument of the critical section.
+ */
+#define THREAD_COMBINE(combiner, fn, arg)                                      \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      combiner_execute((combiner), (fn), (arg));                               \
+    } else {                                                                   \
+      (fn)(arg);                                                               \
+    }                                                                          \
+  } while (0)
@@ -1,12 +1,10 @@
 
 #pragma once
-#ifdef HAVE_SYS_TIME_H
-#include <sys/time.h>
-#endif
 #include <pthread.h>
 #include <time.h>
 
 #include "mutex.h"
+#include "progress.h"
 
 /*
  * Combine pthread support w/ polled progress to allow run-time selection
@@ -17,6 +15,9 @@ struct condition_t {
   object_t super;
   volatile int c_waiting;
   volatile int c_signaled;
+  /* waiters blocked on c_cond in condition_timedwait */
+  volatile int c_parked;
+  thread_internal_cond_t c_cond;
 };
 typedef struct condition_t condition_t;
 
@@ -24,6 +25,9 @@ DECLSPEC OBJ_CLASS_DECLARATION(condition_t);
 
 static inline int condition_wait(condition_t *c, mutex_t *m) {
   int rc = SUCCESS;
+#if THREADS_LOCK_PROFILE
+  lock_profile_drop(m);
+#endif
   c->c_waiting++;
 
   if (using_threads()) {
@@ -50,38 +54,63 @@ static inline int condition_wait(condition_t *c, mutex_t *m) {
   return rc;
 }
 
+/* Progress polls of a timed wait before it blocks */
+#define CONDITION_TIMEDWAIT_SPIN 64
+
+/* Whether abstime on CLOCK_MONOTONIC has passed */
+static inline bool condition_deadline_passed(const struct timespec *abstime) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec > abstime->tv_sec ||
+         (now.tv_sec == abstime->tv_sec && now.tv_nsec >= abstime->tv_nsec);
+}
+
+/**
+ * Wait for a signal or until an absolute deadline.
+ *
+ * abstime is on CLOCK_MONOTONIC, so clock adjustments do not move the
+ * deadline.  It used to be on CLOCK_REALTIME, as with
+ * pthread_cond_timedwait: callers that build it from CLOCK_REALTIME
+ * must switch to CLOCK_MONOTONIC.  Backends that can only block until a
+ * wall clock deadline may return early when the wall clock steps
+ * forward, so the deadline is rechecked on the monotonic clock after
+ * every wakeup.  The caller first drives progress for a short while, as
+ * completions are often imminent, and then blocks until it is signaled
+ * or the deadline passes.  A single-threaded process has nobody else to
+ * signal it and keeps driving progress until either happens.
+ *
+ * @param c             Condition to wait on.
+ * @param m             Mutex held by the caller.
+ * @param abstime       Deadline on CLOCK_MONOTONIC.
+ */
 static inline int condition_timedwait(condition_t *c, mutex_t *m,
                                       const struct timespec *abstime) {
-  struct timeval tv;
-  struct timeval absolute;
   int rc = SUCCESS;
 
+#if THREADS_LOCK_PROFILE
+  lock_profile_drop(m);
+#endif
   c->c_waiting++;
+  for (int spin = 0; 0 == c->c_signaled && spin < CONDITION_TIMEDWAIT_SPIN;
+       ++spin) {
+    if (using_threads()) {
+      mutex_unlock(m);
+      progress();
+      mutex_lock(m);
+    } else {
+      progress();
+    }
+  }
+
   if (using_threads()) {
-    absolute.tv_sec = abstime->tv_sec;
-    absolute.tv_usec = abstime->tv_nsec / 1000;
-    gettimeofday(&tv, NULL);
-    if (0 == c->c_signaled) {
-      do {
-        mutex_unlock(m);
-        progress();
-        gettimeofday(&tv, NULL);
-        mutex_lock(m);
-      } while (0 == c->c_signaled && (tv.tv_sec <= absolute.tv_sec ||
-                                      (tv.tv_sec == absolute.tv_sec &&
-                                       tv.tv_usec < absolute.tv_usec)));
+    c->c_parked++;
+    while (0 == c->c_signaled && !condition_deadline_passed(abstime)) {
+      (void)thread_internal_cond_timedwait(&c->c_cond, &m->m_lock, abstime);
     }
+    c->c_parked--;
   } else {
-    absolute.tv_sec = abstime->tv_sec;
-    absolute.tv_usec = abstime->tv_nsec / 1000;
-    gettimeofday(&tv, NULL);
-    if (0 == c->c_signaled) {
-      do {
-        progress();
-        gettimeofday(&tv, NULL);
-      } while (0 == c->c_signaled && (tv.tv_sec <= absolute.tv_sec ||
-                                      (tv.tv_sec == absolute.tv_sec &&
-                                       tv.tv_usec < absolute.tv_usec)));
+    while (0 == c->c_signaled && !condition_deadline_passed(abstime)) {
+      progress();
     }
   }
 
@@ -95,11 +124,17 @@ static inline int condition_timedwait(condition_t *c, mutex_t *m,
 static inline int condition_signal(condition_t *c) {
   if (c->c_waiting) {
     c->c_signaled++;
+    if (c->c_parked) {
+      thread_internal_cond_signal(&c->c_cond);
+    }
   }
   return SUCCESS;
 }
 
 static inline int condition_broadcast(condition_t *c) {
   c->c_signaled = c->c_waiting;
+  if (c->c_parked) {
+    thread_internal_cond_broadcast(&c->c_cond);
+  }
   return SUCCESS;
 }
@@ -0,0 +1,611 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * C++20 coroutine layer over the libult primitives.
+ *
+ * A libult::task<T> is a lazily started coroutine; awaiting it runs it
+ * to completion and yields its value.  Tasks are run by a
+ * libult::executor, a pool of libult threads (ULTs on the ULT backends)
+ * that resume coroutine frames from a shared queue.  A suspended
+ * coroutine costs its frame, not a stack, so services can keep large
+ * numbers of operations in flight.
+ *
+ * Awaitables:
+ *   - executor::schedule()        resume on the executor
+ *   - async_mutex::lock()         resume holding the mutex
+ *   - wait(sync)                  resume once a wait sync completed
+ *   - sleep_until(), sleep_for()  resume once a deadline passed
+ *
+ * Awaitables resume the coroutine on the executor it was running on
+ * when it suspended.  Outside of an executor a wait or a sleep blocks
+ * the calling thread, and a coroutine waiting for an async_mutex is
+ * resumed by the thread unlocking it.
+ */
+
+#if !defined(__cpp_impl_coroutine)
+#error "coro.hpp requires C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <utility>
+
+extern "C" {
+#include "mutex.h"
+#include "threads.h"
+#include "timer_wheel.h"
+#include "tsd.h"
+#include "wait_sync.h"
+}
+
+namespace libult {
+
+class executor;
+
+namespace detail {
+
+// A coroutine to resume on an executor; lives in the awaiter, that is
+// in the suspended coroutine's frame.
+struct work_item {
+  work_item *next = nullptr;
+  std::coroutine_handle<> handle;
+  // set while the executor polls a wait sync for the coroutine
+  ompi_wait_sync_t *sync = nullptr;
+};
+
+struct task_promise_base {
+  struct final_awaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> h) const noexcept {
+      return h.promise().continuation;
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  final_awaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept {
+    exception = std::current_exception();
+  }
+  void rethrow() const {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  std::coroutine_handle<> continuation = std::noop_coroutine();
+  std::exception_ptr exception;
+};
+
+template <typename T> struct task_promise;
+
+} // namespace detail
+
+/**
+ * Lazily started coroutine returning T.
+ *
+ * Nothing runs until the task is awaited, or handed to
+ * executor::spawn() or executor::block_on().  Move-only; destroying a
+ * task destroys its frame.
+ */
+template <typename T = void> class [[nodiscard]] task {
+public:
+  using promise_type = detail::task_promise<T>;
+
+  task() noexcept = default;
+  explicit task(std::coroutine_handle<promise_type> h) noexcept : m_h(h) {}
+  task(task &&other) noexcept : m_h(std::exchange(other.m_h, nullptr)) {}
+  task &operator=(task &&other) noexcept {
+    if (this != &other) {
+      if (m_h) {
+        m_h.destroy();
+      }
+      m_h = std::exchange(other.m_h, nullptr);
+    }
+    return *this;
+  }
+  task(const task &) = delete;
+  task &operator=(const task &) = delete;
+  ~task() {
+    if (m_h) {
+      m_h.destroy();
+    }
+  }
+
+  auto operator co_await() && noexcept {
+    struct awaiter {
+      std::coroutine_handle<promise_type> h;
+      bool await_ready() const noexcept { return !h || h.done(); }
+      std::coroutine_handle<>
+      await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        h.promise().continuation = awaiting;
+        return h;
+      }
+      T await_resume() { return h.promise().result(); }
+    };
+    return awaiter{m_h};
+  }
+
+private:
+  std::coroutine_handle<promise_type> m_h;
+};
+
+namespace detail {
+
+template <typename T> struct task_promise : task_promise_base {
+  task<T> get_return_object() noexcept {
+    return task<T>(std::coroutine_handle<task_promise>::from_promise(*this));
+  }
+  template <typename U> void return_value(U &&value) {
+    m_value.emplace(std::forward<U>(value));
+  }
+  T result() {
+    rethrow();
+    return std::move(*m_value);
+  }
+
+  std::optional<T> m_value;
+};
+
+template <> struct task_promise<void> : task_promise_base {
+  task<void> get_return_object() noexcept {
+    return task<void>(
+        std::coroutine_handle<task_promise>::from_promise(*this));
+  }
+  void return_void() const noexcept {}
+  void result() const { rethrow(); }
+};
+
+// Coroutine that owns itself: started eagerly, destroyed at its end
+struct detached {
+  struct promise_type {
+    detached get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+} // namespace detail
+
+/**
+ * Pool of libult threads resuming coroutines.
+ *
+ * Idle threads poll the wait syncs coroutines wait for, driving their
+ * progress callbacks like SYNC_WAIT does, and park on a backend
+ * condition variable once there is nothing to poll.  The executor must
+ * outlive the coroutines it runs.
+ */
+class executor {
+public:
+  explicit executor(int nthreads) : m_nthreads(nthreads > 0 ? nthreads : 1) {
+    thread_internal_mutex_init(&m_lock, false);
+    thread_internal_cond_init(&m_cond);
+    m_threads = new thread_t[m_nthreads];
+    for (int i = 0; i < m_nthreads; ++i) {
+      OBJ_CONSTRUCT(&m_threads[i], thread_t);
+      m_threads[i].t_run = run;
+      m_threads[i].t_arg = this;
+      thread_start(&m_threads[i]);
+    }
+  }
+  executor(const executor &) = delete;
+  executor &operator=(const executor &) = delete;
+
+  /* Stops the threads once the queue is drained; coroutines still
+   * suspended on something else are not resumed anymore. */
+  ~executor() {
+    thread_internal_mutex_lock(&m_lock);
+    m_stop = true;
+    thread_internal_cond_broadcast(&m_cond);
+    thread_internal_mutex_unlock(&m_lock);
+    for (int i = 0; i < m_nthreads; ++i) {
+      thread_join(&m_threads[i], nullptr);
+      OBJ_DESTRUCT(&m_threads[i]);
+    }
+    delete[] m_threads;
+    thread_internal_cond_destroy(&m_cond);
+    thread_internal_mutex_destroy(&m_lock);
+  }
+
+  /**
+   * Executor of the calling thread, nullptr outside of an executor.
+   */
+  static executor *current() {
+    void *ex = nullptr;
+    tsd_get(current_key(), &ex);
+    return static_cast<executor *>(ex);
+  }
+
+  /**
+   * Queue a coroutine to be resumed by one of the threads.
+   */
+  void post(detail::work_item *item) {
+    item->next = nullptr;
+    thread_internal_mutex_lock(&m_lock);
+    if (nullptr == m_tail) {
+      m_head = item;
+    } else {
+      m_tail->next = item;
+    }
+    m_tail = item;
+    if (m_idle > 0) {
+      thread_internal_cond_signal(&m_cond);
+    }
+    thread_internal_mutex_unlock(&m_lock);
+  }
+
+  /**
+   * Poll item->sync until it completes, then resume item->handle.
+   */
+  void watch(detail::work_item *item) {
+    thread_internal_mutex_lock(&m_lock);
+    item->next = m_watched;
+    m_watched = item;
+    if (m_idle > 0) {
+      thread_internal_cond_signal(&m_cond);
+    }
+    thread_internal_mutex_unlock(&m_lock);
+  }
+
+  /**
+   * Awaitable that resumes the awaiting coroutine on this executor.
+   */
+  auto schedule() noexcept {
+    struct awaiter {
+      executor &ex;
+      detail::work_item item;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> h) noexcept {
+        item.handle = h;
+        ex.post(&item);
+      }
+      void await_resume() const noexcept {}
+    };
+    return awaiter{*this, {}};
+  }
+
+  /**
+   * Run a task on the executor without waiting for it.  The task must
+   * not throw.
+   */
+  void spawn(task<void> t) { detach(*this, std::move(t)); }
+
+  /**
+   * Run a task on the executor and block the calling thread until it
+   * returns.
+   */
+  template <typename T> T block_on(task<T> t) {
+    ompi_wait_sync_t sync;
+    std::optional<T> result;
+    std::exception_ptr exception;
+    WAIT_SYNC_INIT(&sync, 1);
+    complete(*this, std::move(t), &result, &exception, &sync);
+    SYNC_WAIT(&sync);
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+    return std::move(*result);
+  }
+
+  void block_on(task<void> t) {
+    ompi_wait_sync_t sync;
+    std::exception_ptr exception;
+    WAIT_SYNC_INIT(&sync, 1);
+    complete(*this, std::move(t), &exception, &sync);
+    SYNC_WAIT(&sync);
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+private:
+  // Syncs handed to wait_sync_progress at a time
+  static constexpr int poll_batch = 64;
+
+  static tsd_key_t current_key() {
+    static const tsd_key_t key = [] {
+      tsd_key_t k;
+      tsd_key_create(&k, nullptr);
+      return k;
+    }();
+    return key;
+  }
+
+  static detail::detached detach(executor &ex, task<void> t) {
+    co_await ex.schedule();
+    co_await std::move(t);
+  }
+
+  template <typename T>
+  static detail::detached complete(executor &ex, task<T> t,
+                                   std::optional<T> *result,
+                                   std::exception_ptr *exception,
+                                   ompi_wait_sync_t *sync) {
+    co_await ex.schedule();
+    try {
+      result->emplace(co_await std::move(t));
+    } catch (...) {
+      *exception = std::current_exception();
+    }
+    wait_sync_update(sync, 1, SUCCESS);
+  }
+
+  static detail::detached complete(executor &ex, task<void> t,
+                                   std::exception_ptr *exception,
+                                   ompi_wait_sync_t *sync) {
+    co_await ex.schedule();
+    try {
+      co_await std::move(t);
+    } catch (...) {
+      *exception = std::current_exception();
+    }
+    wait_sync_update(sync, 1, SUCCESS);
+  }
+
+  /* Take the watched syncs, drive their progress once, resume the
+   * coroutines of those that completed and put the others back.
+   * Called and returns with m_lock held. */
+  bool poll_watched() {
+    detail::work_item *watched = m_watched, *pending = nullptr, *ready,
+                      *next;
+    ompi_wait_sync_t *syncs[poll_batch];
+    bool resumed = false;
+    int n = 0;
+
+    m_watched = nullptr;
+    thread_internal_mutex_unlock(&m_lock);
+
+    for (detail::work_item *item = watched; nullptr != item;
+         item = item->next) {
+      syncs[n++] = item->sync;
+      if (poll_batch == n || nullptr == item->next) {
+        wait_sync_progress(syncs, n);
+        n = 0;
+      }
+    }
+    for (detail::work_item *item = watched; nullptr != item; item = next) {
+      next = item->next;
+      if (wait_sync_count(item->sync) > 0) {
+        item->next = pending;
+        pending = item;
+        continue;
+      }
+      ready = item;
+      ready->sync = nullptr;
+      ready->handle.resume();
+      resumed = true;
+    }
+
+    thread_internal_mutex_lock(&m_lock);
+    while (nullptr != pending) {
+      next = pending->next;
+      pending->next = m_watched;
+      m_watched = pending;
+      pending = next;
+    }
+    return resumed;
+  }
+
+  static void *run(object_t *arg) {
+    thread_t *self = reinterpret_cast<thread_t *>(arg);
+    executor *ex = static_cast<executor *>(self->t_arg);
+    detail::work_item *item;
+
+    tsd_set(current_key(), ex);
+    thread_internal_mutex_lock(&ex->m_lock);
+    for (;;) {
+      if (nullptr != (item = ex->m_head)) {
+        ex->m_head = item->next;
+        if (nullptr == ex->m_head) {
+          ex->m_tail = nullptr;
+        }
+        thread_internal_mutex_unlock(&ex->m_lock);
+        item->handle.resume();
+        thread_internal_mutex_lock(&ex->m_lock);
+        continue;
+      }
+      if (nullptr != ex->m_watched) {
+        if (!ex->poll_watched() && nullptr == ex->m_head) {
+          thread_internal_mutex_unlock(&ex->m_lock);
+          thread_yield();
+          thread_internal_mutex_lock(&ex->m_lock);
+        }
+        continue;
+      }
+      if (ex->m_stop) {
+        break;
+      }
+      ++ex->m_idle;
+      thread_internal_cond_wait(&ex->m_cond, &ex->m_lock);
+      --ex->m_idle;
+    }
+    thread_internal_mutex_unlock(&ex->m_lock);
+    tsd_set(current_key(), nullptr);
+    return nullptr;
+  }
+
+  thread_internal_mutex_t m_lock;
+  thread_internal_cond_t m_cond;
+  detail::work_item *m_head = nullptr;
+  detail::work_item *m_tail = nullptr;
+  // coroutines waiting for a wait sync
+  detail::work_item *m_watched = nullptr;
+  int m_idle = 0;
+  bool m_stop = false;
+  int m_nthreads;
+  thread_t *m_threads;
+};
+
+/**
+ * Awaitable completion of a wait sync: resumes once the sync's count
+ * dropped to zero, returning the sync's status.
+ */
+inline auto wait(ompi_wait_sync_t &sync) noexcept {
+  struct awaiter {
+    ompi_wait_sync_t &sync;
+    detail::work_item item;
+    bool await_ready() const noexcept { return 0 == wait_sync_count(&sync); }
+    bool await_suspend(std::coroutine_handle<> h) noexcept {
+      executor *ex = executor::current();
+      if (nullptr == ex) {
+        SYNC_WAIT(&sync);
+        return false;
+      }
+      item.handle = h;
+      item.sync = &sync;
+      ex->watch(&item);
+      return true;
+    }
+    int await_resume() const noexcept {
+      atomic_rmb();
+      return sync.status;
+    }
+  };
+  return awaiter{sync, {}};
+}
+
+namespace detail {
+
+// The wheel hands its callback the timer, first member of the state
+struct sleep_state {
+  ult_timer_t timer;
+  executor *ex;
+  work_item item;
+
+  static void fire(ult_timer_t *timer) {
+    sleep_state *self = reinterpret_cast<sleep_state *>(timer);
+    self->ex->post(&self->item);
+  }
+};
+
+} // namespace detail
+
+/**
+ * Awaitable that resumes once deadline (CLOCK_MONOTONIC nanoseconds,
+ * see ult_timer_now()) passed, to the resolution of the timer wheel.
+ */
+inline auto sleep_until(uint64_t deadline) noexcept {
+  struct awaiter {
+    uint64_t deadline;
+    detail::sleep_state state;
+    bool await_ready() const noexcept { return ult_timer_now() >= deadline; }
+    bool await_suspend(std::coroutine_handle<> h) noexcept {
+      state.ex = executor::current();
+      state.item.handle = h;
+      if (nullptr == state.ex ||
+          SUCCESS != ult_timer_add(&state.timer, deadline,
+                                   detail::sleep_state::fire)) {
+        ult_sleep_until(deadline);
+        return false;
+      }
+      return true;
+    }
+    void await_resume() const noexcept {}
+  };
+  return awaiter{deadline, {}};
+}
+
+inline auto sleep_for(uint64_t ns) noexcept {
+  return sleep_until(ult_timer_now() + ns);
+}
+
+/**
+ * Mutex whose lock() suspends the awaiting coroutine instead of its
+ * thread.  Waiters are served in FIFO order; unlock() hands the mutex
+ * straight to the first of them.
+ */
+class async_mutex {
+public:
+  async_mutex() noexcept { thread_internal_mutex_init(&m_lock, false); }
+  async_mutex(const async_mutex &) = delete;
+  async_mutex &operator=(const async_mutex &) = delete;
+  ~async_mutex() { thread_internal_mutex_destroy(&m_lock); }
+
+  bool try_lock() noexcept {
+    thread_internal_mutex_lock(&m_lock);
+    bool acquired = !m_locked;
+    m_locked = true;
+    thread_internal_mutex_unlock(&m_lock);
+    return acquired;
+  }
+
+  /**
+   * Awaitable that resumes holding the mutex.
+   */
+  auto lock() noexcept {
+    struct awaiter {
+      async_mutex &m;
+      waiter w;
+      bool await_ready() noexcept { return m.try_lock(); }
+      bool await_suspend(std::coroutine_handle<> h) noexcept {
+        w.item.handle = h;
+        w.ex = executor::current();
+        return m.enqueue(&w);
+      }
+      void await_resume() const noexcept {}
+    };
+    return awaiter{*this, {}};
+  }
+
+  void unlock() {
+    waiter *w;
+    thread_internal_mutex_lock(&m_lock);
+    w = m_head;
+    if (nullptr == w) {
+      m_locked = false;
+    } else if (nullptr == (m_head = w->next)) {
+      m_tail = nullptr;
+    }
+    thread_internal_mutex_unlock(&m_lock);
+    if (nullptr == w) {
+      return;
+    }
+    // the mutex stays locked, now on behalf of w
+    if (nullptr != w->ex) {
+      w->ex->post(&w->item);
+    } else {
+      w->item.handle.resume();
+    }
+  }
+
+private:
+  struct waiter {
+    detail::work_item item;
+    executor *ex;
+    waiter *next;
+  };
+
+  // false if the mutex was unlocked in the meantime and is now ours
+  bool enqueue(waiter *w) noexcept {
+    thread_internal_mutex_lock(&m_lock);
+    if (!m_locked) {
+      m_locked = true;
+      thread_internal_mutex_unlock(&m_lock);
+      return false;
+    }
+    w->next = nullptr;
+    if (nullptr == m_tail) {
+      m_head = w;
+    } else {
+      m_tail->next = w;
+    }
+    m_tail = w;
+    thread_internal_mutex_unlock(&m_lock);
+    return true;
+  }
+
+  thread_internal_mutex_t m_lock;
+  bool m_locked = false;
+  waiter *m_head = nullptr;
+  waiter *m_tail = nullptr;
+};
+
+} // namespace libult
@@ -4,6 +4,20 @@
 #include "threads.h"
 
 static int opal_threads_argobots_open(void);
+static int threads_argobots_register(void);
+
+int threads_argobots_mutex_fair = 1;
+
+int threads_argobots_register(void)
+{
+    (void) mca_base_component_var_register(
+        &mca_threads_argobots_component.threadsc_version, "mutex_fair",
+        "Whether unlocking a mutex hands it over to a waiting ULT (1) or lets the "
+        "releasing ULT reacquire it for throughput (0)",
+        MCA_BASE_VAR_TYPE_INT, NULL, 0, 0, INFO_LVL_3, MCA_BASE_VAR_SCOPE_LOCAL,
+        &threads_argobots_mutex_fair);
+    return SUCCESS;
+}
 
 int opal_threads_argobots_open(void)
 {
@@ -3,31 +3,81 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include "mutex.h"
 #include "threads_argobots.h"
 
-typedef ABT_mutex_memory thread_internal_mutex_t;
-
-#define THREAD_INTERNAL_MUTEX_INITIALIZER ABT_MUTEX_INITIALIZER
+/*
+ * ABT_cond_wait needs an ABT_mutex, so the lock stays an ABT_mutex and
+ * the mutex counts the ULTs blocked on it.  In fair mode (the default,
+ * see the "mutex_fair" component variable and mutex_set_fair()) an
+ * unlock with waiters hands the lock over with ABT_mutex_unlock_se, which
+ * yields to a waiter.  In throughput mode, or without waiters, unlocking
+ * is a plain ABT_mutex_unlock and never yields.
+ */
+
+/* Whether mutexes without a policy of their own are fair */
+extern int threads_argobots_mutex_fair;
+
+#define THREADS_ARGOBOTS_MUTEX_DEFAULT 0
+#define THREADS_ARGOBOTS_MUTEX_THROUGHPUT 1
+#define THREADS_ARGOBOTS_MUTEX_FAIR 2
+
+typedef struct {
+  ABT_mutex_memory m_mutex;
+  /* ULTs blocked in thread_internal_mutex_lock */
+  atomic_int32_t m_waiters;
+  int32_t m_policy;
+} thread_internal_mutex_t;
+
+#define THREAD_INTERNAL_MUTEX_INITIALIZER                                      \
+  {                                                                            \
+    .m_mutex = ABT_MUTEX_INITIALIZER, .m_waiters = 0,                          \
+    .m_policy = THREADS_ARGOBOTS_MUTEX_DEFAULT,                                \
+  }
 #define THREAD_INTERNAL_RECURSIVE_MUTEX_INITIALIZER                            \
-  ABT_RECURSIVE_MUTEX_INITIALIZER
+  {                                                                            \
+    .m_mutex = ABT_RECURSIVE_MUTEX_INITIALIZER, .m_waiters = 0,                \
+    .m_policy = THREADS_ARGOBOTS_MUTEX_DEFAULT,                                \
+  }
+
+#define THREAD_INTERNAL_MUTEX_HAS_FAIRNESS 1
 
 static inline int thread_internal_mutex_init(thread_internal_mutex_t *p_mutex,
                                              bool recursive) {
   if (recursive) {
     const ABT_mutex_memory init_mutex = ABT_RECURSIVE_MUTEX_INITIALIZER;
-    memcpy(p_mutex, &init_mutex, sizeof(ABT_mutex_memory));
+    memcpy(&p_mutex->m_mutex, &init_mutex, sizeof(ABT_mutex_memory));
   } else {
     const ABT_mutex_memory init_mutex = ABT_MUTEX_INITIALIZER;
-    memcpy(p_mutex, &init_mutex, sizeof(ABT_mutex_memory));
+    memcpy(&p_mutex->m_mutex, &init_mutex, sizeof(ABT_mutex_memory));
   }
+  p_mutex->m_waiters = 0;
+  p_mutex->m_policy = THREADS_ARGOBOTS_MUTEX_DEFAULT;
   return SUCCESS;
 }
 
+static inline void
+thread_internal_mutex_set_fair(thread_internal_mutex_t *p_mutex, bool fair) {
+  p_mutex->m_policy =
+      fair ? THREADS_ARGOBOTS_MUTEX_FAIR : THREADS_ARGOBOTS_MUTEX_THROUGHPUT;
+}
+
+static inline bool
+threads_argobots_mutex_is_fair(thread_internal_mutex_t *p_mutex) {
+  return THREADS_ARGOBOTS_MUTEX_FAIR == p_mutex->m_policy ||
+         (THREADS_ARGOBOTS_MUTEX_DEFAULT == p_mutex->m_policy &&
+          threads_argobots_mutex_fair);
+}
+
 static inline void
 thread_internal_mutex_lock(thread_internal_mutex_t *p_mutex) {
-  ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(p_mutex);
+  ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&p_mutex->m_mutex);
+  if (LIKELY(ABT_SUCCESS == ABT_mutex_trylock(mutex))) {
+    return;
+  }
+  atomic_fetch_add_32(&p_mutex->m_waiters, 1);
 #if ENABLE_DEBUG
   int ret = ABT_mutex_lock(mutex);
   if (ABT_SUCCESS != ret) {
@@ -36,11 +86,12 @@ thread_internal_mutex_lock(thread_internal_mutex_t *p_mutex) {
 #else
   ABT_mutex_lock(mutex);
 #endif
+  atomic_fetch_add_32(&p_mutex->m_waiters, -1);
 }
 
 static inline int
 thread_internal_mutex_trylock(thread_internal_mutex_t *p_mutex) {
-  ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(p_mutex);
+  ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&p_mutex->m_mutex);
   int ret = ABT_mutex_trylock(mutex);
   if (ABT_ERR_MUTEX_LOCKED == ret) {
     return 1;
@@ -55,17 +106,22 @@ thread_internal_mutex_trylock(thread_internal_mutex_t *p_mutex) {
 
 static inline void
 thread_internal_mutex_unlock(thread_internal_mutex_t *p_mutex) {
-  ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(p_mutex);
+  ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&p_mutex->m_mutex);
+  int ret;
+  /* For fairness of locking, hand over to a waiter if there is one. */
+  if (UNLIKELY(0 < p_mutex->m_waiters) &&
+      threads_argobots_mutex_is_fair(p_mutex)) {
+    ret = ABT_mutex_unlock_se(mutex);
+  } else {
+    ret = ABT_mutex_unlock(mutex);
+  }
 #if ENABLE_DEBUG
-  int ret = ABT_mutex_unlock(mutex);
   if (ABT_SUCCESS != ret) {
     show_help("help-opal-threads.txt", "mutex unlock failed", true);
   }
 #else
-  ABT_mutex_unlock(mutex);
+  (void)ret;
 #endif
-  /* For fairness of locking. */
-  ABT_thread_yield();
 }
 
 static inline void
@@ -85,7 +141,7 @@ static inline int thread_internal_cond_init(thread_internal_cond_t *p_cond) {
 
 static inline void thread_internal_cond_wait(thread_internal_cond_t *p_cond,
                                              thread_internal_mutex_t *p_mutex) {
-  ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(p_mutex);
+  ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&p_mutex->m_mutex);
   ABT_cond cond = ABT_COND_MEMORY_GET_HANDLE(p_cond);
 #if ENABLE_DEBUG
   int ret = ABT_cond_wait(cond, mutex);
@@ -95,6 +151,53 @@ static inline void thread_internal_cond_wait(thread_internal_cond_t *p_cond,
 #endif
 }
 
+/**
+ * Wait until signaled or until abstime on CLOCK_MONOTONIC passes.
+ *
+ * ABT_cond_timedwait takes a wall clock deadline, so the time left on
+ * the monotonic clock is converted right before blocking, and again
+ * after each timeout in case the wall clock was stepped forward
+ * meanwhile.
+ *
+ * @return 0 once signaled, 1 on timeout
+ */
+static inline int
+thread_internal_cond_timedwait(thread_internal_cond_t *p_cond,
+                               thread_internal_mutex_t *p_mutex,
+                               const struct timespec *abstime) {
+  ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&p_mutex->m_mutex);
+  ABT_cond cond = ABT_COND_MEMORY_GET_HANDLE(p_cond);
+  struct timespec now, deadline;
+  int ret;
+
+  for (;;) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > abstime->tv_sec ||
+        (now.tv_sec == abstime->tv_sec && now.tv_nsec >= abstime->tv_nsec)) {
+      ret = ABT_ERR_COND_TIMEDOUT;
+      break;
+    }
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += abstime->tv_sec - now.tv_sec;
+    deadline.tv_nsec += abstime->tv_nsec - now.tv_nsec;
+    if (deadline.tv_nsec < 0) {
+      deadline.tv_sec--;
+      deadline.tv_nsec += 1000000000;
+    } else if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    ret = ABT_cond_timedwait(cond, mutex, &deadline);
+    if (ABT_ERR_COND_TIMEDOUT != ret) {
+      break;
+    }
+  }
+#if ENABLE_DEBUG
+  assert(ABT_SUCCESS == ret || ABT_ERR_COND_TIMEDOUT == ret);
+#endif
+  return ABT_ERR_COND_TIMEDOUT == ret ? 1 : 0;
+}
+
 static inline void
 thread_internal_cond_broadcast(thread_internal_cond_t *p_cond) {
   ABT_cond cond = ABT_COND_MEMORY_GET_HANDLE(p_cond);
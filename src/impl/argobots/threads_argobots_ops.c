@@ -0,0 +1,29 @@
+#if THREADS_MULTI_BACKEND
+
+#define THREADS_BACKEND_IMPL 1
+
+#include "threads_backend.h"
+#include "threads_argobots.h"
+#include "threads_argobots_mutex.h"
+#include "threads_argobots_tsd.h"
+
+static int threads_backend_ops_key_create(tsd_key_t *key, void (*destructor)(void *))
+{
+    threads_argobots_ensure_init();
+    int rc = ABT_key_create(destructor, key);
+    return (ABT_SUCCESS == rc) ? SUCCESS : ERROR;
+}
+
+static void threads_backend_ops_yield(void)
+{
+    ABT_thread_yield();
+}
+
+#define THREADS_BACKEND_OPS threads_argobots_backend_ops
+#define THREADS_BACKEND_OPS_NAME "argobots"
+/* Argobots are cooperatively scheduled so yield when idle */
+#define THREADS_BACKEND_OPS_YIELD_WHEN_IDLE true
+
+#include "threads_backend_ops.h"
+
+#endif /* THREADS_MULTI_BACKEND */
@@ -0,0 +1,144 @@
+#include <stdlib.h>
+
+#include "barrier.h"
+#include "threads.h"
+
+/* Polls of a node before yielding or parking */
+#define BARRIER_POLL 128
+
+/* Enough levels for any int number of participants */
+#define BARRIER_MAX_DEPTH 32
+
+int barrier_init(barrier_t *barrier, int participants, int policy)
+{
+    barrier_node_t *nodes, *node;
+    int total = 0, width, below, start;
+
+    if (participants < 1) {
+        return ERR_BAD_PARAM;
+    }
+    width = participants;
+    do {
+        width = (width + BARRIER_FANIN - 1) / BARRIER_FANIN;
+        total += width;
+    } while (width > 1);
+    if (0 != posix_memalign((void **) &nodes, 64, total * sizeof(*nodes))) {
+        return ERR_OUT_OF_RESOURCE;
+    }
+
+    /* Level by level from the leaves; the last node is the root */
+    below = participants;
+    start = 0;
+    for (;;) {
+        width = (below + BARRIER_FANIN - 1) / BARRIER_FANIN;
+        for (int i = 0; i < width; ++i) {
+            node = &nodes[start + i];
+            node->count = 0;
+            node->expected = below - i * BARRIER_FANIN < BARRIER_FANIN
+                                 ? below - i * BARRIER_FANIN
+                                 : BARRIER_FANIN;
+            node->parent = 1 == width ? -1 : start + width + i / BARRIER_FANIN;
+            node->episode = 0;
+            node->parked = 0;
+            thread_internal_mutex_init(&node->lock, false);
+            thread_internal_cond_init(&node->cond);
+        }
+        if (1 == width) {
+            break;
+        }
+        start += width;
+        below = width;
+    }
+
+    barrier->b_nodes = nodes;
+    barrier->b_participants = participants;
+    barrier->b_policy = policy;
+    return SUCCESS;
+}
+
+void barrier_destroy(barrier_t *barrier)
+{
+    int width = barrier->b_participants, total = 0;
+
+    do {
+        width = (width + BARRIER_FANIN - 1) / BARRIER_FANIN;
+        total += width;
+    } while (width > 1);
+    for (int i = 0; i < total; ++i) {
+        thread_internal_cond_destroy(&barrier->b_nodes[i].cond);
+        thread_internal_mutex_destroy(&barrier->b_nodes[i].lock);
+    }
+    free(barrier->b_nodes);
+    barrier->b_nodes = NULL;
+}
+
+static void barrier_node_wait(barrier_t *barrier, barrier_node_t *node, int32_t episode)
+{
+    int spin = 0;
+
+    while (episode == node->episode) {
+        if (BARRIER_SPIN == barrier->b_policy || ++spin < BARRIER_POLL) {
+            continue;
+        }
+        if (BARRIER_YIELD == barrier->b_policy) {
+            thread_yield();
+            continue;
+        }
+        thread_internal_mutex_lock(&node->lock);
+        ++node->parked;
+        while (episode == node->episode) {
+            thread_internal_cond_wait(&node->cond, &node->lock);
+        }
+        --node->parked;
+        thread_internal_mutex_unlock(&node->lock);
+        break;
+    }
+    atomic_rmb();
+}
+
+static void barrier_node_release(barrier_t *barrier, barrier_node_t *node)
+{
+    atomic_mb();
+    if (BARRIER_PARK != barrier->b_policy) {
+        node->episode = node->episode + 1;
+        return;
+    }
+    thread_internal_mutex_lock(&node->lock);
+    node->episode = node->episode + 1;
+    if (0 != node->parked) {
+        thread_internal_cond_broadcast(&node->cond);
+    }
+    thread_internal_mutex_unlock(&node->lock);
+}
+
+int barrier_wait(barrier_t *barrier, int rank)
+{
+    int path[BARRIER_MAX_DEPTH], depth = 0, index = rank / BARRIER_FANIN;
+    barrier_node_t *node;
+    int32_t episode;
+    bool serial = false;
+
+    /* Climb as long as we are the last to arrive at a node */
+    for (;;) {
+        node = &barrier->b_nodes[index];
+        episode = node->episode;
+        if (atomic_add_fetch_32(&node->count, 1) != node->expected) {
+            barrier_node_wait(barrier, node, episode);
+            break;
+        }
+        /* nobody arrives for the next episode before the release */
+        node->count = 0;
+        path[depth++] = index;
+        if (node->parent < 0) {
+            serial = true;
+            break;
+        }
+        index = node->parent;
+    }
+
+    /* Release the nodes we completed, top down */
+    while (depth > 0) {
+        barrier_node_release(barrier, &barrier->b_nodes[path[--depth]]);
+    }
+    return serial ? BARRIER_SERIAL : 0;
+}
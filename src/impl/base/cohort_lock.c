@@ -0,0 +1,217 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* sched_getcpu */
+#endif
+
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cohort_lock.h"
+#include "threads.h"
+
+#define COHORT_NODE_DIR "/sys/devices/system/node"
+
+/* Polls of a ticket before waiters start yielding */
+#define COHORT_LOCK_SPIN 64
+
+#define COHORT_TOPOLOGY_READY 2
+
+/* NUMA node of each CPU, folded to COHORT_LOCK_MAX_NODES */
+static int16_t *cohort_cpu_node = NULL;
+static int cohort_ncpus = 0;
+static int cohort_default_batch = COHORT_LOCK_BATCH;
+static atomic_int32_t cohort_topology_state = 0;
+
+static void cohort_topology_set(long cpu, int node)
+{
+    int16_t *table;
+    int size;
+
+    if (cpu < 0 || cpu > INT16_MAX) {
+        return;
+    }
+    if (cpu >= cohort_ncpus) {
+        size = cohort_ncpus > 0 ? cohort_ncpus : 64;
+        while (size <= cpu) {
+            size *= 2;
+        }
+        table = (int16_t *) realloc(cohort_cpu_node, size * sizeof(*table));
+        if (NULL == table) {
+            return;
+        }
+        for (int i = cohort_ncpus; i < size; ++i) {
+            table[i] = 0;
+        }
+        cohort_cpu_node = table;
+        cohort_ncpus = size;
+    }
+    cohort_cpu_node[cpu] = (int16_t) (node % COHORT_LOCK_MAX_NODES);
+}
+
+/* Parse a node's cpulist, e.g. "0-15,32-47" */
+static void cohort_topology_read_node(int node)
+{
+    char path[64], buf[4096], *p, *end;
+    long first, last;
+    FILE *file;
+
+    snprintf(path, sizeof(path), COHORT_NODE_DIR "/node%d/cpulist", node);
+    if (NULL == (file = fopen(path, "r"))) {
+        return;
+    }
+    if (NULL != fgets(buf, sizeof(buf), file)) {
+        for (p = buf; '\0' != *p && '\n' != *p;) {
+            first = last = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            if ('-' == *end) {
+                p = end + 1;
+                last = strtol(p, &end, 10);
+            }
+            for (long cpu = first; cpu <= last; ++cpu) {
+                cohort_topology_set(cpu, node);
+            }
+            p = (',' == *end) ? end + 1 : end;
+        }
+    }
+    fclose(file);
+}
+
+static void cohort_topology_read(void)
+{
+    struct dirent *entry;
+    const char *env;
+    DIR *dir;
+    int node;
+
+    env = getenv("LIBULT_COHORT_BATCH");
+    if (NULL != env && atoi(env) > 0) {
+        cohort_default_batch = atoi(env);
+    }
+
+    if (NULL == (dir = opendir(COHORT_NODE_DIR))) {
+        return;
+    }
+    while (NULL != (entry = readdir(dir))) {
+        if (1 == sscanf(entry->d_name, "node%d", &node) && node >= 0) {
+            cohort_topology_read_node(node);
+        }
+    }
+    closedir(dir);
+}
+
+static void cohort_topology_init(void)
+{
+    int32_t unread = 0;
+
+    if (atomic_compare_exchange_strong_32(&cohort_topology_state, &unread, 1)) {
+        cohort_topology_read();
+        atomic_wmb();
+        cohort_topology_state = COHORT_TOPOLOGY_READY;
+        return;
+    }
+    while (COHORT_TOPOLOGY_READY != cohort_topology_state) {
+        thread_yield();
+    }
+    atomic_rmb();
+}
+
+int cohort_lock_current_node(void)
+{
+    int cpu;
+
+    if (UNLIKELY(COHORT_TOPOLOGY_READY != cohort_topology_state)) {
+        cohort_topology_init();
+    }
+    cpu = sched_getcpu();
+    if (cpu >= 0 && cpu < cohort_ncpus) {
+        return cohort_cpu_node[cpu];
+    }
+    return 0;
+}
+
+static inline void cohort_lock_wait(volatile int32_t *serving, int32_t ticket)
+{
+    int spin = 0;
+
+    while (*serving != ticket) {
+        if (++spin >= COHORT_LOCK_SPIN) {
+            thread_yield();
+        }
+    }
+    atomic_rmb();
+}
+
+void cohort_lock_lock(cohort_lock_t *lock)
+{
+    int node = cohort_lock_current_node();
+    cohort_lock_local_t *local = &lock->c_local[node];
+    int32_t ticket;
+
+    ticket = atomic_fetch_add_32(&local->next, 1);
+    cohort_lock_wait(&local->serving, ticket);
+    if (!local->global_owned) {
+        ticket = atomic_fetch_add_32(&lock->c_next, 1);
+        cohort_lock_wait(&lock->c_serving, ticket);
+    }
+    lock->c_owner_node = node;
+}
+
+int cohort_lock_trylock(cohort_lock_t *lock)
+{
+    cohort_lock_local_t *local = &lock->c_local[cohort_lock_current_node()];
+    int32_t ticket;
+
+    /* A free local lock never carries the global lock along */
+    ticket = local->serving;
+    if (local->next != ticket
+        || !atomic_compare_exchange_strong_32(&local->next, &ticket, ticket + 1)) {
+        return 1;
+    }
+    ticket = lock->c_serving;
+    if (lock->c_next == ticket
+        && atomic_compare_exchange_strong_32(&lock->c_next, &ticket, ticket + 1)) {
+        lock->c_owner_node = (int32_t) (local - lock->c_local);
+        return 0;
+    }
+    atomic_mb();
+    local->serving = local->serving + 1;
+    return 1;
+}
+
+void cohort_lock_unlock(cohort_lock_t *lock)
+{
+    cohort_lock_local_t *local = &lock->c_local[lock->c_owner_node];
+    int batch = lock->c_batch > 0 ? lock->c_batch : cohort_default_batch;
+
+    if (local->next - local->serving > 1 && local->batch < batch) {
+        /* a thread of this node is queued: hand it the global lock too */
+        ++local->batch;
+        local->global_owned = 1;
+    } else {
+        local->batch = 0;
+        local->global_owned = 0;
+        atomic_mb();
+        lock->c_serving = lock->c_serving + 1;
+    }
+    atomic_mb();
+    local->serving = local->serving + 1;
+}
+
+static void cohort_lock_constructor(cohort_lock_t *lock)
+{
+    for (int i = 0; i < COHORT_LOCK_MAX_NODES; ++i) {
+        lock->c_local[i].next = 0;
+        lock->c_local[i].serving = 0;
+        lock->c_local[i].global_owned = 0;
+        lock->c_local[i].batch = 0;
+    }
+    lock->c_next = 0;
+    lock->c_serving = 0;
+    lock->c_owner_node = 0;
+    lock->c_batch = 0;
+}
+
+OBJ_CLASS_INSTANCE(cohort_lock_t, object_t, cohort_lock_constructor, NULL);
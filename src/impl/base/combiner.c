@@ -0,0 +1,73 @@
+#include "combiner.h"
+#include "threads.h"
+
+/* Rounds a waiter polls its request before it starts yielding */
+#define COMBINER_SPIN 64
+
+/* Run everything published so far, up to COMBINER_MAX_PASSES batches.
+ * Each batch is detached with a single swap and run oldest first. */
+static void combiner_combine(combiner_t *combiner)
+{
+    combiner_request_t *batch, *request, *next;
+
+    for (int pass = 0; pass < COMBINER_MAX_PASSES; ++pass) {
+        batch = (combiner_request_t *) atomic_swap_ptr(&combiner->pending, 0);
+        if (NULL == batch) {
+            return;
+        }
+        /* published newest first, reverse it */
+        for (request = batch, batch = NULL; NULL != request; request = next) {
+            next = request->next;
+            request->next = batch;
+            batch = request;
+        }
+        for (request = batch; NULL != request; request = next) {
+            /* the owner may return and drop the request once it is done */
+            next = request->next;
+            request->fn(request->arg);
+            atomic_mb();
+            request->done = 1;
+        }
+    }
+}
+
+void combiner_execute(combiner_t *combiner, combiner_fn_t fn, void *arg)
+{
+    combiner_request_t request;
+    int32_t idle;
+    intptr_t head;
+    int spin = 0;
+
+    request.fn = fn;
+    request.arg = arg;
+    request.done = 0;
+    head = combiner->pending;
+    do {
+        request.next = (combiner_request_t *) head;
+    } while (!atomic_compare_exchange_strong_ptr(&combiner->pending, &head,
+                                                 (intptr_t) &request));
+
+    while (!request.done) {
+        idle = 0;
+        if (0 == combiner->combining
+            && atomic_compare_exchange_strong_32(&combiner->combining, &idle, 1)) {
+            combiner_combine(combiner);
+            atomic_mb();
+            combiner->combining = 0;
+            spin = 0;
+            continue;
+        }
+        if (++spin >= COMBINER_SPIN) {
+            thread_yield();
+        }
+    }
+    atomic_rmb();
+}
+
+static void combiner_constructor(combiner_t *combiner)
+{
+    combiner->pending = 0;
+    combiner->combining = 0;
+}
+
+OBJ_CLASS_INSTANCE(combiner_t, object_t, combiner_constructor, NULL);
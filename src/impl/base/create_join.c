@@ -4,6 +4,18 @@
 #include "threads.h"
 #include "tsd.h"
 
+/* threads.h only pulls in the backend headers of a single-backend
+ * build; with several, thread_start/thread_join dispatch through the
+ * ops table to the functions below */
+#if THREADS_MULTI_BACKEND
+#if THREADS_HAVE_PTHREADS
+#include "threads_pthreads.h"
+#endif
+#if THREADS_HAVE_NATIVE
+#include "threads_native.h"
+#endif
+#endif
+
 /*
  * Constructor
  */
@@ -11,34 +23,115 @@ static void thread_construct(thread_t *t)
 {
     t->t_run = 0;
     t->t_handle = (pthread_t) -1;
+    t->t_pool_slot = NULL;
 }
 
 OBJ_CLASS_INSTANCE(thread_t, object_t, thread_construct, NULL);
 
-int thread_start(thread_t *t)
+/* Plain pthreads, for the backends without threads of their own */
+static inline int thread_create_start(thread_t *t)
+{
+    int rc = pthread_create(&t->t_handle, NULL, (void *(*) (void *) ) t->t_run, t);
+
+    return 0 == rc ? SUCCESS : ERR_IN_ERRNO;
+}
+
+static inline int thread_create_join(thread_t *t, void **thr_return)
+{
+    int rc = pthread_join(t->t_handle, thr_return);
+    t->t_handle = (pthread_t) -1;
+    return 0 == rc ? SUCCESS : ERR_IN_ERRNO;
+}
+
+#if THREADS_NATIVE_THREAD
+int threads_native_thread_start(thread_t *t)
+{
+    return threads_native_spawn((void *(*) (void *) ) t->t_run, t,
+                                (threads_native_ult_t **) &t->t_pool_slot);
+}
+
+int threads_native_thread_join(thread_t *t, void **thr_return)
+{
+    int rc = threads_native_join((threads_native_ult_t *) t->t_pool_slot, thr_return);
+    t->t_pool_slot = NULL;
+    return rc;
+}
+
+bool threads_native_thread_self_compare(thread_t *t)
+{
+    if (NULL != t->t_pool_slot) {
+        return threads_native_self() == (threads_native_ult_t *) t->t_pool_slot;
+    }
+    return pthread_self() == t->t_handle;
+}
+#endif
+
+#if THREADS_PTHREADS_POOL
+int threads_pthreads_thread_start(thread_t *t)
+{
+    /* Falls back to a dedicated thread when pooling is disabled or full */
+    if (SUCCESS == threads_pthreads_pool_start(t)) {
+        return SUCCESS;
+    }
+    return thread_create_start(t);
+}
+
+int threads_pthreads_thread_join(thread_t *t, void **thr_return)
 {
-    int rc;
+    if (NULL != t->t_pool_slot) {
+        return threads_pthreads_pool_join(t, thr_return);
+    }
+    return thread_create_join(t, thr_return);
+}
+#endif
 
+int thread_start(thread_t *t)
+{
     if (ENABLE_DEBUG) {
         if (NULL == t->t_run || (pthread_t) -1 != t->t_handle) {
             return ERR_BAD_PARAM;
         }
     }
 
-    rc = pthread_create(&t->t_handle, NULL, (void *(*) (void *) ) t->t_run, t);
-
-    return 0 == rc ? SUCCESS : ERR_IN_ERRNO;
+#if THREADS_MULTI_BACKEND
+    if (NULL != threads_backend->thread_start) {
+        return threads_backend->thread_start(t);
+    }
+    return thread_create_start(t);
+#elif THREADS_NATIVE_THREAD
+    return threads_native_thread_start(t);
+#elif THREADS_PTHREADS_POOL
+    return threads_pthreads_thread_start(t);
+#else
+    return thread_create_start(t);
+#endif
 }
 
 int thread_join(thread_t *t, void **thr_return)
 {
-    int rc = pthread_join(t->t_handle, thr_return);
-    t->t_handle = (pthread_t) -1;
-    return 0 == rc ? SUCCESS : ERR_IN_ERRNO;
+#if THREADS_MULTI_BACKEND
+    if (NULL != threads_backend->thread_join) {
+        return threads_backend->thread_join(t, thr_return);
+    }
+    return thread_create_join(t, thr_return);
+#elif THREADS_NATIVE_THREAD
+    return threads_native_thread_join(t, thr_return);
+#elif THREADS_PTHREADS_POOL
+    return threads_pthreads_thread_join(t, thr_return);
+#else
+    return thread_create_join(t, thr_return);
+#endif
 }
 
 bool thread_self_compare(thread_t *t)
 {
+#if THREADS_MULTI_BACKEND
+    if (NULL != threads_backend->thread_self_compare) {
+        return threads_backend->thread_self_compare(t);
+    }
+#elif THREADS_NATIVE_THREAD
+    return threads_native_thread_self_compare(t);
+#endif
     return pthread_self() == t->t_handle;
 }
 
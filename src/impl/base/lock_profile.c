@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mutex.h"
+
+#if THREADS_LOCK_PROFILE
+
+/* Sample one acquisition in 64 per thread by default */
+uint32_t lock_profile_sample_mask = 63;
+
+static atomic_intptr_t lock_profile_sites = 0;
+static atomic_int32_t lock_profile_initialized = 0;
+static char *lock_profile_output = NULL;
+
+static void lock_profile_dump_at_exit(void)
+{
+    FILE *out;
+
+    if (0 == strcmp(lock_profile_output, "-")) {
+        lock_profile_report(stderr);
+        return;
+    }
+    out = fopen(lock_profile_output, "w");
+    if (NULL != out) {
+        lock_profile_report(out);
+        fclose(out);
+    }
+}
+
+static void lock_profile_init(void)
+{
+    int32_t uninitialized = 0;
+    const char *env;
+
+    if (!atomic_compare_exchange_strong_32(&lock_profile_initialized, &uninitialized, 1)) {
+        return;
+    }
+    env = getenv("LIBULT_LOCK_PROFILE_PERIOD");
+    if (NULL != env) {
+        lock_profile_set_period((uint32_t) strtoul(env, NULL, 10));
+    }
+    env = getenv("LIBULT_LOCK_PROFILE_OUTPUT");
+    if (NULL != env && '\0' != env[0]) {
+        lock_profile_output = strdup(env);
+        atexit(lock_profile_dump_at_exit);
+    }
+}
+
+void lock_profile_set_period(uint32_t period)
+{
+    uint32_t pow2 = 1;
+
+    /* round up to a power of two so that sampling is a mask test */
+    while (pow2 < period && pow2 < (1u << 31)) {
+        pow2 <<= 1;
+    }
+    lock_profile_sample_mask = pow2 - 1;
+}
+
+void lock_profile_register(lock_profile_site_t *site)
+{
+    int32_t unregistered = 0;
+    intptr_t head;
+
+    lock_profile_init();
+    if (!atomic_compare_exchange_strong_32(&site->registered, &unregistered, 1)) {
+        return;
+    }
+    head = lock_profile_sites;
+    do {
+        site->next = (lock_profile_site_t *) head;
+    } while (!atomic_compare_exchange_strong_ptr(&lock_profile_sites, &head, (intptr_t) site));
+}
+
+/* Upper bound, in nanoseconds, of the bucket holding the given quantile
+ * of the durations recorded in hist.  Holds dropped before the release
+ * are never recorded, so a histogram may count fewer durations than its
+ * site has samples. */
+static uint64_t lock_profile_quantile(atomic_int64_t *hist, double q)
+{
+    int64_t seen = 0, total = 0;
+
+    for (int i = 0; i < LOCK_PROFILE_BUCKETS; ++i) {
+        total += hist[i];
+    }
+    for (int i = 0; i < LOCK_PROFILE_BUCKETS; ++i) {
+        seen += hist[i];
+        if (seen > 0 && (double) seen >= q * (double) total) {
+            return 0 == i ? 0 : (uint64_t) 1 << i;
+        }
+    }
+    return (uint64_t) 1 << (LOCK_PROFILE_BUCKETS - 1);
+}
+
+static int lock_profile_compare_wait(const void *a, const void *b)
+{
+    int64_t wa = (*(lock_profile_site_t *const *) a)->wait_ns;
+    int64_t wb = (*(lock_profile_site_t *const *) b)->wait_ns;
+    return wa < wb ? 1 : (wa > wb ? -1 : 0);
+}
+
+void lock_profile_report(FILE *out)
+{
+    lock_profile_site_t **sites;
+    lock_profile_site_t *site;
+    /* sites are only ever pushed in front, the list from one head is
+     * stable while new sites register */
+    lock_profile_site_t *head = (lock_profile_site_t *) lock_profile_sites;
+    uint64_t period = (uint64_t) lock_profile_sample_mask + 1;
+    size_t n = 0;
+
+    for (site = head; NULL != site; site = site->next) {
+        ++n;
+    }
+    /* malloc(0) may return NULL, the header is still printed */
+    sites = malloc(n * sizeof(*sites));
+    if (NULL == sites && 0 != n) {
+        return;
+    }
+    n = 0;
+    for (site = head; NULL != site; site = site->next) {
+        sites[n++] = site;
+    }
+    qsort(sites, n, sizeof(*sites), lock_profile_compare_wait);
+
+    /* Counts and totals are scaled by the sampling period, latencies are
+     * the upper bound of the log2 histogram bucket */
+    fprintf(out, "# libult lock profile, sampling period %lu\n", (unsigned long) period);
+    fprintf(out, "# %14s %14s %9s %14s %10s %10s %14s %10s  %s\n", "acquisitions", "contended",
+            "contended%", "wait_ns", "wait_p50", "wait_p99", "hold_ns", "hold_p99", "site");
+    for (size_t i = 0; i < n; ++i) {
+        int64_t samples = sites[i]->samples;
+        if (0 == samples) {
+            continue;
+        }
+        fprintf(out, "  %14lu %14lu %9.2f%% %14lu %10lu %10lu %14lu %10lu  %s:%d\n",
+                (unsigned long) (samples * period), (unsigned long) (sites[i]->contended * period),
+                100.0 * (double) sites[i]->contended / (double) samples,
+                (unsigned long) (sites[i]->wait_ns * period),
+                (unsigned long) lock_profile_quantile(sites[i]->wait_hist, 0.5),
+                (unsigned long) lock_profile_quantile(sites[i]->wait_hist, 0.99),
+                (unsigned long) (sites[i]->hold_ns * period),
+                (unsigned long) lock_profile_quantile(sites[i]->hold_hist, 0.99),
+                sites[i]->file, sites[i]->line);
+    }
+    free(sites);
+}
+
+void lock_profile_reset(void)
+{
+    lock_profile_site_t *site;
+
+    for (site = (lock_profile_site_t *) lock_profile_sites; NULL != site; site = site->next) {
+        site->samples = 0;
+        site->contended = 0;
+        site->wait_ns = 0;
+        site->hold_ns = 0;
+        memset((void *) site->wait_hist, 0, sizeof(site->wait_hist));
+        memset((void *) site->hold_hist, 0, sizeof(site->hold_hist));
+    }
+}
+
+#endif /* THREADS_LOCK_PROFILE */
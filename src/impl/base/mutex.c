@@ -4,9 +4,17 @@
 
 /*
  * Wait and see if some upper layer wants to use threads, if support
- * exists.
+ * exists.  Every lock reads it; the padding of thread_usage_flag_t
+ * keeps it alone on its cache line, so no write to a neighbour
+ * invalidates the line after startup.
  */
-bool uses_threads = false;
+thread_usage_flag_t uses_threads = {
+#if THREADS_MODE_THREADED
+    .value = true,
+#else
+    .value = false,
+#endif
+};
 
 static void mca_threads_mutex_constructor(mutex_t *p_mutex)
 {
@@ -18,8 +26,16 @@ static void mca_threads_mutex_constructor(mutex_t *p_mutex)
     p_mutex->m_lock_line = 0;
 #else
     thread_internal_mutex_init(&p_mutex->m_lock, false);
+#endif
+#if THREADS_LOCK_PROFILE
+    p_mutex->m_prof_site = NULL;
+    p_mutex->m_prof_acquired = 0;
 #endif
     atomic_lock_init(&p_mutex->m_lock_atomic, 0);
+    p_mutex->m_atomic_kind = MUTEX_ATOMIC_TAS;
+    queue_lock_init(&p_mutex->m_lock_queue, false);
+    atomic_lock_init(&p_mutex->m_timed_lock, 0);
+    p_mutex->m_timed_head = NULL;
 }
 
 static void mca_threads_mutex_destructor(mutex_t *p_mutex)
@@ -37,8 +53,16 @@ static void mca_threads_recursive_mutex_constructor(recursive_mutex_t *p_mutex)
     p_mutex->m_lock_line = 0;
 #else
     thread_internal_mutex_init(&p_mutex->m_lock, true);
+#endif
+#if THREADS_LOCK_PROFILE
+    p_mutex->m_prof_site = NULL;
+    p_mutex->m_prof_acquired = 0;
 #endif
     atomic_lock_init(&p_mutex->m_lock_atomic, 0);
+    p_mutex->m_atomic_kind = MUTEX_ATOMIC_TAS;
+    queue_lock_init(&p_mutex->m_lock_queue, false);
+    atomic_lock_init(&p_mutex->m_timed_lock, 0);
+    p_mutex->m_timed_head = NULL;
 }
 
 static void mca_threads_recursive_mutex_destructor(recursive_mutex_t *p_mutex)
@@ -51,32 +75,3 @@ OBJ_CLASS_INSTANCE(mutex_t, object_t, mca_threads_mutex_constructor,
 
 OBJ_CLASS_INSTANCE(recursive_mutex_t, object_t, mca_threads_recursive_mutex_constructor,
                    mca_threads_recursive_mutex_destructor);
-
-int cond_init(cond_t *cond)
-{
-    return thread_internal_cond_init(cond);
-}
-
-int cond_wait(cond_t *cond, mutex_t *lock)
-{
-    thread_internal_cond_wait(cond, &lock->m_lock);
-    return SUCCESS;
-}
-
-int cond_broadcast(cond_t *cond)
-{
-    thread_internal_cond_broadcast(cond);
-    return SUCCESS;
-}
-
-int cond_signal(cond_t *cond)
-{
-    thread_internal_cond_signal(cond);
-    return SUCCESS;
-}
-
-int cond_destroy(cond_t *cond)
-{
-    thread_internal_cond_destroy(cond);
-    return SUCCESS;
-}
@@ -0,0 +1,171 @@
+#include <stdlib.h>
+
+#include "progress.h"
+#include "threads.h"
+
+/* Entries of each priority, never unlinked */
+static atomic_intptr_t progress_lists[PROGRESS_PRIORITIES] = {0};
+/* Unregistered entries of each priority, for registrations to recycle */
+static atomic_int32_t progress_free[PROGRESS_PRIORITIES] = {0};
+
+#if HAVE_THREAD_LOCAL
+/* Entry whose callback the thread runs, to let it unregister itself */
+static thread_local progress_entry_t *progress_current = NULL;
+#endif
+
+static inline int progress_entry_call(progress_entry_t *entry)
+{
+    int events = 0;
+#if HAVE_THREAD_LOCAL
+    progress_entry_t *outer = progress_current;
+#endif
+
+    /* pairs with the state exchange in progress_unregister; this and
+     * the decrement below are the only shared writes of a call */
+    atomic_fetch_add_32(&entry->pe_running, 1);
+    if (LIKELY(PROGRESS_ENTRY_LIVE == entry->pe_state)) {
+        atomic_rmb();
+#if HAVE_THREAD_LOCAL
+        progress_current = entry;
+        events = entry->pe_callback();
+        progress_current = outer;
+#else
+        events = entry->pe_callback();
+#endif
+    }
+    atomic_fetch_add_32(&entry->pe_running, -1);
+    return events;
+}
+
+static int progress_list(int priority, uint32_t tick)
+{
+    progress_entry_t *entry;
+    int events = 0;
+
+    for (entry = (progress_entry_t *) progress_lists[priority]; NULL != entry;
+         entry = entry->pe_next) {
+        if (PROGRESS_ENTRY_LIVE != entry->pe_state
+            || (entry->pe_interval > 1 && 0 != tick % entry->pe_interval)
+            || ((entry->pe_flags & PROGRESS_ON_DEMAND) && 0 == entry->pe_busy)) {
+            continue;
+        }
+        events += progress_entry_call(entry);
+    }
+    return events;
+}
+
+int progress(void)
+{
+#if HAVE_THREAD_LOCAL
+    static thread_local uint32_t tick = 0;
+#else
+    /* racy, it only paces the intervals */
+    static volatile uint32_t tick = 0;
+#endif
+    int events;
+
+    ++tick;
+    events = progress_list(PROGRESS_PRIORITY_HIGH, tick);
+    events += progress_list(PROGRESS_PRIORITY_NORMAL, tick);
+    if (0 == events || 0 == tick % PROGRESS_LOW_EVERY) {
+        events += progress_list(PROGRESS_PRIORITY_LOW, tick);
+    }
+    return events;
+}
+
+int progress_entry_run(progress_entry_t *entry)
+{
+    return progress_entry_call(entry);
+}
+
+/* Claim an unregistered entry of the priority, if any */
+static progress_entry_t *progress_recycle(int priority)
+{
+    progress_entry_t *entry;
+    int32_t state;
+
+    while (progress_free[priority] > 0) {
+        for (entry = (progress_entry_t *) progress_lists[priority]; NULL != entry;
+             entry = entry->pe_next) {
+            state = PROGRESS_ENTRY_FREE;
+            if (PROGRESS_ENTRY_FREE == entry->pe_state
+                && atomic_compare_exchange_strong_32(&entry->pe_state, &state,
+                                                     PROGRESS_ENTRY_CLAIMED)) {
+                atomic_fetch_add_32(&progress_free[priority], -1);
+                return entry;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Publish a new chunk, returning its first entry claimed */
+static progress_entry_t *progress_grow(int priority)
+{
+    progress_chunk_t *chunk;
+    progress_entry_t *entries;
+    intptr_t head;
+
+    if (0 != posix_memalign((void **) &chunk, 64, sizeof(*chunk))) {
+        return NULL;
+    }
+    entries = chunk->entries;
+    for (int i = 0; i < PROGRESS_ENTRY_CHUNK; ++i) {
+        entries[i].pe_state = 0 == i ? PROGRESS_ENTRY_CLAIMED : PROGRESS_ENTRY_FREE;
+        entries[i].pe_priority = priority;
+        entries[i].pe_busy = 0;
+        entries[i].pe_running = 0;
+        entries[i].pe_next = i + 1 < PROGRESS_ENTRY_CHUNK ? &entries[i + 1] : NULL;
+    }
+    head = progress_lists[priority];
+    do {
+        entries[PROGRESS_ENTRY_CHUNK - 1].pe_next = (progress_entry_t *) head;
+        atomic_wmb();
+    } while (!atomic_compare_exchange_strong_ptr(&progress_lists[priority], &head,
+                                                 (intptr_t) entries));
+    atomic_fetch_add_32(&progress_free[priority], PROGRESS_ENTRY_CHUNK - 1);
+    return entries;
+}
+
+int progress_register(progress_callback_t callback, int priority, int interval, int flags,
+                      progress_entry_t **entry)
+{
+    progress_entry_t *claimed;
+
+    if (NULL == callback || priority < 0 || priority >= PROGRESS_PRIORITIES) {
+        return ERR_BAD_PARAM;
+    }
+    claimed = progress_recycle(priority);
+    if (NULL == claimed && NULL == (claimed = progress_grow(priority))) {
+        return ERR_OUT_OF_RESOURCE;
+    }
+    claimed->pe_callback = callback;
+    claimed->pe_interval = interval > 1 ? interval : 1;
+    claimed->pe_flags = flags;
+    claimed->pe_busy = 0;
+    atomic_wmb();
+    claimed->pe_state = PROGRESS_ENTRY_LIVE;
+    *entry = claimed;
+    return SUCCESS;
+}
+
+int progress_unregister(progress_entry_t *entry)
+{
+    int32_t state = PROGRESS_ENTRY_LIVE, self = 0;
+
+    if (!atomic_compare_exchange_strong_32(&entry->pe_state, &state,
+                                           PROGRESS_ENTRY_CLAIMED)) {
+        return ERR_NOT_FOUND;
+    }
+#if HAVE_THREAD_LOCAL
+    self = entry == progress_current ? 1 : 0;
+#endif
+    /* threads that saw it live before the exchange */
+    while (entry->pe_running > self) {
+        thread_yield();
+    }
+    atomic_mb();
+    entry->pe_state = PROGRESS_ENTRY_FREE;
+    atomic_fetch_add_32(&progress_free[entry->pe_priority], 1);
+    return SUCCESS;
+}
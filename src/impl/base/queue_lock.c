@@ -0,0 +1,71 @@
+#include "queue_lock.h"
+#include "threads.h"
+
+static inline void queue_lock_pause(queue_lock_t *lock, int *spin)
+{
+    if (lock->yield && ++*spin >= QUEUE_LOCK_SPIN) {
+        thread_yield();
+    }
+}
+
+/* Contended acquisition: queue up behind the tail and spin on our own
+ * node. Once we own the lock the node is about to go away with our
+ * stack frame, so our successor, if any, is moved over to the holder
+ * node of the lock. */
+void queue_lock_wait(queue_lock_t *lock)
+{
+    queue_lock_node_t node, *prev, *succ;
+    intptr_t tail, free_tail;
+    int spin = 0;
+
+    for (;;) {
+        tail = lock->tail;
+        if (0 == tail) {
+            free_tail = 0;
+            if (atomic_compare_exchange_strong_ptr(&lock->tail, &free_tail,
+                                                   (intptr_t) &lock->holder)) {
+                return;
+            }
+            continue;
+        }
+        node.next = NULL;
+        node.waiting = 1;
+        if (atomic_compare_exchange_strong_ptr(&lock->tail, &tail, (intptr_t) &node)) {
+            break;
+        }
+    }
+    prev = (queue_lock_node_t *) tail;
+    prev->next = &node;
+
+    while (node.waiting) {
+        queue_lock_pause(lock, &spin);
+    }
+    atomic_rmb();
+
+    succ = node.next;
+    if (NULL == succ) {
+        lock->holder.next = NULL;
+        tail = (intptr_t) &node;
+        if (atomic_compare_exchange_strong_ptr(&lock->tail, &tail, (intptr_t) &lock->holder)) {
+            return;
+        }
+        /* someone queued up behind us and is about to link in */
+        while (NULL == (succ = node.next)) {
+            queue_lock_pause(lock, &spin);
+        }
+    }
+    lock->holder.next = succ;
+}
+
+/* Release with a waiter queued, or one linking in */
+void queue_lock_handoff(queue_lock_t *lock)
+{
+    queue_lock_node_t *succ;
+    int spin = 0;
+
+    while (NULL == (succ = lock->holder.next)) {
+        queue_lock_pause(lock, &spin);
+    }
+    atomic_mb();
+    succ->waiting = 0;
+}
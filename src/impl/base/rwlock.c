@@ -0,0 +1,136 @@
+#include "rwlock.h"
+#include "threads.h"
+
+/* Yields of a writer waiting for the readers before it blocks */
+#define RWLOCK_WRITER_SPIN 64
+
+static int64_t rwlock_readers(rwlock_t *rw)
+{
+    int64_t readers = 0;
+
+    for (int i = 0; i < RWLOCK_READER_SLOTS; ++i) {
+        readers += rw->rw_slots[i].count;
+    }
+    return readers;
+}
+
+/* A reader left while the writer may be blocked on the readers */
+void rwlock_wake_writer(rwlock_t *rw)
+{
+    thread_internal_mutex_lock(&rw->rw_lock);
+    thread_internal_cond_signal(&rw->rw_writer_cond);
+    thread_internal_mutex_unlock(&rw->rw_lock);
+}
+
+/* A reader announced itself in slot and found a writer. It backs off,
+ * waits for the writer to leave and comes back in while it still counts
+ * as held back, so the next writer cannot cut in before it. */
+void rwlock_rdlock_slow(rwlock_t *rw, int slot)
+{
+    atomic_fetch_add_64(&rw->rw_slots[slot].count, -1);
+
+    thread_internal_mutex_lock(&rw->rw_lock);
+    if (0 != rw->rw_writer_parked) {
+        thread_internal_cond_signal(&rw->rw_writer_cond);
+    }
+    ++rw->rw_readers_waiting;
+    while (0 != rw->rw_writer) {
+        thread_internal_cond_wait(&rw->rw_readers_cond, &rw->rw_lock);
+    }
+    atomic_fetch_add_64(&rw->rw_slots[slot].count, 1);
+    if (0 == --rw->rw_readers_waiting) {
+        thread_internal_cond_signal(&rw->rw_writer_cond);
+    }
+    thread_internal_mutex_unlock(&rw->rw_lock);
+}
+
+/* Called with rw_wmutex held: let in the readers the previous writer
+ * held back, then keep new readers out. */
+static inline void rwlock_writer_enter(rwlock_t *rw)
+{
+    thread_internal_mutex_lock(&rw->rw_lock);
+    while (0 != rw->rw_readers_waiting) {
+        thread_internal_cond_wait(&rw->rw_writer_cond, &rw->rw_lock);
+    }
+    rw->rw_writer = 1;
+    thread_internal_mutex_unlock(&rw->rw_lock);
+    atomic_mb();
+}
+
+void rwlock_wrlock(rwlock_t *rw)
+{
+    mutex_lock(&rw->rw_wmutex);
+    rwlock_writer_enter(rw);
+
+    for (int spin = 0; spin < RWLOCK_WRITER_SPIN; ++spin) {
+        if (0 == rwlock_readers(rw)) {
+            return;
+        }
+        thread_yield();
+    }
+
+    thread_internal_mutex_lock(&rw->rw_lock);
+    rw->rw_writer_parked = 1;
+    atomic_mb();
+    while (0 != rwlock_readers(rw)) {
+        thread_internal_cond_wait(&rw->rw_writer_cond, &rw->rw_lock);
+    }
+    rw->rw_writer_parked = 0;
+    thread_internal_mutex_unlock(&rw->rw_lock);
+}
+
+int rwlock_trywrlock(rwlock_t *rw)
+{
+    if (0 != mutex_trylock(&rw->rw_wmutex)) {
+        return 1;
+    }
+    thread_internal_mutex_lock(&rw->rw_lock);
+    if (0 != rw->rw_readers_waiting) {
+        thread_internal_mutex_unlock(&rw->rw_lock);
+        mutex_unlock(&rw->rw_wmutex);
+        return 1;
+    }
+    rw->rw_writer = 1;
+    thread_internal_mutex_unlock(&rw->rw_lock);
+    atomic_mb();
+    if (0 == rwlock_readers(rw)) {
+        return 0;
+    }
+    rwlock_wrunlock(rw);
+    return 1;
+}
+
+void rwlock_wrunlock(rwlock_t *rw)
+{
+    thread_internal_mutex_lock(&rw->rw_lock);
+    rw->rw_writer = 0;
+    if (0 != rw->rw_readers_waiting) {
+        thread_internal_cond_broadcast(&rw->rw_readers_cond);
+    }
+    thread_internal_mutex_unlock(&rw->rw_lock);
+    mutex_unlock(&rw->rw_wmutex);
+}
+
+static void rwlock_constructor(rwlock_t *rw)
+{
+    for (int i = 0; i < RWLOCK_READER_SLOTS; ++i) {
+        rw->rw_slots[i].count = 0;
+    }
+    rw->rw_writer = 0;
+    rw->rw_writer_parked = 0;
+    OBJ_CONSTRUCT(&rw->rw_wmutex, mutex_t);
+    thread_internal_mutex_init(&rw->rw_lock, false);
+    thread_internal_cond_init(&rw->rw_readers_cond);
+    thread_internal_cond_init(&rw->rw_writer_cond);
+    rw->rw_readers_waiting = 0;
+}
+
+static void rwlock_destructor(rwlock_t *rw)
+{
+    thread_internal_cond_destroy(&rw->rw_writer_cond);
+    thread_internal_cond_destroy(&rw->rw_readers_cond);
+    thread_internal_mutex_destroy(&rw->rw_lock);
+    OBJ_DESTRUCT(&rw->rw_wmutex);
+}
+
+OBJ_CLASS_INSTANCE(rwlock_t, object_t, rwlock_constructor, rwlock_destructor);
@@ -0,0 +1,121 @@
+#include "sema.h"
+#include "threads.h"
+
+/* Polls for a wakeup or an open latch before blocking */
+#define SEMAPHORE_SPIN 64
+
+static inline bool semaphore_take_wakeup(semaphore_t *sem)
+{
+    int32_t wakeups = sem->s_wakeups;
+
+    while (wakeups > 0) {
+        if (atomic_compare_exchange_strong_32(&sem->s_wakeups, &wakeups, wakeups - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* We are counted as a waiter: wait for a post to hand us a wakeup */
+void semaphore_wait_slow(semaphore_t *sem)
+{
+    for (int spin = 0; spin < SEMAPHORE_SPIN; ++spin) {
+        if (semaphore_take_wakeup(sem)) {
+            atomic_rmb();
+            return;
+        }
+        thread_yield();
+    }
+
+    thread_internal_mutex_lock(&sem->s_lock);
+    ++sem->s_parked;
+    while (!semaphore_take_wakeup(sem)) {
+        thread_internal_cond_wait(&sem->s_cond, &sem->s_lock);
+    }
+    --sem->s_parked;
+    thread_internal_mutex_unlock(&sem->s_lock);
+}
+
+/* The post found a waiter: the unit goes to it as a wakeup */
+void semaphore_post_slow(semaphore_t *sem)
+{
+    thread_internal_mutex_lock(&sem->s_lock);
+    atomic_fetch_add_32(&sem->s_wakeups, 1);
+    if (0 != sem->s_parked) {
+        thread_internal_cond_signal(&sem->s_cond);
+    }
+    thread_internal_mutex_unlock(&sem->s_lock);
+}
+
+void latch_wait_slow(latch_t *latch)
+{
+    int32_t count;
+
+    for (int spin = 0; spin < SEMAPHORE_SPIN; ++spin) {
+        if (latch_try_wait(latch)) {
+            return;
+        }
+        thread_yield();
+    }
+
+    thread_internal_mutex_lock(&latch->l_lock);
+    /* Announce that we are about to block, unless the latch opened in
+     * the meantime. Once announced, the last count down takes l_lock,
+     * so we may only return after it set LATCH_SIGNALED under it. */
+    count = latch->l_count;
+    do {
+        if (0 == (count & LATCH_COUNT_MASK)) {
+            thread_internal_mutex_unlock(&latch->l_lock);
+            atomic_rmb();
+            return;
+        }
+    } while (!atomic_compare_exchange_strong_32(&latch->l_count, &count, count | LATCH_PARKED));
+    while (0 == (latch->l_count & LATCH_SIGNALED)) {
+        thread_internal_cond_wait(&latch->l_cond, &latch->l_lock);
+    }
+    thread_internal_mutex_unlock(&latch->l_lock);
+    atomic_rmb();
+}
+
+/* The last count down of a latch somebody parked on. No waiter returns
+ * before the unlock, so the latch stays valid until then and is not
+ * touched afterwards. */
+void latch_release(latch_t *latch)
+{
+    thread_internal_mutex_lock(&latch->l_lock);
+    atomic_fetch_add_32(&latch->l_count, LATCH_SIGNALED);
+    thread_internal_cond_broadcast(&latch->l_cond);
+    thread_internal_mutex_unlock(&latch->l_lock);
+}
+
+static void semaphore_constructor(semaphore_t *sem)
+{
+    sem->s_count = 0;
+    sem->s_wakeups = 0;
+    sem->s_parked = 0;
+    thread_internal_mutex_init(&sem->s_lock, false);
+    thread_internal_cond_init(&sem->s_cond);
+}
+
+static void semaphore_destructor(semaphore_t *sem)
+{
+    thread_internal_cond_destroy(&sem->s_cond);
+    thread_internal_mutex_destroy(&sem->s_lock);
+}
+
+OBJ_CLASS_INSTANCE(semaphore_t, object_t, semaphore_constructor, semaphore_destructor);
+
+static void latch_constructor(latch_t *latch)
+{
+    latch->l_count = 0;
+    thread_internal_mutex_init(&latch->l_lock, false);
+    thread_internal_cond_init(&latch->l_cond);
+}
+
+static void latch_destructor(latch_t *latch)
+{
+    thread_internal_cond_destroy(&latch->l_cond);
+    thread_internal_mutex_destroy(&latch->l_lock);
+}
+
+OBJ_CLASS_INSTANCE(latch_t, object_t, latch_constructor, latch_destructor);
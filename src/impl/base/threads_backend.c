@@ -0,0 +1,130 @@
+#if THREADS_MULTI_BACKEND
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "condition.h"
+#include "threads.h"
+#include "tsd.h"
+
+/*
+ * Registry of the backends compiled into a multi-backend build.  The
+ * first one is the default, LIBULT_THREADS_BACKEND overrides it at load
+ * time and threads_backend_select() before any libult object is used.
+ */
+
+#if THREADS_HAVE_PTHREADS
+extern const threads_backend_ops_t threads_pthreads_backend_ops;
+#endif
+#if THREADS_HAVE_QTHREADS
+extern const threads_backend_ops_t threads_qthreads_backend_ops;
+#endif
+#if THREADS_HAVE_ARGOBOTS
+extern const threads_backend_ops_t threads_argobots_backend_ops;
+#endif
+#if THREADS_HAVE_NATIVE
+extern const threads_backend_ops_t threads_native_backend_ops;
+#endif
+
+static const threads_backend_ops_t *const threads_backends[] = {
+#if THREADS_HAVE_PTHREADS
+    &threads_pthreads_backend_ops,
+#endif
+#if THREADS_HAVE_QTHREADS
+    &threads_qthreads_backend_ops,
+#endif
+#if THREADS_HAVE_ARGOBOTS
+    &threads_argobots_backend_ops,
+#endif
+#if THREADS_HAVE_NATIVE
+    &threads_native_backend_ops,
+#endif
+};
+
+#if THREADS_HAVE_PTHREADS
+const threads_backend_ops_t *threads_backend = &threads_pthreads_backend_ops;
+#elif THREADS_HAVE_QTHREADS
+const threads_backend_ops_t *threads_backend = &threads_qthreads_backend_ops;
+#elif THREADS_HAVE_ARGOBOTS
+const threads_backend_ops_t *threads_backend = &threads_argobots_backend_ops;
+#else
+const threads_backend_ops_t *threads_backend = &threads_native_backend_ops;
+#endif
+
+int threads_backend_select(const char *name)
+{
+    for (size_t i = 0; i < sizeof(threads_backends) / sizeof(threads_backends[0]); ++i) {
+        if (0 == strcasecmp(name, threads_backends[i]->name)) {
+            threads_backend = threads_backends[i];
+            return SUCCESS;
+        }
+    }
+    return ERR_NOT_FOUND;
+}
+
+static void __attribute__((constructor)) threads_backend_init(void)
+{
+    const char *env = getenv("LIBULT_THREADS_BACKEND");
+
+    if (NULL != env && '\0' != env[0] && SUCCESS != threads_backend_select(env)) {
+        fprintf(stderr, "libult: threads backend \"%s\" is not available, using %s\n", env,
+                threads_backend->name);
+    }
+}
+
+/* Statically initialized objects are set up on first use, by whichever
+ * thread gets there first. */
+void threads_backend_mutex_ensure_init(thread_internal_mutex_t *p_mutex)
+{
+    int32_t uninitialized = 0;
+
+    if (atomic_compare_exchange_strong_32(&p_mutex->m_init, &uninitialized, 1)) {
+        threads_backend->mutex_init(&p_mutex->m_storage, p_mutex->m_recursive);
+        atomic_wmb();
+        p_mutex->m_init = THREADS_BACKEND_READY;
+        return;
+    }
+    while (THREADS_BACKEND_READY != p_mutex->m_init) {
+        atomic_rmb();
+    }
+}
+
+void threads_backend_cond_ensure_init(thread_internal_cond_t *p_cond)
+{
+    int32_t uninitialized = 0;
+
+    if (atomic_compare_exchange_strong_32(&p_cond->c_init, &uninitialized, 1)) {
+        threads_backend->cond_init(&p_cond->c_storage);
+        atomic_wmb();
+        p_cond->c_init = THREADS_BACKEND_READY;
+        return;
+    }
+    while (THREADS_BACKEND_READY != p_cond->c_init) {
+        atomic_rmb();
+    }
+}
+
+int tsd_key_create(tsd_key_t *key, tsd_destructor_t destructor)
+{
+    return threads_backend->tsd_key_create(key, destructor);
+}
+
+/* The backends' own *_condition.c are left out of multi-backend builds */
+static void condition_construct(condition_t *c)
+{
+    c->c_waiting = 0;
+    c->c_signaled = 0;
+    c->c_parked = 0;
+    thread_internal_cond_init(&c->c_cond);
+}
+
+static void condition_destruct(condition_t *c)
+{
+    thread_internal_cond_destroy(&c->c_cond);
+}
+
+OBJ_CLASS_INSTANCE(condition_t, object_t, condition_construct, condition_destruct);
+
+#endif /* THREADS_MULTI_BACKEND */
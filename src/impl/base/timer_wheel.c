@@ -0,0 +1,438 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "threads.h"
+#include "timer_wheel.h"
+
+/*
+ * The wheel and its service thread are plain pthreads objects whatever
+ * the backend: the service thread is a kernel thread, and it only hands
+ * expired timers to callbacks, which wake the sleepers through backend
+ * primitives.
+ */
+
+static pthread_mutex_t wheel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wheel_cond;
+static bool wheel_started = false;
+
+static ult_timer_t *wheel[ULT_TIMER_LEVELS][ULT_TIMER_SLOTS];
+/* armed timers, in total and per level */
+static int wheel_count = 0;
+static int wheel_level_count[ULT_TIMER_LEVELS];
+/* next tick to process */
+static uint64_t wheel_now = 0;
+/* tick the service thread sleeps until, UINT64_MAX without timers */
+static uint64_t wheel_wakeup = UINT64_MAX;
+
+#define ULT_TIMER_LEVEL_SHIFT(level) ((level) * ULT_TIMER_SLOT_BITS)
+#define ULT_TIMER_MAX_DELTA ((uint64_t) 1 << ULT_TIMER_LEVEL_SHIFT(ULT_TIMER_LEVELS))
+
+static inline uint64_t wheel_tick_now(void)
+{
+    return ult_timer_now() / ULT_TIMER_TICK_NS;
+}
+
+static void wheel_insert(ult_timer_t *timer)
+{
+    uint64_t expires = timer->t_expires;
+    uint64_t delta = expires - wheel_now;
+    ult_timer_t **slot;
+    int level = 0;
+
+    if (delta >= ULT_TIMER_MAX_DELTA) {
+        /* park it in the farthest slot, it is placed again on cascade */
+        expires = wheel_now + ULT_TIMER_MAX_DELTA - 1;
+        delta = ULT_TIMER_MAX_DELTA - 1;
+    }
+    while (delta >= ((uint64_t) 1 << ULT_TIMER_LEVEL_SHIFT(level + 1))) {
+        ++level;
+    }
+    slot = &wheel[level][(expires >> ULT_TIMER_LEVEL_SHIFT(level)) & (ULT_TIMER_SLOTS - 1)];
+
+    timer->t_next = *slot;
+    if (NULL != *slot) {
+        (*slot)->t_pprev = &timer->t_next;
+    }
+    timer->t_pprev = slot;
+    *slot = timer;
+    timer->t_level = level;
+    ++wheel_level_count[level];
+}
+
+/* Move the timers of the upper level slots that tick enters down the
+ * wheel. wheel_now has to be tick already. */
+static void wheel_cascade(uint64_t tick)
+{
+    int top = 0;
+
+    while (top + 1 < ULT_TIMER_LEVELS
+           && 0 == (tick & (((uint64_t) 1 << ULT_TIMER_LEVEL_SHIFT(top + 1)) - 1))) {
+        ++top;
+    }
+    for (int level = top; level > 0; --level) {
+        ult_timer_t **slot = &wheel[level][(tick >> ULT_TIMER_LEVEL_SHIFT(level))
+                                           & (ULT_TIMER_SLOTS - 1)];
+        ult_timer_t *timer = *slot, *next;
+
+        *slot = NULL;
+        for (; NULL != timer; timer = next) {
+            next = timer->t_next;
+            --wheel_level_count[level];
+            wheel_insert(timer);
+        }
+    }
+}
+
+/* First tick at which something may expire or cascade */
+static uint64_t wheel_next_tick(void)
+{
+    uint64_t next = UINT64_MAX, span, cascade;
+
+    /* level 0 has a slot for each of the ticks from wheel_now on */
+    if (0 != wheel_level_count[0]) {
+        for (uint64_t tick = wheel_now; tick < wheel_now + ULT_TIMER_SLOTS; ++tick) {
+            if (NULL != wheel[0][tick & (ULT_TIMER_SLOTS - 1)]) {
+                next = tick;
+                break;
+            }
+        }
+    }
+    /* the upper levels only matter once they cascade, and the lowest
+     * one that holds a timer cascades first */
+    for (int level = 1; level < ULT_TIMER_LEVELS; ++level) {
+        if (0 != wheel_level_count[level]) {
+            span = (uint64_t) 1 << ULT_TIMER_LEVEL_SHIFT(level);
+            cascade = (wheel_now + span - 1) & ~(span - 1);
+            return cascade < next ? cascade : next;
+        }
+    }
+    return next;
+}
+
+static void *wheel_service(void *arg)
+{
+    ult_timer_t *batch, *timer, *next;
+    struct timespec ts;
+    uint64_t tick, now;
+
+    (void) arg;
+    pthread_mutex_lock(&wheel_lock);
+    for (;;) {
+        tick = wheel_next_tick();
+        now = wheel_tick_now();
+        if (tick > now) {
+            wheel_wakeup = tick;
+            if (UINT64_MAX == tick) {
+                pthread_cond_wait(&wheel_cond, &wheel_lock);
+            } else {
+                ts.tv_sec = (time_t) (tick * ULT_TIMER_TICK_NS / 1000000000);
+                ts.tv_nsec = (long) (tick * ULT_TIMER_TICK_NS % 1000000000);
+                pthread_cond_timedwait(&wheel_cond, &wheel_lock, &ts);
+            }
+            wheel_wakeup = UINT64_MAX;
+            continue;
+        }
+
+        /* Collect everything that expired up to now into one batch */
+        batch = NULL;
+        while (tick <= now) {
+            ult_timer_t **slot = &wheel[0][tick & (ULT_TIMER_SLOTS - 1)];
+
+            wheel_now = tick;
+            wheel_cascade(tick);
+            for (timer = *slot; NULL != timer; timer = next) {
+                next = timer->t_next;
+                timer->t_level = -1;
+                timer->t_next = batch;
+                batch = timer;
+                --wheel_level_count[0];
+                --wheel_count;
+            }
+            *slot = NULL;
+            wheel_now = tick + 1;
+            tick = wheel_next_tick();
+        }
+        if (0 == wheel_count) {
+            wheel_now = now + 1;
+        }
+        pthread_mutex_unlock(&wheel_lock);
+
+        /* The callback may release the timer, read the link first */
+        for (timer = batch; NULL != timer; timer = next) {
+            next = timer->t_next;
+            timer->t_fn(timer);
+        }
+        pthread_mutex_lock(&wheel_lock);
+    }
+    return NULL;
+}
+
+/* Called with the wheel lock held */
+static int wheel_start(void)
+{
+    pthread_condattr_t attr;
+    pthread_attr_t thread_attr;
+    pthread_t thread;
+    int rc;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wheel_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    rc = pthread_create(&thread, &thread_attr, wheel_service, NULL);
+    pthread_attr_destroy(&thread_attr);
+    if (0 != rc) {
+        pthread_cond_destroy(&wheel_cond);
+        return ERR_OUT_OF_RESOURCE;
+    }
+    wheel_now = wheel_tick_now();
+    wheel_started = true;
+    return SUCCESS;
+}
+
+int ult_timer_add(ult_timer_t *timer, uint64_t deadline, ult_timer_fn_t fn)
+{
+    uint64_t expires = (deadline + ULT_TIMER_TICK_NS - 1) / ULT_TIMER_TICK_NS;
+    int rc;
+
+    timer->t_fn = fn;
+    pthread_mutex_lock(&wheel_lock);
+    if (UNLIKELY(!wheel_started) && SUCCESS != (rc = wheel_start())) {
+        pthread_mutex_unlock(&wheel_lock);
+        return rc;
+    }
+    if (0 == wheel_count) {
+        /* idle wheel, no need to walk the ticks it slept through */
+        wheel_now = wheel_tick_now();
+    }
+    timer->t_expires = expires < wheel_now ? wheel_now : expires;
+    wheel_insert(timer);
+    ++wheel_count;
+    if (timer->t_expires < wheel_wakeup) {
+        pthread_cond_signal(&wheel_cond);
+    }
+    pthread_mutex_unlock(&wheel_lock);
+    return SUCCESS;
+}
+
+bool ult_timer_cancel(ult_timer_t *timer)
+{
+    bool pending;
+
+    pthread_mutex_lock(&wheel_lock);
+    pending = -1 != timer->t_level;
+    if (pending) {
+        *timer->t_pprev = timer->t_next;
+        if (NULL != timer->t_next) {
+            timer->t_next->t_pprev = timer->t_pprev;
+        }
+        --wheel_level_count[timer->t_level];
+        --wheel_count;
+        timer->t_level = -1;
+    }
+    pthread_mutex_unlock(&wheel_lock);
+    return pending;
+}
+
+/* A thread or ULT blocked until its timer fires */
+typedef struct {
+    ult_timer_t timer;
+    thread_internal_mutex_t lock;
+    thread_internal_cond_t cond;
+    bool fired;
+} ult_timer_sleeper_t;
+
+static void ult_timer_sleeper_fire(ult_timer_t *timer)
+{
+    ult_timer_sleeper_t *sleeper = (ult_timer_sleeper_t *) timer;
+
+    thread_internal_mutex_lock(&sleeper->lock);
+    sleeper->fired = true;
+    thread_internal_cond_signal(&sleeper->cond);
+    thread_internal_mutex_unlock(&sleeper->lock);
+}
+
+void ult_sleep_until(uint64_t deadline)
+{
+    ult_timer_sleeper_t sleeper;
+    uint64_t now = ult_timer_now();
+    struct timespec ts;
+
+    if (deadline <= now) {
+        return;
+    }
+    sleeper.fired = false;
+    thread_internal_mutex_init(&sleeper.lock, false);
+    thread_internal_cond_init(&sleeper.cond);
+
+    thread_internal_mutex_lock(&sleeper.lock);
+    if (SUCCESS == ult_timer_add(&sleeper.timer, deadline, ult_timer_sleeper_fire)) {
+        while (!sleeper.fired) {
+            thread_internal_cond_wait(&sleeper.cond, &sleeper.lock);
+        }
+        thread_internal_mutex_unlock(&sleeper.lock);
+    } else {
+        /* no timer service, block the OS thread instead */
+        thread_internal_mutex_unlock(&sleeper.lock);
+        ts.tv_sec = (time_t) ((deadline - now) / 1000000000);
+        ts.tv_nsec = (long) ((deadline - now) % 1000000000);
+        while (0 != nanosleep(&ts, &ts) && EINTR == errno) {
+        }
+    }
+
+    thread_internal_cond_destroy(&sleeper.cond);
+    thread_internal_mutex_destroy(&sleeper.lock);
+}
+
+/*
+ * A caller of mutex_timedlock parked on the mutex.  Waiters queue in
+ * FIFO order under m_timed_lock; mutex_unlock dequeues the first one
+ * and wakes it, and its deadline timer wakes it otherwise.  A waiter
+ * that loses the mutex to a barging locker goes back to the front.
+ */
+typedef struct mutex_timed_waiter_t {
+    ult_timer_sleeper_t sleeper;
+    struct mutex_timed_waiter_t *next;
+    /* on the queue, under m_timed_lock */
+    bool queued;
+    /* dequeued and woken by an unlock, under sleeper.lock */
+    bool woken;
+} mutex_timed_waiter_t;
+
+static void mutex_timed_enqueue(mutex_t *mutex, mutex_timed_waiter_t *waiter, bool front)
+{
+    mutex_timed_waiter_t *volatile *link = &mutex->m_timed_head;
+
+    atomic_lock(&mutex->m_timed_lock);
+    while (!front && NULL != *link) {
+        link = &(*link)->next;
+    }
+    waiter->next = *link;
+    waiter->queued = true;
+    *link = waiter;
+    atomic_unlock(&mutex->m_timed_lock);
+}
+
+/* Returns false if an unlock dequeued the waiter first */
+static bool mutex_timed_withdraw(mutex_t *mutex, mutex_timed_waiter_t *waiter)
+{
+    mutex_timed_waiter_t *volatile *link = &mutex->m_timed_head;
+    bool withdrawn = false;
+
+    atomic_lock(&mutex->m_timed_lock);
+    if (waiter->queued) {
+        while (waiter != *link) {
+            link = &(*link)->next;
+        }
+        *link = waiter->next;
+        waiter->queued = false;
+        withdrawn = true;
+    }
+    atomic_unlock(&mutex->m_timed_lock);
+    return withdrawn;
+}
+
+void mutex_timed_wake(mutex_t *mutex)
+{
+    mutex_timed_waiter_t *waiter;
+
+    atomic_lock(&mutex->m_timed_lock);
+    waiter = mutex->m_timed_head;
+    if (NULL != waiter) {
+        mutex->m_timed_head = waiter->next;
+        waiter->queued = false;
+    }
+    atomic_unlock(&mutex->m_timed_lock);
+    if (NULL == waiter) {
+        return;
+    }
+
+    /* A dequeued waiter stays until it sees woken */
+    thread_internal_mutex_lock(&waiter->sleeper.lock);
+    waiter->woken = true;
+    thread_internal_cond_signal(&waiter->sleeper.cond);
+    thread_internal_mutex_unlock(&waiter->sleeper.lock);
+}
+
+int mutex_timedlock(mutex_t *mutex, uint64_t deadline)
+{
+    mutex_timed_waiter_t waiter;
+    bool front = false;
+    int rc = ERR_TIMEOUT;
+
+    if (0 == mutex_trylock(mutex)) {
+        return SUCCESS;
+    }
+    if (ult_timer_now() >= deadline) {
+        return ERR_TIMEOUT;
+    }
+
+    waiter.sleeper.fired = false;
+    waiter.queued = false;
+    waiter.woken = false;
+    thread_internal_mutex_init(&waiter.sleeper.lock, false);
+    thread_internal_cond_init(&waiter.sleeper.cond);
+
+    if (SUCCESS != ult_timer_add(&waiter.sleeper.timer, deadline, ult_timer_sleeper_fire)) {
+        /* no timer service, poll until the deadline */
+        while (0 != mutex_trylock(mutex)) {
+            if (ult_timer_now() >= deadline) {
+                goto out;
+            }
+            thread_yield();
+        }
+        rc = SUCCESS;
+        goto out;
+    }
+
+    thread_internal_mutex_lock(&waiter.sleeper.lock);
+    for (;;) {
+        waiter.woken = false;
+        mutex_timed_enqueue(mutex, &waiter, front);
+        /* against mutex_unlock releasing before it saw the queue */
+        atomic_mb();
+        if (0 == mutex_trylock(mutex)) {
+            rc = SUCCESS;
+            break;
+        }
+        while (!waiter.woken && !waiter.sleeper.fired) {
+            thread_internal_cond_wait(&waiter.sleeper.cond, &waiter.sleeper.lock);
+        }
+        /* Also the last attempt at the deadline: a mutex released by
+         * cond_wait wakes no one */
+        if (0 == mutex_trylock(mutex)) {
+            rc = SUCCESS;
+            break;
+        }
+        if (waiter.sleeper.fired) {
+            break;
+        }
+        front = true;
+    }
+    thread_internal_mutex_unlock(&waiter.sleeper.lock);
+
+    if (!mutex_timed_withdraw(mutex, &waiter)) {
+        thread_internal_mutex_lock(&waiter.sleeper.lock);
+        while (!waiter.woken) {
+            thread_internal_cond_wait(&waiter.sleeper.cond, &waiter.sleeper.lock);
+        }
+        thread_internal_mutex_unlock(&waiter.sleeper.lock);
+    }
+    if (!ult_timer_cancel(&waiter.sleeper.timer)) {
+        thread_internal_mutex_lock(&waiter.sleeper.lock);
+        while (!waiter.sleeper.fired) {
+            thread_internal_cond_wait(&waiter.sleeper.cond, &waiter.sleeper.lock);
+        }
+        thread_internal_mutex_unlock(&waiter.sleeper.lock);
+    }
+
+out:
+    thread_internal_cond_destroy(&waiter.sleeper.cond);
+    thread_internal_mutex_destroy(&waiter.sleeper.lock);
+    return rc;
+}
@@ -1,48 +1,136 @@
+#include <stdlib.h>
+
+#include "threads.h"
 #include "tsd.h"
 
+/* Exit destructors between their first and last access to an item. A
+ * key teardown waits for them before it frees the chunks. */
+static atomic_int32_t tsd_tracked_exiting = 0;
+
+/* Thread exit: hand the item back to the key's registry. The key
+ * teardown may race for the item, whoever turns it from live to free
+ * runs the user destructor. */
 static void _tracked_destructor(void *arg)
 {
     tsd_list_item_t *tsd = NULL;
     tsd_tracked_key_t *key = NULL;
+    tsd_destructor_t user_destructor;
+    int32_t live = TSD_ITEM_LIVE;
+    void *data;
+
     if (NULL == arg) {
         return;
     }
 
+    atomic_add_fetch_32(&tsd_tracked_exiting, 1);
     tsd = (tsd_list_item_t *) arg;
     key = tsd->tracked_key;
+    user_destructor = key->user_destructor;
+    /* the item may be claimed by another thread as soon as it is free,
+     * so it is counted free before it is */
+    data = tsd->data;
+    atomic_add_fetch_32(&key->free_items, 1);
+    if (!atomic_compare_exchange_strong_32(&tsd->state, &live, TSD_ITEM_FREE)) {
+        /* the key teardown took it */
+        atomic_add_fetch_32(&key->free_items, -1);
+        atomic_add_fetch_32(&tsd_tracked_exiting, -1);
+        return;
+    }
+    atomic_add_fetch_32(&tsd_tracked_exiting, -1);
 
-    mutex_lock(&key->mutex);
-    list_remove_item(&key->tsd_list, &tsd->super);
-    mutex_unlock(&key->mutex);
-
-    if (NULL != key->user_destructor) {
-        key->user_destructor(tsd->data);
+    if (NULL != user_destructor) {
+        user_destructor(data);
     }
-    OBJ_RELEASE(tsd);
 }
 
 void tsd_tracked_key_constructor(tsd_tracked_key_t *key)
 {
-    OBJ_CONSTRUCT(&key->mutex, mutex_t);
-    OBJ_CONSTRUCT(&key->tsd_list, list_t);
+    key->items = 0;
+    key->chunks = 0;
+    key->free_items = 0;
     key->user_destructor = NULL;
     tsd_key_create(&key->key, _tracked_destructor);
 }
 
 void tsd_tracked_key_destructor(tsd_tracked_key_t *key)
 {
-    tsd_list_item_t *tsd, *next;
+    tsd_list_item_t *tsd;
+    tsd_list_chunk_t *chunk, *next;
+    int32_t live;
 
     tsd_key_delete(key->key);
-    LIST_FOREACH_SAFE (tsd, next, &key->tsd_list, tsd_list_item_t) {
-        list_remove_item(&key->tsd_list, &tsd->super);
-        if (NULL != key->user_destructor) {
+
+    /* Detach the whole registry at once; the items are never unlinked
+     * one by one, they go away with their chunks. */
+    tsd = (tsd_list_item_t *) atomic_swap_ptr(&key->items, 0);
+    for (; NULL != tsd; tsd = tsd->next) {
+        live = TSD_ITEM_LIVE;
+        if (atomic_compare_exchange_strong_32(&tsd->state, &live, TSD_ITEM_FREE)
+            && NULL != key->user_destructor) {
             key->user_destructor(tsd->data);
         }
-        OBJ_RELEASE(tsd);
     }
-    OBJ_DESTRUCT(&key->mutex);
-    OBJ_DESTRUCT(&key->tsd_list);
+    /* threads that were exiting as the key went away may still be on
+     * their items */
+    while (0 != tsd_tracked_exiting) {
+        thread_yield();
+    }
+    atomic_rmb();
+    chunk = (tsd_list_chunk_t *) atomic_swap_ptr(&key->chunks, 0);
+    for (; NULL != chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    key->free_items = 0;
+}
+
+/* Claim a free item of the registry, or grow it by one chunk */
+static tsd_list_item_t *tsd_tracked_key_claim(tsd_tracked_key_t *key)
+{
+    tsd_list_item_t *tsd;
+    tsd_list_chunk_t *chunk;
+    int32_t free_state;
+    intptr_t head;
+
+    if (0 < key->free_items) {
+        for (tsd = (tsd_list_item_t *) key->items; NULL != tsd; tsd = tsd->next) {
+            free_state = TSD_ITEM_FREE;
+            if (TSD_ITEM_FREE == tsd->state
+                && atomic_compare_exchange_strong_32(&tsd->state, &free_state,
+                                                     TSD_ITEM_LIVE)) {
+                atomic_add_fetch_32(&key->free_items, -1);
+                return tsd;
+            }
+        }
+    }
+
+    chunk = (tsd_list_chunk_t *) malloc(sizeof(*chunk));
+    if (NULL == chunk) {
+        return NULL;
+    }
+    for (int i = 0; i < TSD_TRACKED_KEY_CHUNK; ++i) {
+        chunk->items[i].tracked_key = key;
+        chunk->items[i].data = NULL;
+        chunk->items[i].state = TSD_ITEM_FREE;
+        chunk->items[i].next = &chunk->items[i + 1];
+    }
+    tsd = &chunk->items[0];
+    tsd->state = TSD_ITEM_LIVE;
+
+    head = key->chunks;
+    do {
+        chunk->next = (tsd_list_chunk_t *) head;
+    } while (!atomic_compare_exchange_strong_ptr(&key->chunks, &head, (intptr_t) chunk));
+
+    /* publish the items of the chunk with a single push, counted free
+     * before they can be claimed */
+    atomic_add_fetch_32(&key->free_items, TSD_TRACKED_KEY_CHUNK - 1);
+    head = key->items;
+    do {
+        chunk->items[TSD_TRACKED_KEY_CHUNK - 1].next = (tsd_list_item_t *) head;
+    } while (!atomic_compare_exchange_strong_ptr(&key->items, &head, (intptr_t) tsd));
+
+    return tsd;
 }
 
 int tsd_tracked_key_set(tsd_tracked_key_t *key, void *p)
@@ -52,19 +140,16 @@ int tsd_tracked_key_set(tsd_tracked_key_t *key, void *p)
     tsd_list_item_t *tsd = NULL;
     tsd_get(key->key, (void **) &tsd);
 
-    if (NULL == tsd) {
-        tsd = OBJ_NEW(tsd_list_item_t);
-        if (NULL == tsd) {
-            return ERR_OUT_OF_RESOURCE;
-        }
-
-        mutex_lock(&key->mutex);
-        list_append(&key->tsd_list, &tsd->super);
-        mutex_unlock(&key->mutex);
+    if (NULL != tsd) {
+        tsd->data = p;
+        return SUCCESS;
     }
 
+    tsd = tsd_tracked_key_claim(key);
+    if (NULL == tsd) {
+        return ERR_OUT_OF_RESOURCE;
+    }
     tsd->data = p;
-    tsd->tracked_key = key;
 
     return tsd_set(key->key, (void *) tsd);
 }
@@ -76,6 +161,5 @@ void tsd_tracked_key_set_destructor(tsd_tracked_key_t *key,
     key->user_destructor = destructor;
 }
 
-OBJ_CLASS_INSTANCE(tsd_list_item_t, list_item_t, NULL, NULL);
 OBJ_CLASS_INSTANCE(tsd_tracked_key_t, object_t, tsd_tracked_key_constructor,
                    tsd_tracked_key_destructor);
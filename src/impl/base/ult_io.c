@@ -0,0 +1,344 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* accept4 */
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if THREADS_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "progress.h"
+#include "threads.h"
+#include "ult_io.h"
+#include "wait_sync.h"
+
+#if THREADS_USE_IO_URING
+
+#define ULT_IO_RING_READY 2
+#define ULT_IO_RING_NONE 3
+
+/* Lives on the stack of the waiting thread until its completion is
+ * reaped */
+typedef struct {
+    ompi_wait_sync_t sync;
+    int32_t result;
+} ult_io_request_t;
+
+typedef struct {
+    int fd;
+    /* submission ring, under sq_lock */
+    thread_internal_mutex_t sq_lock;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    /* completion ring, reaped by one thread at a time */
+    atomic_int32_t cq_reaping;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    int32_t cq_entries;
+    /* busy while requests are in flight, counting them */
+    progress_entry_t *progress;
+} ult_io_ring_t;
+
+static ult_io_ring_t ult_io_ring = {.fd = -1, .sq_lock = THREAD_INTERNAL_MUTEX_INITIALIZER};
+static atomic_int32_t ult_io_ring_state = 0;
+
+/* Reap every completion posted so far and complete their syncs */
+static int ult_io_progress(void)
+{
+    ult_io_ring_t *ring = &ult_io_ring;
+    ult_io_request_t *request;
+    struct io_uring_cqe *cqe;
+    unsigned head, tail;
+    int32_t idle = 0;
+    int reaped = 0;
+
+    if (0 != ring->cq_reaping
+        || !atomic_compare_exchange_strong_32(&ring->cq_reaping, &idle, 1)) {
+        return 0;
+    }
+    head = *ring->cq_head;
+    tail = *(volatile unsigned *) ring->cq_tail;
+    atomic_rmb();
+    for (; head != tail; ++head, ++reaped) {
+        cqe = &ring->cqes[head & *ring->cq_mask];
+        request = (ult_io_request_t *) (uintptr_t) cqe->user_data;
+        request->result = cqe->res;
+        /* the waiter may return and drop the request from here on */
+        wait_sync_update(&request->sync, 1, SUCCESS);
+    }
+    /* the kernel reuses the entries once the head moves past them */
+    atomic_mb();
+    *(volatile unsigned *) ring->cq_head = head;
+    if (0 != reaped) {
+        atomic_fetch_add_32(&ring->progress->pe_busy, -reaped);
+    }
+    atomic_mb();
+    ring->cq_reaping = 0;
+    return reaped;
+}
+
+/* Whether the kernel behind fd knows every opcode we submit.  Setup
+ * alone succeeds from 5.1 on, but IORING_OP_ACCEPT came with 5.5 and
+ * IORING_OP_READ/WRITE with 5.6, the same release as the probe itself:
+ * a kernel that cannot answer the probe cannot run our requests. */
+static bool ult_io_ring_probe(int fd)
+{
+    static const uint8_t ops[] = {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_ACCEPT};
+    struct io_uring_probe *probe;
+    bool supported = false;
+    size_t i;
+
+    probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+    if (NULL == probe) {
+        return false;
+    }
+    if (0 == syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256)) {
+        supported = true;
+        for (i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+            if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+                supported = false;
+                break;
+            }
+        }
+    }
+    free(probe);
+    return supported;
+}
+
+static bool ult_io_ring_setup(void)
+{
+    ult_io_ring_t *ring = &ult_io_ring;
+    unsigned entries = ULT_IO_URING_ENTRIES;
+    struct io_uring_params params;
+    size_t sq_size, cq_size;
+    char *sq, *cq;
+    const char *env;
+    void *sqes;
+
+    env = getenv("LIBULT_IO_URING");
+    if (NULL != env && 0 == atoi(env)) {
+        return false;
+    }
+    env = getenv("LIBULT_IO_URING_ENTRIES");
+    if (NULL != env && atoi(env) > 0) {
+        entries = (unsigned) atoi(env);
+    }
+
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return false;
+    }
+    if (!ult_io_ring_probe(ring->fd)) {
+        goto close_ring;
+    }
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+    }
+    sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+              IORING_OFF_SQ_RING);
+    if (MAP_FAILED == sq) {
+        goto close_ring;
+    }
+    cq = sq;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                  IORING_OFF_CQ_RING);
+        if (MAP_FAILED == cq) {
+            goto unmap_sq;
+        }
+    }
+    sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (MAP_FAILED == sqes) {
+        goto unmap_cq;
+    }
+
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->sqes = (struct io_uring_sqe *) sqes;
+    ring->cq_reaping = 0;
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    ring->cq_entries = (int32_t) params.cq_entries;
+    if (SUCCESS
+        == progress_register(ult_io_progress, PROGRESS_PRIORITY_HIGH, 1, PROGRESS_ON_DEMAND,
+                             &ring->progress)) {
+        return true;
+    }
+
+    munmap(sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+unmap_cq:
+    if (cq != sq) {
+        munmap(cq, cq_size);
+    }
+unmap_sq:
+    munmap(sq, sq_size);
+close_ring:
+    close(ring->fd);
+    ring->fd = -1;
+    return false;
+}
+
+/* Whether calls go through the ring, set up on first use */
+static bool ult_io_use_ring(void)
+{
+    int32_t unset = 0;
+
+    /* threads that are not multiplexed are better off blocking */
+    if (!using_threads() || !THREAD_YIELD_WHEN_IDLE_DEFAULT) {
+        return false;
+    }
+    if (LIKELY(ULT_IO_RING_READY == ult_io_ring_state)) {
+        return true;
+    }
+    if (atomic_compare_exchange_strong_32(&ult_io_ring_state, &unset, 1)) {
+        unset = ult_io_ring_setup() ? ULT_IO_RING_READY : ULT_IO_RING_NONE;
+        atomic_wmb();
+        ult_io_ring_state = unset;
+    }
+    while (1 == ult_io_ring_state) {
+        thread_yield();
+    }
+    atomic_rmb();
+    return ULT_IO_RING_READY == ult_io_ring_state;
+}
+
+/* Submit a request and wait for its completion. Returns false if it
+ * could not be submitted, for the caller to fall back to the system
+ * call. */
+static bool ult_io_submit(const struct io_uring_sqe *prepared, ssize_t *result)
+{
+    ult_io_ring_t *ring = &ult_io_ring;
+    ult_io_request_t request;
+    struct io_uring_sqe *sqe;
+    unsigned tail, index;
+    int ret;
+
+    WAIT_SYNC_INIT(&request.sync, 1);
+    wait_sync_set_progress(&request.sync, ring->progress);
+
+    /* keep the requests in flight within the completion ring */
+    while (atomic_add_fetch_32(&ring->progress->pe_busy, 1) > ring->cq_entries) {
+        atomic_fetch_add_32(&ring->progress->pe_busy, -1);
+        if (0 == ult_io_progress()) {
+            thread_yield();
+        }
+    }
+
+    thread_internal_mutex_lock(&ring->sq_lock);
+    tail = *ring->sq_tail;
+    index = tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    *sqe = *prepared;
+    sqe->user_data = (uint64_t) (uintptr_t) &request;
+    ring->sq_array[index] = index;
+    atomic_wmb();
+    *(volatile unsigned *) ring->sq_tail = tail + 1;
+    do {
+        ret = (int) syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0);
+    } while (ret < 0 && EINTR == errno);
+    if (1 != ret) {
+        /* nothing was consumed, the kernel only reads the ring in enter */
+        *(volatile unsigned *) ring->sq_tail = tail;
+    }
+    thread_internal_mutex_unlock(&ring->sq_lock);
+    if (1 != ret) {
+        atomic_fetch_add_32(&ring->progress->pe_busy, -1);
+        return false;
+    }
+
+    SYNC_WAIT(&request.sync);
+    atomic_rmb();
+    *result = request.result;
+    return true;
+}
+
+static inline ssize_t ult_io_result(ssize_t result)
+{
+    if (result < 0) {
+        errno = (int) -result;
+        return -1;
+    }
+    return result;
+}
+
+#endif /* THREADS_USE_IO_URING */
+
+ssize_t ult_io_read(int fd, void *buf, size_t count, off_t offset)
+{
+#if THREADS_USE_IO_URING
+    struct io_uring_sqe sqe;
+    ssize_t result;
+
+    if (ult_io_use_ring()) {
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = (uint64_t) (uintptr_t) buf;
+        sqe.len = (uint32_t) count;
+        sqe.off = (uint64_t) offset;
+        if (ult_io_submit(&sqe, &result)) {
+            return ult_io_result(result);
+        }
+    }
+#endif
+    return -1 == offset ? read(fd, buf, count) : pread(fd, buf, count, offset);
+}
+
+ssize_t ult_io_write(int fd, const void *buf, size_t count, off_t offset)
+{
+#if THREADS_USE_IO_URING
+    struct io_uring_sqe sqe;
+    ssize_t result;
+
+    if (ult_io_use_ring()) {
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_WRITE;
+        sqe.fd = fd;
+        sqe.addr = (uint64_t) (uintptr_t) buf;
+        sqe.len = (uint32_t) count;
+        sqe.off = (uint64_t) offset;
+        if (ult_io_submit(&sqe, &result)) {
+            return ult_io_result(result);
+        }
+    }
+#endif
+    return -1 == offset ? write(fd, buf, count) : pwrite(fd, buf, count, offset);
+}
+
+int ult_io_accept(int fd, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+#if THREADS_USE_IO_URING
+    struct io_uring_sqe sqe;
+    ssize_t result;
+
+    if (ult_io_use_ring()) {
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_ACCEPT;
+        sqe.fd = fd;
+        sqe.addr = (uint64_t) (uintptr_t) addr;
+        sqe.addr2 = (uint64_t) (uintptr_t) addrlen;
+        sqe.accept_flags = (uint32_t) flags;
+        if (ult_io_submit(&sqe, &result)) {
+            return (int) ult_io_result(result);
+        }
+    }
+#endif
+    return accept4(fd, addr, addrlen, flags);
+}
@@ -1,32 +1,294 @@
+#include <stddef.h>
+
+#include "timer_wheel.h"
 #include "wait_sync.h"
 
-static mutex_t wait_sync_lock = MUTEX_STATIC_INIT;
+/* A thread blocked in ompi_sync_wait_mt or ompi_sync_wait_many_mt. It
+ * lives on the waiter's stack and carries everything needed to park the
+ * thread, so that the syncs themselves stay small and need no backend
+ * objects. */
+typedef struct wait_sync_waiter_t {
+    /* syncs waited for, a single one for ompi_sync_wait_mt */
+    ompi_wait_sync_t **syncs;
+    int count;
+    /* WAIT_SYNC_ANY or WAIT_SYNC_ALL */
+    int mode;
+    /* completions of parked syncs left before the waiter is woken up,
+     * under lock */
+    int wake_after;
+    /* withdrawing from the syncs, every completion wakes the waiter */
+    bool draining;
+    thread_internal_cond_t condition;
+    thread_internal_mutex_t lock;
+    struct wait_sync_waiter_t *next;
+    struct wait_sync_waiter_t *prev;
+    /* deadline of a timed wait, set under lock when it passes */
+    ult_timer_t timer;
+    volatile bool timedout;
+} wait_sync_waiter_t;
+
+/* Waiters are spread over independently locked shards so that
+ * registering and unregistering a waiter does not serialize all threads
+ * on a single lock.  The progress manager is elected through
+ * wait_sync_progress_owner instead of being the head of a global list. */
+#define WAIT_SYNC_SHARD_BITS 6
+#define WAIT_SYNC_NUM_SHARDS (1 << WAIT_SYNC_SHARD_BITS)
+
+typedef struct {
+    mutex_t lock;
+    wait_sync_waiter_t *head;
+} __attribute__((aligned(64))) wait_sync_shard_t;
+
+static wait_sync_shard_t wait_sync_shards[WAIT_SYNC_NUM_SHARDS] = {
+    [0 ... WAIT_SYNC_NUM_SHARDS - 1] = {.lock = MUTEX_STATIC_INIT, .head = NULL}};
+
+/* The waiter currently responsible for progress, if any */
+static atomic_intptr_t wait_sync_progress_owner = 0;
+
 ompi_wait_sync_t *threads_base_wait_sync_list = NULL; /* not static for inline "wait_sync_st" */
 
+/* syncs of a single threaded ompi_sync_wait_many_st */
+static ompi_wait_sync_t **wait_sync_st_many = NULL;
+static int wait_sync_st_many_count = 0;
+
+/* Passes of a waiter over the callbacks of its syncs before it runs the
+ * whole engine once, for the waiters parked behind it */
+#define WAIT_SYNC_FULL_PROGRESS 16
+
+/* Poll the callbacks bound to the pending syncs, or every callback if
+ * one of them is unbound */
+int wait_sync_progress(ompi_wait_sync_t **syncs, int count)
+{
+#if HAVE_THREAD_LOCAL
+    static thread_local uint32_t passes = 0;
+#else
+    static volatile uint32_t passes = 0;
+#endif
+    progress_entry_t *last = NULL;
+    int events = 0;
+
+    if (0 == ++passes % WAIT_SYNC_FULL_PROGRESS) {
+        return progress();
+    }
+    for (int i = 0; i < count; ++i) {
+        if (NULL == syncs[i]->progress && 0 != wait_sync_count(syncs[i])) {
+            return progress();
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        if (0 != wait_sync_count(syncs[i]) && last != syncs[i]->progress) {
+            last = syncs[i]->progress;
+            events += progress_entry_run(last);
+        }
+    }
+    return events;
+}
+
+/* Whether a wait over syncs is satisfied */
+static inline bool wait_sync_many_done(ompi_wait_sync_t **syncs, int count, int mode)
+{
+    int completed = 0;
+
+    for (int i = 0; i < count; ++i) {
+        if (0 == wait_sync_count(syncs[i])) {
+            if (WAIT_SYNC_ANY == mode) {
+                return true;
+            }
+            ++completed;
+        }
+    }
+    return completed == count;
+}
+
+/* List the completed syncs, and fold their status. A wait that timed
+ * out still succeeds if the syncs listed satisfy it. */
+static int wait_sync_many_report(ompi_wait_sync_t **syncs, int count, int mode, bool timedout,
+                                 int *indices, int *ncompleted)
+{
+    int completed = 0, rc = SUCCESS;
+
+    for (int i = 0; i < count; ++i) {
+        if (0 != wait_sync_count(syncs[i])) {
+            continue;
+        }
+        if (0 != syncs[i]->status) {
+            rc = ERROR;
+        }
+        if (NULL != indices) {
+            indices[completed] = i;
+        }
+        ++completed;
+    }
+    if (NULL != ncompleted) {
+        *ncompleted = completed;
+    }
+    if (timedout && (WAIT_SYNC_ANY == mode ? 0 == completed : completed < count)) {
+        return ERR_TIMEOUT;
+    }
+    return rc;
+}
+
+static inline int wait_sync_shard_index(wait_sync_waiter_t *waiter)
+{
+    /* Fibonacci hashing: waiters live on thread stacks that only
+     * differ in their high bits, so mix every bit into the index. */
+    return (int) (((uint64_t)(uintptr_t) waiter * 0x9E3779B97F4A7C15ULL)
+                  >> (64 - WAIT_SYNC_SHARD_BITS));
+}
+
+static inline void wait_sync_shard_insert(wait_sync_shard_t *shard, wait_sync_waiter_t *waiter)
+{
+    THREAD_LOCK(&shard->lock);
+    waiter->prev = NULL;
+    waiter->next = shard->head;
+    if (NULL != shard->head) {
+        shard->head->prev = waiter;
+    }
+    shard->head = waiter;
+    THREAD_UNLOCK(&shard->lock);
+}
+
+static inline void wait_sync_shard_remove(wait_sync_shard_t *shard, wait_sync_waiter_t *waiter)
+{
+    THREAD_LOCK(&shard->lock);
+    if (NULL != waiter->prev) {
+        waiter->prev->next = waiter->next;
+    } else {
+        shard->head = waiter->next;
+    }
+    if (NULL != waiter->next) {
+        waiter->next->prev = waiter->prev;
+    }
+    THREAD_UNLOCK(&shard->lock);
+}
+
 void threads_base_wait_sync_global_wakeup_st(int status)
 {
-    ompi_wait_sync_t *sync;
-    for (sync = threads_base_wait_sync_list; sync != NULL; sync = sync->next) {
-        wait_sync_update(sync, 0, status);
+    if (SUCCESS != status && NULL != threads_base_wait_sync_list) {
+        wait_sync_update(threads_base_wait_sync_list, 0, status);
+    }
+    for (int i = 0; SUCCESS != status && i < wait_sync_st_many_count; ++i) {
+        wait_sync_update(wait_sync_st_many[i], 0, status);
     }
 }
 
 void threads_base_wait_sync_global_wakeup_mt(int status)
+{
+    wait_sync_waiter_t *waiter;
+
+    if (SUCCESS == status) {
+        return;
+    }
+    for (int i = 0; i < WAIT_SYNC_NUM_SHARDS; ++i) {
+        wait_sync_shard_t *shard = &wait_sync_shards[i];
+        mutex_lock(&shard->lock);
+        for (waiter = shard->head; waiter != NULL; waiter = waiter->next) {
+            /* sync_update is going to  take the waiter->lock from within
+             * the shard lock. Thread lightly here: Idealy we should
+             * find a way to not take a lock in a lock as this is deadlock prone,
+             * but as of today we are the only place doing this so it is safe.
+             */
+            for (int j = 0; j < waiter->count; ++j) {
+                wait_sync_update(waiter->syncs[j], 0, status);
+            }
+        }
+        mutex_unlock(&shard->lock);
+    }
+}
+
+/* Only called for a sync whose count just dropped to zero while its
+ * waiter was parked. The waiter does not return before it sees
+ * WAIT_SYNC_SIGNALED under its lock, so the waiter stays valid until
+ * the unlock below. A waiter over several syncs is only woken up by the
+ * completion that satisfies it.
+ *
+ * The count of a completed sync stays at zero, so this runs once per
+ * wait; it still trades WAIT_SYNC_PARKED for WAIT_SYNC_SIGNALED and
+ * forgets the waiter, so that nothing points at the waiter's stack
+ * once it returns. */
+void threads_base_wait_sync_signal(ompi_wait_sync_t *sync)
+{
+    wait_sync_waiter_t *waiter = sync->waiter;
+
+    thread_internal_mutex_lock(&waiter->lock);
+    sync->waiter = NULL;
+    atomic_fetch_add_32(&sync->state, WAIT_SYNC_SIGNALED - WAIT_SYNC_PARKED);
+    if (0 == --waiter->wake_after || waiter->draining) {
+        thread_internal_cond_signal(&waiter->condition);
+    }
+    thread_internal_mutex_unlock(&waiter->lock);
+}
+
+/* Announce that the waiter is about to block. Fails if the sync
+ * completed in the meantime. */
+static inline bool wait_sync_park(ompi_wait_sync_t *sync)
+{
+    int32_t state = sync->state;
+    do {
+        if (0 == (state & WAIT_SYNC_COUNT_MASK)) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_strong_32(&sync->state, &state, state | WAIT_SYNC_PARKED));
+    return true;
+}
+
+/* Withdraw the parked announcement. Fails if the sync completed, in
+ * which case the completer is bound to signal the waiter. */
+static inline bool wait_sync_unpark(ompi_wait_sync_t *sync)
+{
+    int32_t state = sync->state;
+    do {
+        if (0 == (state & WAIT_SYNC_COUNT_MASK)) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_strong_32(&sync->state, &state, state & ~WAIT_SYNC_PARKED));
+    return true;
+}
+
+/* Announce on all its syncs that the waiter is about to block, with its
+ * lock held. Returns false if the wait is already satisfied. */
+static bool wait_sync_waiter_park(wait_sync_waiter_t *waiter)
+{
+    int parked = 0, completed = 0;
+
+    for (int i = 0; i < waiter->count; ++i) {
+        if (wait_sync_park(waiter->syncs[i])) {
+            ++parked;
+        } else {
+            ++completed;
+        }
+    }
+    waiter->draining = false;
+    if (WAIT_SYNC_ANY == waiter->mode) {
+        waiter->wake_after = 1;
+        return 0 == completed;
+    }
+    waiter->wake_after = parked;
+    return 0 != parked;
+}
+
+/* Withdraw from all the syncs the waiter is parked on, with its lock
+ * held. Waits for the signal of those that completed in the meantime,
+ * so that no completer still uses the waiter afterwards. */
+static void wait_sync_waiter_unpark(wait_sync_waiter_t *waiter)
 {
     ompi_wait_sync_t *sync;
-    mutex_lock(&wait_sync_lock);
-    for (sync = threads_base_wait_sync_list; sync != NULL; sync = sync->next) {
-        /* sync_update is going to  take the sync->lock from within
-         * the wait_sync_lock. Thread lightly here: Idealy we should
-         * find a way to not take a lock in a lock as this is deadlock prone,
-         * but as of today we are the only place doing this so it is safe.
-         */
-        wait_sync_update(sync, 0, status);
-        if (sync->next == threads_base_wait_sync_list) {
-            break; /* special case for rings */
+
+    waiter->draining = true;
+    for (int i = 0; i < waiter->count; ++i) {
+        sync = waiter->syncs[i];
+        if (0 == (sync->state & WAIT_SYNC_PARKED) || wait_sync_unpark(sync)) {
+            continue;
+        }
+        while (0 == (sync->state & WAIT_SYNC_SIGNALED)) {
+            thread_internal_cond_wait(&waiter->condition, &waiter->lock);
         }
     }
-    mutex_unlock(&wait_sync_lock);
+}
+
+static inline bool wait_sync_waiter_done(wait_sync_waiter_t *waiter)
+{
+    return wait_sync_many_done(waiter->syncs, waiter->count, waiter->mode);
 }
 
 static atomic_int32_t num_thread_in_progress = 0;
@@ -38,85 +300,214 @@ static atomic_int32_t num_thread_in_progress = 0;
         thread_internal_mutex_unlock(&(who)->lock);     \
     } while (0)
 
-int ompi_sync_wait_mt(ompi_wait_sync_t *sync)
+/* Hand the progress duties to a registered waiter whose sync is still
+ * pending. Whatever state it is in, the candidate passes them on again
+ * when its own sync completes. Waiters only become visible in a shard
+ * once their registration is complete, so taking their lock from within
+ * the shard lock is safe. */
+static void wait_sync_pass_ownership(int start)
 {
-    /* Don't stop if the waiting synchronization is completed. We avoid the
-     * race condition around the release of the synchronization using the
-     * signaling field.
-     */
-    if (sync->count <= 0) {
-        return (0 == sync->status) ? SUCCESS : ERROR;
+    wait_sync_waiter_t *waiter;
+
+    for (int i = 0; i < WAIT_SYNC_NUM_SHARDS; ++i) {
+        wait_sync_shard_t *shard = &wait_sync_shards[(start + i) & (WAIT_SYNC_NUM_SHARDS - 1)];
+        intptr_t no_owner = 0;
+        if (NULL == shard->head) {
+            continue;
+        }
+        THREAD_LOCK(&shard->lock);
+        waiter = shard->head;
+        while (NULL != waiter && wait_sync_waiter_done(waiter)) {
+            waiter = waiter->next;
+        }
+        if (NULL == waiter) {
+            THREAD_UNLOCK(&shard->lock);
+            continue;
+        }
+        /* A newcomer may have claimed the duties in the meantime */
+        if (atomic_compare_exchange_strong_ptr(&wait_sync_progress_owner, &no_owner,
+                                               (intptr_t) waiter)) {
+            WAIT_SYNC_PASS_OWNERSHIP(waiter);
+        }
+        THREAD_UNLOCK(&shard->lock);
+        return;
     }
+}
 
-    /* lock so nobody can signal us during the list updating */
-    thread_internal_mutex_lock(&sync->lock);
+static void wait_sync_timer_fire(ult_timer_t *timer)
+{
+    wait_sync_waiter_t *waiter = (wait_sync_waiter_t *) ((char *) timer
+                                                         - offsetof(wait_sync_waiter_t, timer));
 
-    /* Now that we hold the lock make sure another thread has not already
-     * call cond_signal.
-     */
-    if (sync->count <= 0) {
-        thread_internal_mutex_unlock(&sync->lock);
-        return (0 == sync->status) ? SUCCESS : ERROR;
+    thread_internal_mutex_lock(&waiter->lock);
+    waiter->timedout = true;
+    thread_internal_cond_signal(&waiter->condition);
+    thread_internal_mutex_unlock(&waiter->lock);
+}
+
+/* Wait for any or all of count syncs, until deadline on CLOCK_MONOTONIC
+ * if it is not 0 */
+static int wait_sync_wait(ompi_wait_sync_t **syncs, int count, int mode, uint64_t deadline,
+                          int *indices, int *ncompleted)
+{
+    wait_sync_waiter_t waiter;
+    intptr_t no_owner;
+    int shard_index;
+    bool timedout = false;
+    int rc;
+
+    /* Don't stop if the waiting synchronization is completed. */
+    if (wait_sync_many_done(syncs, count, mode)) {
+        return wait_sync_many_report(syncs, count, mode, false, indices, ncompleted);
     }
 
-    /* Insert sync on the list of pending synchronization constructs */
-    THREAD_LOCK(&wait_sync_lock);
-    if (NULL == threads_base_wait_sync_list) {
-        sync->next = sync->prev = sync;
-        threads_base_wait_sync_list = sync;
-    } else {
-        sync->prev = threads_base_wait_sync_list->prev;
-        sync->prev->next = sync;
-        sync->next = threads_base_wait_sync_list;
-        threads_base_wait_sync_list->prev = sync;
+    waiter.syncs = syncs;
+    waiter.count = count;
+    waiter.mode = mode;
+    waiter.wake_after = 0;
+    waiter.draining = false;
+    waiter.timedout = false;
+    thread_internal_cond_init(&waiter.condition);
+    thread_internal_mutex_init(&waiter.lock, false);
+    if (0 != deadline
+        && SUCCESS != (rc = ult_timer_add(&waiter.timer, deadline, wait_sync_timer_fire))) {
+        thread_internal_cond_destroy(&waiter.condition);
+        thread_internal_mutex_destroy(&waiter.lock);
+        return rc;
+    }
+    for (int i = 0; i < count; ++i) {
+        syncs[i]->waiter = &waiter;
     }
-    THREAD_UNLOCK(&wait_sync_lock);
+
+    /* lock so nobody can signal us during the list updating */
+    thread_internal_mutex_lock(&waiter.lock);
+
+    /* Publish the waiter in its shard before looking at the progress
+     * owner: a departing owner clears the owner and then scans the
+     * shards, so at least one of us sees the other. */
+    shard_index = wait_sync_shard_index(&waiter);
+    wait_sync_shard_insert(&wait_sync_shards[shard_index], &waiter);
+    atomic_mb();
 
     /**
      * If we are not responsible for progressing, go silent until something
      * worth noticing happen:
      *  - this thread has been promoted to take care of the progress
-     *  - our sync has been triggered.
+     *  - enough of our syncs have been triggered
+     *  - the deadline passed.
      */
 check_status:
-    if (sync != threads_base_wait_sync_list && num_thread_in_progress >= max_thread_in_progress) {
-        thread_internal_cond_wait(&sync->condition, &sync->lock);
+    no_owner = 0;
+    if (!atomic_compare_exchange_strong_ptr(&wait_sync_progress_owner, &no_owner,
+                                            (intptr_t) &waiter)
+        && (intptr_t) &waiter != no_owner && num_thread_in_progress >= max_thread_in_progress) {
+        if (wait_sync_waiter_park(&waiter) && !waiter.timedout) {
+            thread_internal_cond_wait(&waiter.condition, &waiter.lock);
+        }
 
         /**
-         * At this point either the sync was completed in which case
+         * At this point either the wait was satisfied in which case
          * we should remove it from the wait list, or/and I was
-         * promoted as the progress manager.
+         * promoted as the progress manager, or/and the deadline passed.
+         * The completers of the syncs that completed meanwhile owe us a
+         * signal, wait for them so that they are done with the syncs
+         * before we hand them back.
          */
-
-        if (sync->count <= 0) { /* Completed? */
-            thread_internal_mutex_unlock(&sync->lock);
+        wait_sync_waiter_unpark(&waiter);
+        if (wait_sync_waiter_done(&waiter)) {
+            thread_internal_mutex_unlock(&waiter.lock);
+            goto i_am_done;
+        }
+        if (waiter.timedout) {
+            thread_internal_mutex_unlock(&waiter.lock);
+            timedout = true;
             goto i_am_done;
         }
         /* either promoted, or spurious wakeup ! */
         goto check_status;
     }
-    thread_internal_mutex_unlock(&sync->lock);
+    thread_internal_mutex_unlock(&waiter.lock);
 
     THREAD_ADD_FETCH32(&num_thread_in_progress, 1);
-    while (sync->count > 0) { /* progress till completion */
-        /* don't progress with the sync lock locked or you'll deadlock */
-        progress();
+    while (!wait_sync_waiter_done(&waiter)) { /* progress till completion */
+        /* don't progress with the waiter lock locked or you'll deadlock.
+         * On a backend that multiplexes ULTs over workers, a pass that
+         * completed nothing hands the worker over, lest the owner starve
+         * the ULTs queued behind it, the ones its syncs wait for
+         * included. */
+        if (0 == wait_sync_progress(syncs, count) && THREAD_YIELD_WHEN_IDLE_DEFAULT) {
+            thread_yield();
+        }
+        if (UNLIKELY(waiter.timedout)) {
+            timedout = !wait_sync_waiter_done(&waiter);
+            break;
+        }
     }
     THREAD_ADD_FETCH32(&num_thread_in_progress, -1);
 
 i_am_done:
-    /* My sync is now complete. Trim the list: remove self, wake next */
-    THREAD_LOCK(&wait_sync_lock);
-    sync->prev->next = sync->next;
-    sync->next->prev = sync->prev;
+    /* My wait is now satisfied, or I gave up on it. Remove self from the
+     * shard */
+    wait_sync_shard_remove(&wait_sync_shards[shard_index], &waiter);
+
     /* In case I am the progress manager, pass the duties on */
-    if (sync == threads_base_wait_sync_list) {
-        threads_base_wait_sync_list = (sync == sync->next) ? NULL : sync->next;
-        if (NULL != threads_base_wait_sync_list) {
-            WAIT_SYNC_PASS_OWNERSHIP(threads_base_wait_sync_list);
+    no_owner = (intptr_t) &waiter;
+    if (atomic_compare_exchange_strong_ptr(&wait_sync_progress_owner, &no_owner, 0)) {
+        wait_sync_pass_ownership(shard_index);
+    }
+
+    /* A timer that already fired may still be signaling us */
+    if (0 != deadline && !ult_timer_cancel(&waiter.timer)) {
+        thread_internal_mutex_lock(&waiter.lock);
+        while (!waiter.timedout) {
+            thread_internal_cond_wait(&waiter.condition, &waiter.lock);
+        }
+        thread_internal_mutex_unlock(&waiter.lock);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        syncs[i]->waiter = NULL;
+    }
+    thread_internal_cond_destroy(&waiter.condition);
+    thread_internal_mutex_destroy(&waiter.lock);
+
+    return wait_sync_many_report(syncs, count, mode, timedout, indices, ncompleted);
+}
+
+int ompi_sync_wait_mt(ompi_wait_sync_t *sync)
+{
+    return wait_sync_wait(&sync, 1, WAIT_SYNC_ALL, 0, NULL, NULL);
+}
+
+int ompi_sync_wait_until_mt(ompi_wait_sync_t *sync, uint64_t deadline)
+{
+    return wait_sync_wait(&sync, 1, WAIT_SYNC_ALL, deadline, NULL, NULL);
+}
+
+int ompi_sync_wait_many_mt(ompi_wait_sync_t **syncs, int count, int mode, uint64_t deadline,
+                           int *indices, int *ncompleted)
+{
+    return wait_sync_wait(syncs, count, mode, deadline, indices, ncompleted);
+}
+
+int ompi_sync_wait_many_st(ompi_wait_sync_t **syncs, int count, int mode, uint64_t deadline,
+                           int *indices, int *ncompleted)
+{
+    bool timedout = false;
+
+    assert(NULL == wait_sync_st_many);
+    wait_sync_st_many = syncs;
+    wait_sync_st_many_count = count;
+
+    while (!wait_sync_many_done(syncs, count, mode)) {
+        wait_sync_progress(syncs, count);
+        if (0 != deadline && ult_timer_now() >= deadline) {
+            timedout = !wait_sync_many_done(syncs, count, mode);
+            break;
         }
     }
-    THREAD_UNLOCK(&wait_sync_lock);
+    wait_sync_st_many = NULL;
+    wait_sync_st_many_count = 0;
 
-    return (0 == sync->status) ? SUCCESS : ERROR;
+    return wait_sync_many_report(syncs, count, mode, timedout, indices, ncompleted);
 }
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Native M:N scheduler.
+ *
+ * ULTs run on a fixed set of workers, OS threads each with a run queue
+ * of its own; a worker that runs out of work steals from the others and
+ * sleeps once nobody has any.  The thread that first uses the backend
+ * becomes worker 0 and keeps running its own code as a ULT bound to
+ * it.  Context switches are a few instructions of hand-written assembly
+ * on x86-64 and AArch64, and ucontext elsewhere.
+ *
+ * A ULT always switches to its worker's scheduler context, never
+ * directly to another ULT; what it asked for (yield, park, exit) is
+ * carried out by the scheduler once the ULT's registers are saved, so
+ * another worker can never resume a ULT that is still running.
+ *
+ * Threads the scheduler does not know about (other than worker 0's
+ * thread) may use the primitives too: they park by polling.
+ */
+
+#if !defined(__x86_64__) && !defined(__aarch64__)
+#include <ucontext.h>
+#define THREADS_NATIVE_UCONTEXT 1
+#endif
+
+/* thread_start/thread_join run thread_t as ULTs, see create_join.c */
+#define THREADS_NATIVE_THREAD 1
+
+/* Default ULT stack size, LIBULT_NATIVE_STACK_SIZE overrides it */
+#define THREADS_NATIVE_STACK_SIZE (128 * 1024)
+
+/* Slots for tsd keys, see tsd_key_create */
+#define THREADS_NATIVE_KEYS 128
+
+/* A key is its slot plus THREADS_NATIVE_KEYS times the number of keys
+ * created in that slot so far, so it is never below THREADS_NATIVE_KEYS
+ * and no two keys of a slot are equal */
+#define THREADS_NATIVE_KEY_SLOT(key) ((key) % THREADS_NATIVE_KEYS)
+
+/* Value of a ULT in a tsd slot, owned by the key it was set with */
+typedef struct {
+  uintptr_t t_key;
+  void *t_value;
+} threads_native_tsd_t;
+
+typedef struct {
+#if THREADS_NATIVE_UCONTEXT
+  ucontext_t uc;
+#else
+  /* saved stack pointer, the registers are on the stack */
+  void *sp;
+#endif
+} threads_native_context_t;
+
+typedef void (*threads_native_fn_t)(void *arg);
+
+typedef struct threads_native_ult_t {
+  threads_native_context_t u_context;
+  /* run queue link */
+  struct threads_native_ult_t *u_next;
+  /* wakeups not consumed yet, -1 while parked */
+  atomic_int32_t u_permit;
+  /* only ever runs on this worker, -1 for any */
+  int32_t u_bound;
+  /* not scheduled: a thread foreign to the scheduler */
+  bool u_external;
+  void *(*u_fn)(void *);
+  void *u_arg;
+  void *u_result;
+  /* 0, the joining ULT, THREADS_NATIVE_EXITING while the joiner is
+   * being woken, then THREADS_NATIVE_JOINED */
+  atomic_intptr_t u_join;
+  threads_native_tsd_t *u_tsd;
+  /* mapping holding the stack and this record, NULL if not ours */
+  void *u_stack;
+  size_t u_stack_size;
+} threads_native_ult_t;
+
+#define THREADS_NATIVE_JOINED ((intptr_t) 1)
+#define THREADS_NATIVE_EXITING ((intptr_t) 2)
+
+DECLSPEC void threads_native_context_switch(threads_native_context_t *from,
+                                            threads_native_context_t *to);
+DECLSPEC void threads_native_context_init(threads_native_context_t *context,
+                                          void *stack, size_t size,
+                                          threads_native_fn_t fn, void *arg);
+
+DECLSPEC void threads_native_init(void);
+DECLSPEC extern volatile bool threads_native_initialized;
+
+static inline void threads_ensure_init_native(void) {
+  if (UNLIKELY(!threads_native_initialized)) {
+    threads_native_init();
+  }
+}
+
+/**
+ * Calling ULT, or the record of a thread foreign to the scheduler.
+ */
+DECLSPEC threads_native_ult_t *threads_native_self(void);
+
+/**
+ * Let the other ULTs of the worker run.
+ */
+DECLSPEC void threads_native_yield(void);
+
+/**
+ * Block the caller until threads_native_unpark, or return right away
+ * if an unpark came first.  May return spuriously, callers wait for a
+ * condition of their own.
+ */
+DECLSPEC void threads_native_park(void);
+DECLSPEC void threads_native_unpark(threads_native_ult_t *ult);
+
+/**
+ * Start a ULT running fn(arg), to be joined with threads_native_join.
+ */
+DECLSPEC int threads_native_spawn(void *(*fn)(void *), void *arg,
+                                  threads_native_ult_t **ult);
+DECLSPEC int threads_native_join(threads_native_ult_t *ult, void **result);
+
+/* thread_start/thread_join/thread_self_compare of a thread_t run as a
+ * ULT, see create_join.c */
+struct thread_t;
+DECLSPEC int threads_native_thread_start(struct thread_t *t);
+DECLSPEC int threads_native_thread_join(struct thread_t *t, void **thr_return);
+DECLSPEC bool threads_native_thread_self_compare(struct thread_t *t);
+
+/**
+ * Claim a tsd slot of every ULT.  Values of a deleted key are not
+ * cleared, but they stay tagged with it: a key created later in the
+ * same slot reads NULL in every ULT until it sets a value of its own.
+ */
+DECLSPEC int threads_native_key_create(uintptr_t *key,
+                                       void (*destructor)(void *));
+DECLSPEC int threads_native_key_delete(uintptr_t key);
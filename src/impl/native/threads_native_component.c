@@ -0,0 +1,15 @@
+#include "threads_native.h"
+#include "threads.h"
+
+static int threads_native_open(void);
+static int threads_native_register(void);
+
+int threads_native_register(void)
+{
+    return SUCCESS;
+}
+
+int threads_native_open(void)
+{
+    return SUCCESS;
+}
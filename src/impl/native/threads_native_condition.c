@@ -0,0 +1,17 @@
+#include "condition.h"
+
+static void condition_construct(condition_t *c)
+{
+    c->c_waiting = 0;
+    c->c_signaled = 0;
+    c->c_parked = 0;
+    thread_internal_cond_init(&c->c_cond);
+}
+
+static void condition_destruct(condition_t *c)
+{
+    thread_internal_cond_destroy(&c->c_cond);
+}
+
+OBJ_CLASS_INSTANCE(condition_t, object_t, condition_construct,
+                   condition_destruct);
@@ -0,0 +1,164 @@
+#include <stdlib.h>
+
+#include "threads.h"
+#include "threads_native.h"
+
+/*
+ * threads_native_context_switch(from, to) saves the callee-saved
+ * registers on the current stack, stores the stack pointer into
+ * from->sp, loads to->sp and restores the registers saved there.
+ * Everything the ABI lets a call clobber is left to the compiler.
+ *
+ * A new context gets a frame that restores into
+ * threads_native_context_start with the entry point and its argument
+ * in callee-saved registers; the entry point never returns.
+ */
+
+#if defined(__APPLE__)
+#define THREADS_NATIVE_FUNCTION(name) ".globl _" #name "\n_" #name ":\n"
+#else
+#define THREADS_NATIVE_FUNCTION(name)                                                              \
+    ".globl " #name "\n.type " #name ", @function\n" #name ":\n"
+#endif
+
+#if defined(__x86_64__)
+
+/* rbp, rbx, r12-r15, then mxcsr and the x87 control word */
+#define THREADS_NATIVE_FRAME_WORDS 7
+
+__asm__(".text\n"
+        ".p2align 4\n" THREADS_NATIVE_FUNCTION(threads_native_context_switch)
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r12\n"
+        "    pushq %r13\n"
+        "    pushq %r14\n"
+        "    pushq %r15\n"
+        "    subq $8, %rsp\n"
+        "    stmxcsr (%rsp)\n"
+        "    fnstcw 4(%rsp)\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq (%rsi), %rsp\n"
+        "    ldmxcsr (%rsp)\n"
+        "    fldcw 4(%rsp)\n"
+        "    addq $8, %rsp\n"
+        "    popq %r15\n"
+        "    popq %r14\n"
+        "    popq %r13\n"
+        "    popq %r12\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".p2align 4\n" THREADS_NATIVE_FUNCTION(threads_native_context_start)
+        "    movq %r13, %rdi\n"
+        "    callq *%r12\n"
+        "    ud2\n");
+
+void threads_native_context_start(void);
+
+void threads_native_context_init(threads_native_context_t *context, void *stack, size_t size,
+                                 threads_native_fn_t fn, void *arg)
+{
+    /* the return slot sits where a call would have put it, so that the
+     * stack is 16-byte aligned at the call of fn */
+    uintptr_t top = ((uintptr_t) stack + size) & ~(uintptr_t) 15;
+    uint64_t *frame = (uint64_t *) (top - 8) - THREADS_NATIVE_FRAME_WORDS;
+
+    frame[0] = 0x1F80 | ((uint64_t) 0x037F << 32); /* default mxcsr, x87 control */
+    frame[1] = 0;                                  /* r15 */
+    frame[2] = 0;                                  /* r14 */
+    frame[3] = (uint64_t) (uintptr_t) arg;         /* r13 */
+    frame[4] = (uint64_t) (uintptr_t) fn;          /* r12 */
+    frame[5] = 0;                                  /* rbx */
+    frame[6] = 0;                                  /* rbp */
+    frame[7] = (uint64_t) (uintptr_t) threads_native_context_start;
+    context->sp = frame;
+}
+
+#elif defined(__aarch64__)
+
+/* x19-x30 and d8-d15 */
+#define THREADS_NATIVE_FRAME_WORDS 20
+
+__asm__(".text\n"
+        ".p2align 4\n" THREADS_NATIVE_FUNCTION(threads_native_context_switch)
+        "    sub sp, sp, #160\n"
+        "    stp x19, x20, [sp, #0]\n"
+        "    stp x21, x22, [sp, #16]\n"
+        "    stp x23, x24, [sp, #32]\n"
+        "    stp x25, x26, [sp, #48]\n"
+        "    stp x27, x28, [sp, #64]\n"
+        "    stp x29, x30, [sp, #80]\n"
+        "    stp d8, d9, [sp, #96]\n"
+        "    stp d10, d11, [sp, #112]\n"
+        "    stp d12, d13, [sp, #128]\n"
+        "    stp d14, d15, [sp, #144]\n"
+        "    mov x2, sp\n"
+        "    str x2, [x0]\n"
+        "    ldr x2, [x1]\n"
+        "    mov sp, x2\n"
+        "    ldp x19, x20, [sp, #0]\n"
+        "    ldp x21, x22, [sp, #16]\n"
+        "    ldp x23, x24, [sp, #32]\n"
+        "    ldp x25, x26, [sp, #48]\n"
+        "    ldp x27, x28, [sp, #64]\n"
+        "    ldp x29, x30, [sp, #80]\n"
+        "    ldp d8, d9, [sp, #96]\n"
+        "    ldp d10, d11, [sp, #112]\n"
+        "    ldp d12, d13, [sp, #128]\n"
+        "    ldp d14, d15, [sp, #144]\n"
+        "    add sp, sp, #160\n"
+        "    ret\n"
+        ".p2align 4\n" THREADS_NATIVE_FUNCTION(threads_native_context_start)
+        "    mov x0, x20\n"
+        "    blr x19\n"
+        "    brk #0\n");
+
+void threads_native_context_start(void);
+
+void threads_native_context_init(threads_native_context_t *context, void *stack, size_t size,
+                                 threads_native_fn_t fn, void *arg)
+{
+    uintptr_t top = ((uintptr_t) stack + size) & ~(uintptr_t) 15;
+    uint64_t *frame = (uint64_t *) top - THREADS_NATIVE_FRAME_WORDS;
+
+    for (int i = 0; i < THREADS_NATIVE_FRAME_WORDS; ++i) {
+        frame[i] = 0;
+    }
+    frame[0] = (uint64_t) (uintptr_t) fn;                           /* x19 */
+    frame[1] = (uint64_t) (uintptr_t) arg;                          /* x20 */
+    frame[11] = (uint64_t) (uintptr_t) threads_native_context_start; /* x30 */
+    context->sp = frame;
+}
+
+#else /* THREADS_NATIVE_UCONTEXT */
+
+void threads_native_context_switch(threads_native_context_t *from, threads_native_context_t *to)
+{
+    swapcontext(&from->uc, &to->uc);
+}
+
+/* makecontext only passes int arguments portably */
+static void threads_native_context_entry(unsigned fn_hi, unsigned fn_lo, unsigned arg_hi,
+                                         unsigned arg_lo)
+{
+    threads_native_fn_t fn = (threads_native_fn_t) (uintptr_t) (((uint64_t) fn_hi << 32)
+                                                                | fn_lo);
+    fn((void *) (uintptr_t) (((uint64_t) arg_hi << 32) | arg_lo));
+    abort();
+}
+
+void threads_native_context_init(threads_native_context_t *context, void *stack, size_t size,
+                                 threads_native_fn_t fn, void *arg)
+{
+    uint64_t f = (uint64_t) (uintptr_t) fn, a = (uint64_t) (uintptr_t) arg;
+
+    getcontext(&context->uc);
+    context->uc.uc_stack.ss_sp = stack;
+    context->uc.uc_stack.ss_size = size;
+    context->uc.uc_link = NULL;
+    makecontext(&context->uc, (void (*)(void)) threads_native_context_entry, 4,
+                (unsigned) (f >> 32), (unsigned) f, (unsigned) (a >> 32), (unsigned) a);
+}
+
+#endif
@@ -0,0 +1,8 @@
+#include "threads_native.h"
+#include "threads.h"
+#include "tsd.h"
+
+int tsd_key_create(tsd_key_t *key, tsd_destructor_t destructor)
+{
+    return threads_native_key_create(key, destructor);
+}
@@ -0,0 +1,104 @@
+#if THREADS_MULTI_BACKEND
+/* The timed wait works on the native waiter queues, not on the opaque
+ * multi-backend condition: see the backend's own types, as
+ * threads_native_ops.c does, whose inlined cond_timedwait calls it */
+#define THREADS_BACKEND_IMPL 1
+
+#include "threads_backend.h"
+#include "threads_native.h"
+#include "threads_native_mutex.h"
+#else
+#include "threads_native.h"
+#include "threads.h"
+#endif
+
+#include "timer_wheel.h"
+
+/* A ULT in thread_internal_cond_timedwait, with the timer that
+ * withdraws it from the condition when the deadline passes */
+typedef struct {
+    ult_timer_t tw_timer;
+    thread_internal_cond_t *tw_cond;
+    threads_native_waiter_t tw_waiter;
+    volatile int32_t tw_timedout;
+    /* set by the timer callback as its last access to the waiter */
+    volatile int32_t tw_fired;
+} threads_native_timed_waiter_t;
+
+/* Unlink a waiter still queued on a condition, with c_lock held.
+ * Returns false if a signaler dequeued it first. */
+static bool threads_native_cond_withdraw(thread_internal_cond_t *p_cond,
+                                         threads_native_waiter_t *waiter)
+{
+    threads_native_waiter_t **link, *prev = NULL;
+
+    for (link = &p_cond->c_head; NULL != *link && waiter != *link; link = &(*link)->w_next) {
+        prev = *link;
+    }
+    if (NULL == *link) {
+        return false;
+    }
+    *link = waiter->w_next;
+    if (waiter == p_cond->c_tail) {
+        p_cond->c_tail = prev;
+    }
+    return true;
+}
+
+/* Runs on the timer service thread, which unparks the waiter like a
+ * thread foreign to the scheduler */
+static void threads_native_cond_timer_fire(ult_timer_t *timer)
+{
+    threads_native_timed_waiter_t *tw = (threads_native_timed_waiter_t *) timer;
+    thread_internal_cond_t *p_cond = tw->tw_cond;
+
+    atomic_lock(&p_cond->c_lock);
+    if (threads_native_cond_withdraw(p_cond, &tw->tw_waiter)) {
+        tw->tw_timedout = 1;
+        threads_native_waiter_wake(&tw->tw_waiter);
+    }
+    atomic_unlock(&p_cond->c_lock);
+    atomic_wmb();
+    tw->tw_fired = 1;
+}
+
+int threads_native_cond_timedwait(thread_internal_cond_t *p_cond, thread_internal_mutex_t *p_mutex,
+                                  const struct timespec *abstime)
+{
+    threads_native_timed_waiter_t tw;
+    uint64_t deadline = (uint64_t) abstime->tv_sec * 1000000000 + (uint64_t) abstime->tv_nsec;
+    bool armed;
+
+    tw.tw_cond = p_cond;
+    tw.tw_timedout = 0;
+    tw.tw_fired = 0;
+    threads_native_cond_enqueue(p_cond, &tw.tw_waiter);
+    thread_internal_mutex_unlock(p_mutex);
+
+    armed = ult_timer_now() < deadline
+            && SUCCESS == ult_timer_add(&tw.tw_timer, deadline, threads_native_cond_timer_fire);
+    if (!armed) {
+        /* Past the deadline already, or no timer service: poll the
+         * clock between yields */
+        while (1 == tw.tw_waiter.w_queued && ult_timer_now() < deadline) {
+            threads_native_yield();
+        }
+        atomic_lock(&p_cond->c_lock);
+        if (threads_native_cond_withdraw(p_cond, &tw.tw_waiter)) {
+            tw.tw_waiter.w_queued = 0;
+            tw.tw_timedout = 1;
+        }
+        atomic_unlock(&p_cond->c_lock);
+    }
+    threads_native_waiter_wait(&tw.tw_waiter);
+
+    /* A timer that already fired may still be withdrawing us */
+    if (armed && !ult_timer_cancel(&tw.tw_timer)) {
+        while (0 == tw.tw_fired) {
+            threads_native_yield();
+        }
+        atomic_rmb();
+    }
+    thread_internal_mutex_lock(p_mutex);
+    return tw.tw_timedout;
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <time.h>
+
+#include "threads_native.h"
+
+/*
+ * Mutex: a three-state lock word (0 free, 1 locked, 2 locked and maybe
+ * contended) that takes and releases the lock with a single atomic
+ * when uncontended.  Contended lockers queue on the mutex and park
+ * their ULT, unlocking with waiters hands one of them a wakeup.
+ */
+
+/* A ULT waiting on a mutex or condition variable, on its own stack.
+ * Whoever dequeues it moves w_queued from 1 to 2, unparks the ULT and
+ * clears w_queued, the last time they touch either; the waiter does not
+ * return before then, so its ULT outlives the unpark. */
+typedef struct threads_native_waiter_t {
+  threads_native_ult_t *w_ult;
+  struct threads_native_waiter_t *w_next;
+  volatile int32_t w_queued;
+} threads_native_waiter_t;
+
+typedef struct {
+  atomic_int32_t m_state;
+  /* waiter queue */
+  atomic_lock_t m_lock;
+  threads_native_waiter_t *m_head;
+  threads_native_waiter_t *m_tail;
+  /* recursion depth, -1 for non-recursive mutexes */
+  int32_t m_depth;
+  threads_native_ult_t *m_owner;
+} thread_internal_mutex_t;
+
+#define THREAD_INTERNAL_MUTEX_INITIALIZER                                      \
+  {                                                                            \
+    .m_state = 0, .m_lock = ATOMIC_LOCK_INIT, .m_head = NULL,                  \
+    .m_tail = NULL, .m_depth = -1, .m_owner = NULL,                            \
+  }
+#define THREAD_INTERNAL_RECURSIVE_MUTEX_INITIALIZER                            \
+  {                                                                            \
+    .m_state = 0, .m_lock = ATOMIC_LOCK_INIT, .m_head = NULL,                  \
+    .m_tail = NULL, .m_depth = 0, .m_owner = NULL,                             \
+  }
+
+static inline void threads_native_waiter_append(threads_native_waiter_t **head,
+                                                threads_native_waiter_t **tail,
+                                                threads_native_waiter_t *waiter) {
+  waiter->w_next = NULL;
+  if (NULL == *tail) {
+    *head = waiter;
+  } else {
+    (*tail)->w_next = waiter;
+  }
+  *tail = waiter;
+}
+
+static inline void threads_native_waiter_wake(threads_native_waiter_t *waiter) {
+  atomic_wmb();
+  waiter->w_queued = 2;
+  threads_native_unpark(waiter->w_ult);
+  atomic_wmb();
+  waiter->w_queued = 0;
+}
+
+static inline void threads_native_waiter_wait(threads_native_waiter_t *waiter) {
+  while (1 == waiter->w_queued) {
+    threads_native_park();
+  }
+  /* the waker is between its unpark and its last store */
+  while (0 != waiter->w_queued) {
+    threads_native_yield();
+  }
+  atomic_rmb();
+}
+
+static inline int thread_internal_mutex_init(thread_internal_mutex_t *p_mutex,
+                                             bool recursive) {
+  p_mutex->m_state = 0;
+  atomic_lock_init(&p_mutex->m_lock, 0);
+  p_mutex->m_head = NULL;
+  p_mutex->m_tail = NULL;
+  p_mutex->m_depth = recursive ? 0 : -1;
+  p_mutex->m_owner = NULL;
+  return SUCCESS;
+}
+
+static inline void
+threads_native_mutex_acquired(thread_internal_mutex_t *p_mutex) {
+  if (p_mutex->m_depth >= 0) {
+    p_mutex->m_owner = threads_native_self();
+    p_mutex->m_depth = 1;
+  }
+}
+
+static inline int
+thread_internal_mutex_trylock(thread_internal_mutex_t *p_mutex) {
+  int32_t unlocked = 0;
+  if (p_mutex->m_depth > 0 && threads_native_self() == p_mutex->m_owner) {
+    ++p_mutex->m_depth;
+    return 0;
+  }
+  if (0 != p_mutex->m_state ||
+      !atomic_compare_exchange_strong_32(&p_mutex->m_state, &unlocked, 1)) {
+    return 1;
+  }
+  threads_native_mutex_acquired(p_mutex);
+  return 0;
+}
+
+static inline void
+thread_internal_mutex_lock(thread_internal_mutex_t *p_mutex) {
+  threads_native_waiter_t waiter;
+  if (LIKELY(0 == thread_internal_mutex_trylock(p_mutex))) {
+    return;
+  }
+  waiter.w_ult = threads_native_self();
+  while (0 != atomic_swap_32(&p_mutex->m_state, 2)) {
+    atomic_lock(&p_mutex->m_lock);
+    /* an unlock after this check finds the waiter queued */
+    if (2 != p_mutex->m_state) {
+      atomic_unlock(&p_mutex->m_lock);
+      continue;
+    }
+    waiter.w_queued = 1;
+    threads_native_waiter_append(&p_mutex->m_head, &p_mutex->m_tail, &waiter);
+    atomic_unlock(&p_mutex->m_lock);
+    threads_native_waiter_wait(&waiter);
+  }
+  threads_native_mutex_acquired(p_mutex);
+}
+
+static inline void
+thread_internal_mutex_unlock(thread_internal_mutex_t *p_mutex) {
+  threads_native_waiter_t *waiter;
+  if (p_mutex->m_depth > 0 && 0 != --p_mutex->m_depth) {
+    return;
+  }
+  if (LIKELY(2 != atomic_swap_32(&p_mutex->m_state, 0))) {
+    return;
+  }
+  atomic_lock(&p_mutex->m_lock);
+  waiter = p_mutex->m_head;
+  if (NULL != waiter) {
+    p_mutex->m_head = waiter->w_next;
+    if (NULL == p_mutex->m_head) {
+      p_mutex->m_tail = NULL;
+    }
+    threads_native_waiter_wake(waiter);
+  }
+  atomic_unlock(&p_mutex->m_lock);
+}
+
+static inline void
+thread_internal_mutex_destroy(thread_internal_mutex_t *p_mutex) {
+  /* No specific operation is needed to destroy thread_internal_mutex_t. */
+}
+
+typedef struct {
+  atomic_lock_t c_lock;
+  threads_native_waiter_t *c_head;
+  threads_native_waiter_t *c_tail;
+} thread_internal_cond_t;
+
+#define THREAD_INTERNAL_COND_INITIALIZER                                       \
+  { .c_lock = ATOMIC_LOCK_INIT, .c_head = NULL, .c_tail = NULL, }
+
+static inline int thread_internal_cond_init(thread_internal_cond_t *p_cond) {
+  atomic_lock_init(&p_cond->c_lock, 0);
+  p_cond->c_head = NULL;
+  p_cond->c_tail = NULL;
+  return SUCCESS;
+}
+
+static inline void threads_native_cond_enqueue(thread_internal_cond_t *p_cond,
+                                               threads_native_waiter_t *waiter) {
+  waiter->w_ult = threads_native_self();
+  waiter->w_queued = 1;
+  atomic_lock(&p_cond->c_lock);
+  threads_native_waiter_append(&p_cond->c_head, &p_cond->c_tail, waiter);
+  atomic_unlock(&p_cond->c_lock);
+}
+
+static inline void thread_internal_cond_wait(thread_internal_cond_t *p_cond,
+                                             thread_internal_mutex_t *p_mutex) {
+  threads_native_waiter_t waiter;
+  threads_native_cond_enqueue(p_cond, &waiter);
+  thread_internal_mutex_unlock(p_mutex);
+  threads_native_waiter_wait(&waiter);
+  thread_internal_mutex_lock(p_mutex);
+}
+
+DECLSPEC int threads_native_cond_timedwait(thread_internal_cond_t *p_cond,
+                                           thread_internal_mutex_t *p_mutex,
+                                           const struct timespec *abstime);
+
+/**
+ * Wait until signaled or until abstime on CLOCK_MONOTONIC passes.
+ *
+ * The waiter parks; a timer on the timer wheel withdraws it from the
+ * condition and unparks it at the deadline, see
+ * threads_native_mutex.c.
+ *
+ * @return 0 once signaled, 1 on timeout
+ */
+static inline int
+thread_internal_cond_timedwait(thread_internal_cond_t *p_cond,
+                               thread_internal_mutex_t *p_mutex,
+                               const struct timespec *abstime) {
+  return threads_native_cond_timedwait(p_cond, p_mutex, abstime);
+}
+
+static inline void
+thread_internal_cond_broadcast(thread_internal_cond_t *p_cond) {
+  threads_native_waiter_t *waiter, *next;
+  if (NULL == p_cond->c_head) {
+    return;
+  }
+  atomic_lock(&p_cond->c_lock);
+  for (waiter = p_cond->c_head; NULL != waiter; waiter = next) {
+    next = waiter->w_next;
+    threads_native_waiter_wake(waiter);
+  }
+  p_cond->c_head = NULL;
+  p_cond->c_tail = NULL;
+  atomic_unlock(&p_cond->c_lock);
+}
+
+static inline void thread_internal_cond_signal(thread_internal_cond_t *p_cond) {
+  threads_native_waiter_t *waiter;
+  /* Waiters queue themselves with the user mutex held, so a signaler
+   * holding it sees them without taking the queue lock. */
+  if (NULL == p_cond->c_head) {
+    return;
+  }
+  atomic_lock(&p_cond->c_lock);
+  waiter = p_cond->c_head;
+  if (NULL != waiter) {
+    p_cond->c_head = waiter->w_next;
+    if (NULL == p_cond->c_head) {
+      p_cond->c_tail = NULL;
+    }
+    threads_native_waiter_wake(waiter);
+  }
+  atomic_unlock(&p_cond->c_lock);
+}
+
+static inline void
+thread_internal_cond_destroy(thread_internal_cond_t *p_cond) {
+  /* No destructor is needed. */
+}
@@ -0,0 +1,31 @@
+#if THREADS_MULTI_BACKEND
+
+#define THREADS_BACKEND_IMPL 1
+
+#include "threads_backend.h"
+#include "threads_native.h"
+#include "threads_native_mutex.h"
+#include "threads_native_tsd.h"
+
+static int threads_backend_ops_key_create(tsd_key_t *key, void (*destructor)(void *))
+{
+    return threads_native_key_create(key, destructor);
+}
+
+static void threads_backend_ops_yield(void)
+{
+    threads_native_yield();
+}
+
+#define THREADS_BACKEND_OPS threads_native_backend_ops
+#define THREADS_BACKEND_OPS_NAME "native"
+/* Native ULTs are cooperatively scheduled so yield when idle */
+#define THREADS_BACKEND_OPS_YIELD_WHEN_IDLE true
+/* thread_t runs as a ULT */
+#define THREADS_BACKEND_OPS_THREAD_START threads_native_thread_start
+#define THREADS_BACKEND_OPS_THREAD_JOIN threads_native_thread_join
+#define THREADS_BACKEND_OPS_THREAD_SELF_COMPARE threads_native_thread_self_compare
+
+#include "threads_backend_ops.h"
+
+#endif /* THREADS_MULTI_BACKEND */
@@ -0,0 +1,637 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "threads.h"
+#include "threads_native.h"
+#include "tsd.h"
+
+/* What a ULT asked of its scheduler when it switched out */
+#define THREADS_NATIVE_RUN 0
+#define THREADS_NATIVE_YIELD 1
+#define THREADS_NATIVE_PARK 2
+#define THREADS_NATIVE_EXIT 3
+
+/* Rounds an idle worker looks for work before going to sleep */
+#define THREADS_NATIVE_IDLE_SPINS 64
+/* Stacks each worker keeps for reuse */
+#define THREADS_NATIVE_STACK_CACHE 64
+/* Rounds of destructors run on a ULT's tsd at exit */
+#define THREADS_NATIVE_DESTRUCTOR_ROUNDS 4
+
+typedef struct threads_native_worker_t {
+    /* run queue, under w_lock */
+    atomic_lock_t w_lock;
+    threads_native_ult_t *w_head;
+    threads_native_ult_t *w_tail;
+    /* queued ULTs that are not bound here, for thieves to check */
+    atomic_int32_t w_stealable;
+    int32_t w_index;
+    /* the scheduler loop, and what it last switched to */
+    threads_native_context_t w_context;
+    threads_native_ult_t *w_current;
+    int32_t w_action;
+    /* stacks of joined ULTs, only touched by the worker's own ULTs */
+    threads_native_ult_t *w_free;
+    int32_t w_nfree;
+} __attribute__((aligned(64))) threads_native_worker_t;
+
+volatile bool threads_native_initialized = false;
+static atomic_int32_t threads_native_init_state = 0;
+
+static threads_native_worker_t *threads_native_workers = NULL;
+static int32_t threads_native_nworkers = 0;
+static atomic_int32_t threads_native_next_worker = 0;
+static size_t threads_native_page_size = 4096;
+static size_t threads_native_stack_size = THREADS_NATIVE_STACK_SIZE;
+
+/* The code of the initializing thread, bound to worker 0 */
+static threads_native_ult_t threads_native_main_ult;
+
+/* Idle workers sleep here; enqueues only take the lock when some do */
+static pthread_mutex_t threads_native_idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t threads_native_idle_cond = PTHREAD_COND_INITIALIZER;
+static atomic_int32_t threads_native_sleepers = 0;
+
+static void (*threads_native_key_destructors[THREADS_NATIVE_KEYS])(void *);
+static atomic_int32_t threads_native_key_used[THREADS_NATIVE_KEYS];
+/* Key currently holding each slot, 0 while it is free */
+static volatile uintptr_t threads_native_keys[THREADS_NATIVE_KEYS];
+/* Keys created in each slot so far */
+static uintptr_t threads_native_key_generation[THREADS_NATIVE_KEYS];
+
+/* Records of threads foreign to the scheduler, released at their exit */
+static pthread_key_t threads_native_external_key;
+
+#if HAVE_THREAD_LOCAL
+static thread_local threads_native_worker_t *threads_native_worker = NULL;
+static thread_local threads_native_ult_t *threads_native_external = NULL;
+#else
+static pthread_key_t threads_native_worker_key;
+#endif
+
+/*
+ * Worker of the calling thread, NULL outside the scheduler.
+ *
+ * A ULT may resume on another worker after any switch, but compilers
+ * take the address of a thread local variable to be the same for the
+ * whole function.  Reading it out of line, in a function that can not
+ * be proven pure, makes every caller look it up afresh.
+ */
+static __attribute__((noinline)) threads_native_worker_t *threads_native_worker_get(void)
+{
+    __asm__ __volatile__("");
+#if HAVE_THREAD_LOCAL
+    return threads_native_worker;
+#else
+    return (threads_native_worker_t *) pthread_getspecific(threads_native_worker_key);
+#endif
+}
+
+static void threads_native_worker_set(threads_native_worker_t *w)
+{
+#if HAVE_THREAD_LOCAL
+    threads_native_worker = w;
+#else
+    pthread_setspecific(threads_native_worker_key, w);
+#endif
+}
+
+static void threads_native_tsd_release(threads_native_ult_t *ult)
+{
+    void (*destructor)(void *);
+    threads_native_tsd_t *entry;
+    bool again = true;
+    void *value;
+
+    if (NULL == ult->u_tsd) {
+        return;
+    }
+    for (int round = 0; again && round < THREADS_NATIVE_DESTRUCTOR_ROUNDS; ++round) {
+        again = false;
+        for (int slot = 0; slot < THREADS_NATIVE_KEYS; ++slot) {
+            entry = &ult->u_tsd[slot];
+            value = entry->t_value;
+            destructor = threads_native_key_destructors[slot];
+            /* left behind by a deleted key */
+            if (NULL == value || NULL == destructor || entry->t_key != threads_native_keys[slot]) {
+                continue;
+            }
+            entry->t_value = NULL;
+            destructor(value);
+            again = true;
+        }
+    }
+    free(ult->u_tsd);
+    ult->u_tsd = NULL;
+}
+
+static void threads_native_external_release(void *arg)
+{
+    threads_native_ult_t *ult = (threads_native_ult_t *) arg;
+
+    threads_native_tsd_release(ult);
+    free(ult);
+}
+
+static threads_native_ult_t *threads_native_external_self(void)
+{
+    threads_native_ult_t *ult;
+
+#if HAVE_THREAD_LOCAL
+    ult = threads_native_external;
+#else
+    ult = (threads_native_ult_t *) pthread_getspecific(threads_native_external_key);
+#endif
+    if (LIKELY(NULL != ult)) {
+        return ult;
+    }
+    ult = (threads_native_ult_t *) calloc(1, sizeof(*ult));
+    if (NULL == ult) {
+        abort();
+    }
+    ult->u_bound = -1;
+    ult->u_external = true;
+    pthread_setspecific(threads_native_external_key, ult);
+#if HAVE_THREAD_LOCAL
+    threads_native_external = ult;
+#endif
+    return ult;
+}
+
+/* Map a stack with a guard page below it; the ULT record sits at the
+ * top of the mapping */
+static threads_native_ult_t *threads_native_ult_map(void)
+{
+    size_t size = threads_native_stack_size + threads_native_page_size;
+    threads_native_ult_t *ult;
+    char *stack;
+
+    stack = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1,
+                 0);
+    if (MAP_FAILED == stack) {
+        return NULL;
+    }
+    if (0 != mprotect(stack, threads_native_page_size, PROT_NONE)) {
+        munmap(stack, size);
+        return NULL;
+    }
+    ult = (threads_native_ult_t *) (stack + size
+                                    - ((sizeof(*ult) + 63) & ~(size_t) 63));
+    memset(ult, 0, sizeof(*ult));
+    ult->u_stack = stack;
+    ult->u_stack_size = size;
+    return ult;
+}
+
+static void threads_native_ult_context(threads_native_ult_t *ult, threads_native_fn_t fn,
+                                       void *arg)
+{
+    char *stack = (char *) ult->u_stack + threads_native_page_size;
+
+    threads_native_context_init(&ult->u_context, stack, (size_t) ((char *) ult - stack), fn,
+                                arg);
+}
+
+static void threads_native_ult_free(threads_native_ult_t *ult)
+{
+    threads_native_worker_t *w = threads_native_worker_get();
+
+    if (NULL != w && w->w_nfree < THREADS_NATIVE_STACK_CACHE) {
+        ult->u_next = w->w_free;
+        w->w_free = ult;
+        ++w->w_nfree;
+        return;
+    }
+    munmap(ult->u_stack, ult->u_stack_size);
+}
+
+static bool threads_native_has_work(threads_native_worker_t *w)
+{
+    if (NULL != w->w_head) {
+        return true;
+    }
+    for (int32_t i = 0; i < threads_native_nworkers; ++i) {
+        if (threads_native_workers[i].w_stealable > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void threads_native_enqueue(threads_native_ult_t *ult)
+{
+    threads_native_worker_t *w;
+
+    if (ult->u_bound >= 0) {
+        w = &threads_native_workers[ult->u_bound];
+    } else if (NULL == (w = threads_native_worker_get())) {
+        w = &threads_native_workers[(uint32_t) atomic_fetch_add_32(&threads_native_next_worker, 1)
+                                    % (uint32_t) threads_native_nworkers];
+    }
+
+    ult->u_next = NULL;
+    atomic_lock(&w->w_lock);
+    if (NULL == w->w_tail) {
+        w->w_head = ult;
+    } else {
+        w->w_tail->u_next = ult;
+    }
+    w->w_tail = ult;
+    if (ult->u_bound < 0) {
+        ++w->w_stealable;
+    }
+    atomic_unlock(&w->w_lock);
+
+    /* pairs with the barrier in threads_native_sleep */
+    atomic_mb();
+    if (0 != threads_native_sleepers) {
+        pthread_mutex_lock(&threads_native_idle_lock);
+        /* only the worker it is bound to may take a bound ULT */
+        if (ult->u_bound >= 0) {
+            pthread_cond_broadcast(&threads_native_idle_cond);
+        } else {
+            pthread_cond_signal(&threads_native_idle_cond);
+        }
+        pthread_mutex_unlock(&threads_native_idle_lock);
+    }
+}
+
+static threads_native_ult_t *threads_native_pop(threads_native_worker_t *w)
+{
+    threads_native_ult_t *ult;
+
+    if (NULL == w->w_head) {
+        return NULL;
+    }
+    atomic_lock(&w->w_lock);
+    ult = w->w_head;
+    if (NULL != ult) {
+        w->w_head = ult->u_next;
+        if (NULL == w->w_head) {
+            w->w_tail = NULL;
+        }
+        if (ult->u_bound < 0) {
+            --w->w_stealable;
+        }
+    }
+    atomic_unlock(&w->w_lock);
+    return ult;
+}
+
+static threads_native_ult_t *threads_native_steal(threads_native_worker_t *w)
+{
+    threads_native_ult_t *ult, *prev;
+    threads_native_worker_t *victim;
+
+    for (int32_t i = 1; i < threads_native_nworkers; ++i) {
+        victim = &threads_native_workers[(w->w_index + i) % threads_native_nworkers];
+        if (victim->w_stealable <= 0) {
+            continue;
+        }
+        atomic_lock(&victim->w_lock);
+        for (prev = NULL, ult = victim->w_head; NULL != ult; prev = ult, ult = ult->u_next) {
+            if (ult->u_bound < 0) {
+                break;
+            }
+        }
+        if (NULL != ult) {
+            if (NULL == prev) {
+                victim->w_head = ult->u_next;
+            } else {
+                prev->u_next = ult->u_next;
+            }
+            if (victim->w_tail == ult) {
+                victim->w_tail = prev;
+            }
+            --victim->w_stealable;
+        }
+        atomic_unlock(&victim->w_lock);
+        if (NULL != ult) {
+            return ult;
+        }
+    }
+    return NULL;
+}
+
+static void threads_native_sleep(threads_native_worker_t *w)
+{
+    atomic_fetch_add_32(&threads_native_sleepers, 1);
+    /* an enqueue either sees the sleeper or is seen by it */
+    atomic_mb();
+    pthread_mutex_lock(&threads_native_idle_lock);
+    if (!threads_native_has_work(w)) {
+        pthread_cond_wait(&threads_native_idle_cond, &threads_native_idle_lock);
+    }
+    pthread_mutex_unlock(&threads_native_idle_lock);
+    atomic_fetch_add_32(&threads_native_sleepers, -1);
+}
+
+static threads_native_ult_t *threads_native_next(threads_native_worker_t *w)
+{
+    threads_native_ult_t *ult;
+
+    for (int spins = 0;; ++spins) {
+        if (NULL != (ult = threads_native_pop(w)) || NULL != (ult = threads_native_steal(w))) {
+            return ult;
+        }
+        if (spins < THREADS_NATIVE_IDLE_SPINS) {
+            sched_yield();
+            continue;
+        }
+        threads_native_sleep(w);
+        spins = 0;
+    }
+}
+
+/* Carry out what the ULT that just switched out asked for, now that its
+ * registers are saved and it can run anywhere */
+static void threads_native_post(threads_native_worker_t *w, threads_native_ult_t *ult)
+{
+    intptr_t joiner;
+
+    switch (w->w_action) {
+    case THREADS_NATIVE_YIELD:
+        threads_native_enqueue(ult);
+        break;
+    case THREADS_NATIVE_PARK:
+        /* an unpark that came in since the ULT checked its permit */
+        if (atomic_fetch_add_32(&ult->u_permit, -1) > 0) {
+            threads_native_enqueue(ult);
+        }
+        break;
+    case THREADS_NATIVE_EXIT:
+        joiner = atomic_swap_ptr(&ult->u_join, THREADS_NATIVE_EXITING);
+        if (0 != joiner) {
+            threads_native_unpark((threads_native_ult_t *) joiner);
+        }
+        /* the joiner may drop ult, and return, from here on */
+        atomic_wmb();
+        ult->u_join = THREADS_NATIVE_JOINED;
+        break;
+    }
+}
+
+static void threads_native_schedule(void *arg)
+{
+    threads_native_worker_t *w = (threads_native_worker_t *) arg;
+    threads_native_ult_t *ult;
+
+    for (;;) {
+        if (NULL != w->w_current) {
+            threads_native_post(w, w->w_current);
+        }
+        ult = threads_native_next(w);
+        w->w_current = ult;
+        w->w_action = THREADS_NATIVE_RUN;
+        threads_native_context_switch(&w->w_context, &ult->u_context);
+    }
+}
+
+static void *threads_native_worker_main(void *arg)
+{
+    threads_native_worker_set((threads_native_worker_t *) arg);
+    threads_native_schedule(arg);
+    return NULL;
+}
+
+static inline void threads_native_switch_out(threads_native_worker_t *w, int32_t action)
+{
+    w->w_action = action;
+    threads_native_context_switch(&w->w_current->u_context, &w->w_context);
+}
+
+static void threads_native_ult_main(void *arg)
+{
+    threads_native_ult_t *ult = (threads_native_ult_t *) arg;
+
+    ult->u_result = ult->u_fn(ult->u_arg);
+    threads_native_tsd_release(ult);
+    threads_native_switch_out(threads_native_worker_get(), THREADS_NATIVE_EXIT);
+    abort();
+}
+
+static size_t threads_native_env_size(const char *name, size_t value)
+{
+    const char *env = getenv(name);
+    long parsed;
+
+    if (NULL != env && (parsed = atol(env)) > 0) {
+        return (size_t) parsed;
+    }
+    return value;
+}
+
+static void threads_native_setup(void)
+{
+    threads_native_worker_t *w0;
+    threads_native_ult_t *stack;
+    pthread_attr_t attr;
+    pthread_t handle;
+    long cpus;
+
+    threads_native_page_size = (size_t) sysconf(_SC_PAGESIZE);
+    threads_native_stack_size = threads_native_env_size("LIBULT_NATIVE_STACK_SIZE",
+                                                        THREADS_NATIVE_STACK_SIZE);
+    threads_native_stack_size = (threads_native_stack_size + threads_native_page_size - 1)
+                                & ~(threads_native_page_size - 1);
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads_native_nworkers = (int32_t) threads_native_env_size("LIBULT_NATIVE_WORKERS",
+                                                                cpus > 0 ? (size_t) cpus : 1);
+
+    pthread_key_create(&threads_native_external_key, threads_native_external_release);
+#if !HAVE_THREAD_LOCAL
+    pthread_key_create(&threads_native_worker_key, NULL);
+#endif
+    if (0 != posix_memalign((void **) &threads_native_workers, 64,
+                            threads_native_nworkers * sizeof(threads_native_worker_t))) {
+        abort();
+    }
+    memset(threads_native_workers, 0, threads_native_nworkers * sizeof(threads_native_worker_t));
+    for (int32_t i = 0; i < threads_native_nworkers; ++i) {
+        atomic_lock_init(&threads_native_workers[i].w_lock, 0);
+        threads_native_workers[i].w_index = i;
+    }
+
+    /* The calling thread carries on as a ULT of worker 0, whose
+     * scheduler runs on a stack of its own */
+    w0 = &threads_native_workers[0];
+    threads_native_main_ult.u_bound = 0;
+    w0->w_current = &threads_native_main_ult;
+    if (NULL == (stack = threads_native_ult_map())) {
+        abort();
+    }
+    threads_native_ult_context(stack, threads_native_schedule, w0);
+    w0->w_context = stack->u_context;
+    threads_native_worker_set(w0);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int32_t i = 1; i < threads_native_nworkers; ++i) {
+        if (0 != pthread_create(&handle, &attr, threads_native_worker_main,
+                                &threads_native_workers[i])) {
+            abort();
+        }
+    }
+    pthread_attr_destroy(&attr);
+}
+
+void threads_native_init(void)
+{
+    int32_t unset = 0;
+
+    if (atomic_compare_exchange_strong_32(&threads_native_init_state, &unset, 1)) {
+        threads_native_setup();
+        atomic_wmb();
+        threads_native_initialized = true;
+        return;
+    }
+    while (!threads_native_initialized) {
+        sched_yield();
+    }
+    atomic_rmb();
+}
+
+threads_native_ult_t *threads_native_self(void)
+{
+    threads_native_worker_t *w;
+
+    threads_ensure_init_native();
+    w = threads_native_worker_get();
+    return NULL != w ? w->w_current : threads_native_external_self();
+}
+
+void threads_native_yield(void)
+{
+    threads_native_worker_t *w = threads_native_worker_get();
+
+    if (NULL == w) {
+        sched_yield();
+        return;
+    }
+    /* nothing else would run */
+    if (NULL == w->w_head) {
+        return;
+    }
+    threads_native_switch_out(w, THREADS_NATIVE_YIELD);
+}
+
+void threads_native_park(void)
+{
+    threads_native_worker_t *w;
+    threads_native_ult_t *self;
+    int32_t permit;
+
+    threads_ensure_init_native();
+    if (NULL == (w = threads_native_worker_get())) {
+        /* no scheduler to switch to, poll for an unpark */
+        self = threads_native_external_self();
+        for (;;) {
+            permit = self->u_permit;
+            if (permit > 0 && atomic_compare_exchange_strong_32(&self->u_permit, &permit,
+                                                                permit - 1)) {
+                return;
+            }
+            sched_yield();
+        }
+    }
+    self = w->w_current;
+    permit = self->u_permit;
+    if (permit > 0 && atomic_compare_exchange_strong_32(&self->u_permit, &permit, permit - 1)) {
+        return;
+    }
+    threads_native_switch_out(w, THREADS_NATIVE_PARK);
+}
+
+void threads_native_unpark(threads_native_ult_t *ult)
+{
+    /* -1: parked, and the scheduler is done with it */
+    if (-1 == atomic_fetch_add_32(&ult->u_permit, 1)) {
+        threads_native_enqueue(ult);
+    }
+}
+
+int threads_native_spawn(void *(*fn)(void *), void *arg, threads_native_ult_t **ult)
+{
+    threads_native_worker_t *w;
+    threads_native_ult_t *u;
+    void *stack;
+    size_t size;
+
+    threads_ensure_init_native();
+    w = threads_native_worker_get();
+    if (NULL != w && NULL != w->w_free) {
+        u = w->w_free;
+        w->w_free = u->u_next;
+        --w->w_nfree;
+        stack = u->u_stack;
+        size = u->u_stack_size;
+        memset(u, 0, sizeof(*u));
+        u->u_stack = stack;
+        u->u_stack_size = size;
+    } else if (NULL == (u = threads_native_ult_map())) {
+        return ERR_OUT_OF_RESOURCE;
+    }
+    u->u_bound = -1;
+    u->u_fn = fn;
+    u->u_arg = arg;
+    threads_native_ult_context(u, threads_native_ult_main, u);
+    *ult = u;
+    threads_native_enqueue(u);
+    return SUCCESS;
+}
+
+int threads_native_join(threads_native_ult_t *ult, void **result)
+{
+    intptr_t self = (intptr_t) threads_native_self(), unjoined = 0;
+
+    if (atomic_compare_exchange_strong_ptr(&ult->u_join, &unjoined, self)) {
+        while (self == ult->u_join) {
+            threads_native_park();
+        }
+    }
+    /* the scheduler is between its unpark and its last store */
+    while (THREADS_NATIVE_JOINED != ult->u_join) {
+        threads_native_yield();
+    }
+    atomic_rmb();
+    if (NULL != result) {
+        *result = ult->u_result;
+    }
+    threads_native_ult_free(ult);
+    return SUCCESS;
+}
+
+int threads_native_key_create(uintptr_t *key, void (*destructor)(void *))
+{
+    int32_t unused;
+
+    for (int k = 0; k < THREADS_NATIVE_KEYS; ++k) {
+        unused = 0;
+        if (0 == threads_native_key_used[k]
+            && atomic_compare_exchange_strong_32(&threads_native_key_used[k], &unused, 1)) {
+            threads_native_key_destructors[k] = destructor;
+            *key = (uintptr_t) k + ++threads_native_key_generation[k] * THREADS_NATIVE_KEYS;
+            threads_native_keys[k] = *key;
+            return SUCCESS;
+        }
+    }
+    return ERR_OUT_OF_RESOURCE;
+}
+
+int threads_native_key_delete(uintptr_t key)
+{
+    uintptr_t slot = THREADS_NATIVE_KEY_SLOT(key);
+
+    if (key < THREADS_NATIVE_KEYS || key != threads_native_keys[slot]) {
+        return ERR_BAD_PARAM;
+    }
+    threads_native_keys[slot] = 0;
+    threads_native_key_destructors[slot] = NULL;
+    atomic_wmb();
+    threads_native_key_used[slot] = 0;
+    return SUCCESS;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "threads_native.h"
+
+/* Native ULTs are cooperatively scheduled so yield when idle */
+#define THREAD_YIELD_WHEN_IDLE_DEFAULT true
+
+static inline void thread_yield(void) { threads_native_yield(); }
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdlib.h>
+
+#include "threads_native.h"
+
+/* Values live in a table of each ULT, allocated on its first tsd_set */
+typedef uintptr_t tsd_key_t;
+
+static inline int tsd_key_delete(tsd_key_t key) {
+  return threads_native_key_delete(key);
+}
+
+static inline int tsd_set(tsd_key_t key, void *value) {
+  threads_native_ult_t *self;
+  threads_native_tsd_t *entry;
+
+  if (UNLIKELY(key < THREADS_NATIVE_KEYS)) {
+    return ERR_BAD_PARAM;
+  }
+  self = threads_native_self();
+  if (UNLIKELY(NULL == self->u_tsd)) {
+    self->u_tsd = (threads_native_tsd_t *)calloc(THREADS_NATIVE_KEYS,
+                                                 sizeof(threads_native_tsd_t));
+    if (NULL == self->u_tsd) {
+      return ERR_OUT_OF_RESOURCE;
+    }
+  }
+  entry = &self->u_tsd[THREADS_NATIVE_KEY_SLOT(key)];
+  entry->t_key = key;
+  entry->t_value = value;
+  return SUCCESS;
+}
+
+/* A value left in the slot by a deleted key reads as NULL */
+static inline int tsd_get(tsd_key_t key, void **valuep) {
+  threads_native_ult_t *self;
+  threads_native_tsd_t *entry;
+
+  *valuep = NULL;
+  if (UNLIKELY(key < THREADS_NATIVE_KEYS)) {
+    return ERR_BAD_PARAM;
+  }
+  self = threads_native_self();
+  if (NULL != self->u_tsd) {
+    entry = &self->u_tsd[THREADS_NATIVE_KEY_SLOT(key)];
+    if (key == entry->t_key) {
+      *valuep = entry->t_value;
+    }
+  }
+  return SUCCESS;
+}
@@ -4,3 +4,17 @@
 
 typedef void(threads_pthreads_yield_fn_t)(void);
 extern threads_pthreads_yield_fn_t *threads_pthreads_yield_fn;
+
+/* Opt-in pool of persistent workers behind thread_start/thread_join,
+ * see threads_pthreads_pool.c */
+#define THREADS_PTHREADS_POOL 1
+
+struct thread_t;
+int threads_pthreads_pool_init(const mca_base_component_t *component);
+int threads_pthreads_pool_start(struct thread_t *t);
+int threads_pthreads_pool_join(struct thread_t *t, void **thr_return);
+void threads_pthreads_pool_fini(void);
+
+/* thread_start/thread_join through the pool, see create_join.c */
+int threads_pthreads_thread_start(struct thread_t *t);
+int threads_pthreads_thread_join(struct thread_t *t, void **thr_return);
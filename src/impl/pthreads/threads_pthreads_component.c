@@ -2,14 +2,30 @@
 #include "threads.h"
 
 static int threads_pthreads_open(void);
+static int threads_pthreads_close(void);
 static int threads_pthreads_register(void);
 
 int threads_pthreads_register(void)
 {
-    return threads_pthreads_yield_init(&mca_threads_pthreads_component.threadsc_version);
+    int rc = threads_pthreads_yield_init(&mca_threads_pthreads_component.threadsc_version);
+    if (SUCCESS == rc) {
+        rc = threads_pthreads_pool_init(&mca_threads_pthreads_component.threadsc_version);
+    }
+#if THREADS_PTHREADS_USE_FUTEX
+    if (SUCCESS == rc) {
+        rc = threads_pthreads_futex_init(&mca_threads_pthreads_component.threadsc_version);
+    }
+#endif
+    return rc;
 }
 
 int threads_pthreads_open(void)
 {
     return SUCCESS;
 }
+
+int threads_pthreads_close(void)
+{
+    threads_pthreads_pool_fini();
+    return SUCCESS;
+}
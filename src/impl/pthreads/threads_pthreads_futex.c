@@ -0,0 +1,72 @@
+#if THREADS_MULTI_BACKEND
+/* The slow paths work on the futex lock word, not on the opaque
+ * multi-backend mutex: see the backend's own types, as
+ * threads_pthreads_ops.c does, whose inlined fast paths call them */
+#define THREADS_BACKEND_IMPL 1
+
+#include "threads_backend.h"
+#include "threads_pthreads.h"
+#include "threads_pthreads_mutex.h"
+#else
+#include "threads_pthreads.h"
+#include "threads.h"
+#endif
+
+#if THREADS_PTHREADS_USE_FUTEX
+
+/* Number of polls of a held lock before parking in the kernel */
+static int futex_spin_count = 100;
+
+static inline void threads_pthreads_futex_pause(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    atomic_mb();
+#endif
+}
+
+int threads_pthreads_futex_init(const mca_base_component_t *component)
+{
+    (void) mca_base_component_var_register(
+        component, "futex_spin_count",
+        "Number of times a contended futex mutex is polled before the thread parks",
+        MCA_BASE_VAR_TYPE_INT, NULL, 0, 0, INFO_LVL_3, MCA_BASE_VAR_SCOPE_LOCAL,
+        &futex_spin_count);
+    return SUCCESS;
+}
+
+void threads_pthreads_futex_lock_contended(thread_internal_mutex_t *p_mutex)
+{
+    /* Mark the lock as contended so that the owner wakes us on unlock */
+    while (0 != atomic_swap_32(&p_mutex->m_state, 2)) {
+        threads_pthreads_futex_wait(&p_mutex->m_state, 2);
+    }
+}
+
+void threads_pthreads_futex_lock_slow(thread_internal_mutex_t *p_mutex)
+{
+    int32_t state;
+
+    /* Short critical sections dominate, so poll for a while before paying
+     * for a park/unpark round trip.  Stop early once others sleep on the
+     * lock: it is held for long enough that spinning is wasted. */
+    for (int i = 0; i < futex_spin_count; ++i) {
+        state = p_mutex->m_state;
+        if (2 == state) {
+            break;
+        }
+        if (0 == state) {
+            if (atomic_compare_exchange_strong_acq_32(&p_mutex->m_state, &state, 1)) {
+                return;
+            }
+        }
+        threads_pthreads_futex_pause();
+    }
+
+    threads_pthreads_futex_lock_contended(p_mutex);
+}
+
+#endif /* THREADS_PTHREADS_USE_FUTEX */
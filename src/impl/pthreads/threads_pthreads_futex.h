@@ -0,0 +1,266 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * Linux futex implementation of thread_internal_mutex_t and
+ * thread_internal_cond_t for the pthreads backend.
+ *
+ * The mutex is a single 32-bit lock word (0: unlocked, 1: locked,
+ * 2: locked with possible sleepers) following Drepper's "Futexes Are
+ * Tricky".  Acquiring and releasing an uncontended lock is one inlined
+ * atomic operation; the spin-then-park slow path lives out of line in
+ * threads_pthreads_futex.c.  Recursive mutexes additionally track the
+ * owner and the recursion depth next to the lock word.
+ *
+ * The condition variable is a sequence counter.  Waiters sleep on the
+ * counter, signalers bump it and wake one sleeper, and broadcast wakes a
+ * single sleeper while requeueing the others directly onto the mutex so
+ * they do not stampede on it.  Signalers only enter the kernel when a
+ * waiter is registered.
+ *
+ * Selected at configure time with LIBULT_PTHREADS_USE_FUTEX.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  /* 0: unlocked, 1: locked, 2: locked and contended */
+  atomic_int32_t m_state;
+  /* -1 for non-recursive mutexes, extra acquisitions otherwise */
+  int32_t m_depth;
+  /* owner of a recursive mutex, unused otherwise */
+  pthread_t m_owner;
+} thread_internal_mutex_t;
+
+#define THREAD_INTERNAL_MUTEX_INITIALIZER                                      \
+  { .m_state = 0, .m_depth = -1, .m_owner = 0 }
+#define THREAD_INTERNAL_RECURSIVE_MUTEX_INITIALIZER                            \
+  { .m_state = 0, .m_depth = 0, .m_owner = 0 }
+
+typedef struct {
+  atomic_int32_t c_seq;
+  atomic_int32_t c_waiters;
+  /* mutex the waiters sleep with, target of the broadcast requeue */
+  thread_internal_mutex_t *c_mutex;
+} thread_internal_cond_t;
+
+#define THREAD_INTERNAL_COND_INITIALIZER                                       \
+  { .c_seq = 0, .c_waiters = 0, .c_mutex = NULL }
+
+/* Out-of-line slow paths, see threads_pthreads_futex.c */
+DECLSPEC void
+threads_pthreads_futex_lock_slow(thread_internal_mutex_t *p_mutex);
+DECLSPEC void
+threads_pthreads_futex_lock_contended(thread_internal_mutex_t *p_mutex);
+DECLSPEC int threads_pthreads_futex_init(const mca_base_component_t *component);
+
+static inline long threads_pthreads_futex(atomic_int32_t *uaddr, int op,
+                                          int32_t val, unsigned long val2,
+                                          atomic_int32_t *uaddr2,
+                                          int32_t val3) {
+  return syscall(SYS_futex, uaddr, op, val, val2, uaddr2, val3);
+}
+
+static inline void threads_pthreads_futex_wait(atomic_int32_t *uaddr,
+                                               int32_t val) {
+  threads_pthreads_futex(uaddr, FUTEX_WAIT_PRIVATE, val, 0, NULL, 0);
+}
+
+static inline void threads_pthreads_futex_wake(atomic_int32_t *uaddr,
+                                               int32_t nwake) {
+  threads_pthreads_futex(uaddr, FUTEX_WAKE_PRIVATE, nwake, 0, NULL, 0);
+}
+
+static inline int thread_internal_mutex_init(thread_internal_mutex_t *p_mutex,
+                                             bool recursive) {
+  p_mutex->m_state = 0;
+  p_mutex->m_depth = recursive ? 0 : -1;
+  p_mutex->m_owner = 0;
+  return SUCCESS;
+}
+
+static inline bool
+threads_pthreads_futex_owned(thread_internal_mutex_t *p_mutex) {
+  return 0 != p_mutex->m_state &&
+         pthread_equal(p_mutex->m_owner, pthread_self());
+}
+
+static inline void
+thread_internal_mutex_lock(thread_internal_mutex_t *p_mutex) {
+  int32_t unlocked = 0;
+
+  if (UNLIKELY(p_mutex->m_depth >= 0)) {
+    if (threads_pthreads_futex_owned(p_mutex)) {
+      ++p_mutex->m_depth;
+      return;
+    }
+    if (!atomic_compare_exchange_strong_acq_32(&p_mutex->m_state, &unlocked,
+                                               1)) {
+      threads_pthreads_futex_lock_slow(p_mutex);
+    }
+    p_mutex->m_owner = pthread_self();
+    return;
+  }
+
+  if (LIKELY(atomic_compare_exchange_strong_acq_32(&p_mutex->m_state,
+                                                   &unlocked, 1))) {
+    return;
+  }
+  threads_pthreads_futex_lock_slow(p_mutex);
+}
+
+static inline int
+thread_internal_mutex_trylock(thread_internal_mutex_t *p_mutex) {
+  int32_t unlocked = 0;
+
+  if (UNLIKELY(p_mutex->m_depth >= 0)) {
+    if (threads_pthreads_futex_owned(p_mutex)) {
+      ++p_mutex->m_depth;
+      return 0;
+    }
+    if (!atomic_compare_exchange_strong_acq_32(&p_mutex->m_state, &unlocked,
+                                               1)) {
+      return 1;
+    }
+    p_mutex->m_owner = pthread_self();
+    return 0;
+  }
+
+  return atomic_compare_exchange_strong_acq_32(&p_mutex->m_state, &unlocked, 1)
+             ? 0
+             : 1;
+}
+
+static inline void
+thread_internal_mutex_unlock(thread_internal_mutex_t *p_mutex) {
+  if (UNLIKELY(p_mutex->m_depth >= 0)) {
+#if ENABLE_DEBUG
+    assert(threads_pthreads_futex_owned(p_mutex));
+#endif
+    if (p_mutex->m_depth > 0) {
+      --p_mutex->m_depth;
+      return;
+    }
+    p_mutex->m_owner = 0;
+  }
+
+#if ENABLE_DEBUG
+  assert(0 != p_mutex->m_state);
+#endif
+  if (UNLIKELY(2 == atomic_swap_32(&p_mutex->m_state, 0))) {
+    threads_pthreads_futex_wake(&p_mutex->m_state, 1);
+  }
+}
+
+static inline void
+thread_internal_mutex_destroy(thread_internal_mutex_t *p_mutex) {
+#if ENABLE_DEBUG
+  assert(0 == p_mutex->m_state);
+#endif
+}
+
+static inline int thread_internal_cond_init(thread_internal_cond_t *p_cond) {
+  p_cond->c_seq = 0;
+  p_cond->c_waiters = 0;
+  p_cond->c_mutex = NULL;
+  return SUCCESS;
+}
+
+static inline void thread_internal_cond_wait(thread_internal_cond_t *p_cond,
+                                             thread_internal_mutex_t *p_mutex) {
+  int32_t depth = p_mutex->m_depth;
+  int32_t seq;
+
+  atomic_add_fetch_32(&p_cond->c_waiters, 1);
+  seq = p_cond->c_seq;
+  p_cond->c_mutex = p_mutex;
+
+  /* A recursive mutex is released completely while waiting */
+  if (depth > 0) {
+    p_mutex->m_depth = 0;
+  }
+  thread_internal_mutex_unlock(p_mutex);
+
+  /* Returns right away if the sequence moved since we sampled it */
+  threads_pthreads_futex_wait(&p_cond->c_seq, seq);
+
+  /* We may have been requeued onto the mutex by a broadcast, so
+   * reacquire it as a contended lock to keep the wakeup chain going. */
+  threads_pthreads_futex_lock_contended(p_mutex);
+  if (depth >= 0) {
+    p_mutex->m_owner = pthread_self();
+    p_mutex->m_depth = depth;
+  }
+  atomic_add_fetch_32(&p_cond->c_waiters, -1);
+}
+
+/**
+ * Wait until signaled or until abstime on CLOCK_MONOTONIC passes.
+ *
+ * @return 0 once signaled (or spuriously woken), 1 on timeout
+ */
+static inline int
+thread_internal_cond_timedwait(thread_internal_cond_t *p_cond,
+                               thread_internal_mutex_t *p_mutex,
+                               const struct timespec *abstime) {
+  int32_t depth = p_mutex->m_depth;
+  int32_t seq;
+  long ret;
+
+  atomic_add_fetch_32(&p_cond->c_waiters, 1);
+  seq = p_cond->c_seq;
+  p_cond->c_mutex = p_mutex;
+
+  if (depth > 0) {
+    p_mutex->m_depth = 0;
+  }
+  thread_internal_mutex_unlock(p_mutex);
+
+  /* FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline */
+  ret = threads_pthreads_futex(&p_cond->c_seq, FUTEX_WAIT_BITSET_PRIVATE, seq,
+                               (unsigned long)abstime, NULL,
+                               FUTEX_BITSET_MATCH_ANY);
+
+  threads_pthreads_futex_lock_contended(p_mutex);
+  if (depth >= 0) {
+    p_mutex->m_owner = pthread_self();
+    p_mutex->m_depth = depth;
+  }
+  atomic_add_fetch_32(&p_cond->c_waiters, -1);
+  return (0 > ret && ETIMEDOUT == errno) ? 1 : 0;
+}
+
+static inline void
+thread_internal_cond_broadcast(thread_internal_cond_t *p_cond) {
+  thread_internal_mutex_t *p_mutex = p_cond->c_mutex;
+  int32_t seq = atomic_add_fetch_32(&p_cond->c_seq, 1);
+
+  if (0 == p_cond->c_waiters) {
+    return;
+  }
+  if (NULL == p_mutex ||
+      0 > threads_pthreads_futex(&p_cond->c_seq, FUTEX_CMP_REQUEUE_PRIVATE, 1,
+                                 INT_MAX, &p_mutex->m_state, seq)) {
+    threads_pthreads_futex_wake(&p_cond->c_seq, INT_MAX);
+  }
+}
+
+static inline void thread_internal_cond_signal(thread_internal_cond_t *p_cond) {
+  atomic_add_fetch_32(&p_cond->c_seq, 1);
+  if (0 != p_cond->c_waiters) {
+    threads_pthreads_futex_wake(&p_cond->c_seq, 1);
+  }
+}
+
+static inline void
+thread_internal_cond_destroy(thread_internal_cond_t *p_cond) {
+  /* No destructor is needed. */
+}
@@ -8,5 +8,12 @@ int tsd_key_create(tsd_key_t *key, tsd_destructor_t destructor)
 {
     int rc;
     rc = pthread_key_create(key, destructor);
-    return 0 == rc ? SUCCESS : ERR_IN_ERRNO;
+    if (0 != rc) {
+        return ERR_IN_ERRNO;
+    }
+    rc = threads_pthreads_pool_key_add(*key, destructor);
+    if (SUCCESS != rc) {
+        pthread_key_delete(*key);
+    }
+    return rc;
 }
@@ -5,6 +5,13 @@
 #include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <time.h>
+
+#if THREADS_PTHREADS_USE_FUTEX
+
+#include "threads_pthreads_futex.h"
+
+#else
 
 typedef pthread_mutex_t thread_internal_mutex_t;
 
@@ -118,6 +125,53 @@ static inline void thread_internal_cond_wait(thread_internal_cond_t *p_cond,
 #endif
 }
 
+/**
+ * Wait until signaled or until abstime on CLOCK_MONOTONIC passes.
+ *
+ * @return 0 once signaled (or spuriously woken), 1 on timeout
+ */
+static inline int
+thread_internal_cond_timedwait(thread_internal_cond_t *p_cond,
+                               thread_internal_mutex_t *p_mutex,
+                               const struct timespec *abstime) {
+  int ret;
+#if defined(__USE_GNU) && defined(__GLIBC__) &&                                \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+  ret = pthread_cond_clockwait(p_cond, p_mutex, CLOCK_MONOTONIC, abstime);
+#else
+  /* Only wall clock deadlines: convert the time left on the monotonic
+   * clock, again after each timeout in case the wall clock was stepped
+   * forward meanwhile. */
+  struct timespec now, deadline;
+  for (;;) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > abstime->tv_sec ||
+        (now.tv_sec == abstime->tv_sec && now.tv_nsec >= abstime->tv_nsec)) {
+      ret = ETIMEDOUT;
+      break;
+    }
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += abstime->tv_sec - now.tv_sec;
+    deadline.tv_nsec += abstime->tv_nsec - now.tv_nsec;
+    if (deadline.tv_nsec < 0) {
+      deadline.tv_sec--;
+      deadline.tv_nsec += 1000000000;
+    } else if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    ret = pthread_cond_timedwait(p_cond, p_mutex, &deadline);
+    if (ETIMEDOUT != ret) {
+      break;
+    }
+  }
+#endif
+#if ENABLE_DEBUG
+  assert(0 == ret || ETIMEDOUT == ret);
+#endif
+  return ETIMEDOUT == ret ? 1 : 0;
+}
+
 static inline void
 thread_internal_cond_broadcast(thread_internal_cond_t *p_cond) {
 #if ENABLE_DEBUG
@@ -146,3 +200,5 @@ thread_internal_cond_destroy(thread_internal_cond_t *p_cond) {
   pthread_cond_destroy(p_cond);
 #endif
 }
+
+#endif /* THREADS_PTHREADS_USE_FUTEX */
@@ -0,0 +1,38 @@
+#if THREADS_MULTI_BACKEND
+
+#define THREADS_BACKEND_IMPL 1
+
+#include "threads_backend.h"
+#include "threads_pthreads.h"
+#include "threads_pthreads_mutex.h"
+#include "threads_pthreads_tsd.h"
+
+static int threads_backend_ops_key_create(tsd_key_t *key, void (*destructor)(void *))
+{
+    int rc = pthread_key_create(key, destructor);
+    if (0 != rc) {
+        return ERR_IN_ERRNO;
+    }
+    rc = threads_pthreads_pool_key_add(*key, destructor);
+    if (SUCCESS != rc) {
+        pthread_key_delete(*key);
+    }
+    return rc;
+}
+
+static void threads_backend_ops_yield(void)
+{
+    threads_pthreads_yield_fn();
+}
+
+#define THREADS_BACKEND_OPS threads_pthreads_backend_ops
+#define THREADS_BACKEND_OPS_NAME "pthreads"
+/* Pthreads do not need to yield when idle */
+#define THREADS_BACKEND_OPS_YIELD_WHEN_IDLE false
+/* thread_t may run on a pooled worker */
+#define THREADS_BACKEND_OPS_THREAD_START threads_pthreads_thread_start
+#define THREADS_BACKEND_OPS_THREAD_JOIN threads_pthreads_thread_join
+
+#include "threads_backend_ops.h"
+
+#endif /* THREADS_MULTI_BACKEND */
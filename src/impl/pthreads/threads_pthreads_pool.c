@@ -0,0 +1,485 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "threads_pthreads.h"
+#include "threads.h"
+#include "tsd.h"
+
+/*
+ * Pool of persistent workers behind thread_start/thread_join.
+ *
+ * thread_start hands t_run to a parked worker instead of creating a
+ * kernel thread, and thread_join waits on the worker's completion slot.
+ * Workers are created on demand up to pool_max, and workers idle for
+ * longer than pool_idle_timeout exit as long as more than pool_min
+ * remain.  With pool_max at 0 (the default) pooling is disabled and
+ * every thread_t gets its own kernel thread as before.
+ *
+ * A worker runs the destructors of the keys created with
+ * tsd_key_create after each thread_t, as pthread_exit would, so that
+ * tsd values (tracked keys included) do not carry over from one
+ * thread_t to the next.  __thread variables do carry over.
+ *
+ * t_run should return rather than call pthread_exit: a t_run that exits
+ * or is cancelled takes its worker down with it, and thread_join then
+ * reports NULL since the value passed to pthread_exit is not
+ * recoverable.
+ *
+ * threads_pthreads_pool_fini retires every worker once the thread_t
+ * started through the pool have been joined; thread_start creates
+ * dedicated threads from then on.
+ */
+
+typedef struct threads_pthreads_worker_t {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t handle;
+    /* work assigned by thread_start, NULL while idle */
+    thread_t *thread;
+    /* set once thread has returned, cleared by thread_join */
+    bool done;
+    void *ret;
+    /* t_run ended in pthread_exit or cancellation and took the worker
+     * down, thread_join frees it */
+    bool exited;
+    /* set by threads_pthreads_pool_fini for an idle worker to exit */
+    bool quit;
+    /* idle list, protected by the pool lock */
+    bool idle;
+    struct threads_pthreads_worker_t *next_idle;
+} threads_pthreads_worker_t;
+
+static int pool_max = 0;
+static int pool_min = 0;
+static int pool_idle_timeout = 1000; /* milliseconds */
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+/* signaled as workers exit, for threads_pthreads_pool_fini */
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static threads_pthreads_worker_t *pool_idle_head = NULL;
+static int pool_num_workers = 0;
+static bool pool_shutdown = false;
+
+/*
+ * Keys created with tsd_key_create.  Workers read the table without a
+ * lock after each thread_t, so it is only ever appended to under
+ * pool_keys_lock: an entry is immutable once published, a removed key
+ * leaves a NULL slot for the next one, and a table that grows is copied
+ * into a new one.  Removed entries and outgrown tables are kept until
+ * threads_pthreads_pool_fini, when no worker can still be reading them.
+ */
+typedef struct threads_pthreads_pool_key_t {
+    pthread_key_t key;
+    tsd_destructor_t destructor;
+    struct threads_pthreads_pool_key_t *next_retired;
+} threads_pthreads_pool_key_t;
+
+typedef struct threads_pthreads_pool_keys_t {
+    int size;
+    struct threads_pthreads_pool_keys_t *next_retired;
+    threads_pthreads_pool_key_t *volatile slots[];
+} threads_pthreads_pool_keys_t;
+
+static pthread_mutex_t pool_keys_lock = PTHREAD_MUTEX_INITIALIZER;
+static threads_pthreads_pool_keys_t *volatile pool_keys = NULL;
+/* slots in use, published after the slots themselves */
+static volatile int pool_num_keys = 0;
+static threads_pthreads_pool_key_t *pool_keys_retired = NULL;
+static threads_pthreads_pool_keys_t *pool_tables_retired = NULL;
+
+int threads_pthreads_pool_init(const mca_base_component_t *component)
+{
+    (void) mca_base_component_var_register(
+        component, "thread_pool_max",
+        "Maximum number of pooled workers running threads started with thread_start "
+        "(0 disables pooling)",
+        MCA_BASE_VAR_TYPE_INT, NULL, 0, 0, INFO_LVL_3, MCA_BASE_VAR_SCOPE_LOCAL, &pool_max);
+    (void) mca_base_component_var_register(
+        component, "thread_pool_min", "Number of idle pooled workers that are never retired",
+        MCA_BASE_VAR_TYPE_INT, NULL, 0, 0, INFO_LVL_3, MCA_BASE_VAR_SCOPE_LOCAL, &pool_min);
+    (void) mca_base_component_var_register(
+        component, "thread_pool_idle_timeout",
+        "Milliseconds a pooled worker stays idle before it is retired", MCA_BASE_VAR_TYPE_INT,
+        NULL, 0, 0, INFO_LVL_3, MCA_BASE_VAR_SCOPE_LOCAL, &pool_idle_timeout);
+    return SUCCESS;
+}
+
+int threads_pthreads_pool_key_add(pthread_key_t key, tsd_destructor_t destructor)
+{
+    threads_pthreads_pool_key_t *entry = malloc(sizeof(*entry));
+    threads_pthreads_pool_keys_t *table, *grown;
+    int i, size;
+
+    if (NULL == entry) {
+        return ERR_OUT_OF_RESOURCE;
+    }
+    entry->key = key;
+    entry->destructor = destructor;
+    entry->next_retired = NULL;
+
+    pthread_mutex_lock(&pool_keys_lock);
+    table = pool_keys;
+    /* reuse the slot of a removed key */
+    for (i = 0; i < pool_num_keys && NULL != table->slots[i]; ++i) {
+    }
+    if (NULL == table || i == table->size) {
+        size = NULL == table ? 16 : 2 * table->size;
+        grown = malloc(sizeof(*grown) + size * sizeof(grown->slots[0]));
+        if (NULL == grown) {
+            pthread_mutex_unlock(&pool_keys_lock);
+            free(entry);
+            return ERR_OUT_OF_RESOURCE;
+        }
+        grown->size = size;
+        grown->next_retired = NULL;
+        for (int j = 0; j < size; ++j) {
+            grown->slots[j] = j < pool_num_keys ? table->slots[j] : NULL;
+        }
+        if (NULL != table) {
+            table->next_retired = pool_tables_retired;
+            pool_tables_retired = table;
+        }
+        atomic_wmb();
+        pool_keys = table = grown;
+    }
+    atomic_wmb();
+    table->slots[i] = entry;
+    if (i == pool_num_keys) {
+        atomic_wmb();
+        pool_num_keys = i + 1;
+    }
+    pthread_mutex_unlock(&pool_keys_lock);
+    return SUCCESS;
+}
+
+void threads_pthreads_pool_key_remove(pthread_key_t key)
+{
+    threads_pthreads_pool_keys_t *table;
+    threads_pthreads_pool_key_t *entry;
+
+    pthread_mutex_lock(&pool_keys_lock);
+    table = pool_keys;
+    for (int i = 0; i < pool_num_keys; ++i) {
+        entry = table->slots[i];
+        if (NULL != entry && entry->key == key) {
+            table->slots[i] = NULL;
+            entry->next_retired = pool_keys_retired;
+            pool_keys_retired = entry;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_keys_lock);
+}
+
+/* Clear the calling worker's tsd values and run their destructors, in
+ * as many rounds as pthread_exit since destructors may set values.
+ * Destructors may create or delete keys: each round scans the table
+ * published when it starts. */
+static void pool_run_destructors(void)
+{
+    threads_pthreads_pool_keys_t *table;
+    threads_pthreads_pool_key_t *entry;
+    bool again = true;
+    int num_keys;
+    void *value;
+
+    for (int round = 0; again && round < PTHREAD_DESTRUCTOR_ITERATIONS; ++round) {
+        again = false;
+        num_keys = pool_num_keys;
+        atomic_rmb();
+        table = pool_keys;
+        atomic_rmb();
+        for (int i = 0; i < num_keys; ++i) {
+            entry = table->slots[i];
+            if (NULL == entry) {
+                continue;
+            }
+            value = pthread_getspecific(entry->key);
+            if (NULL == value) {
+                continue;
+            }
+            pthread_setspecific(entry->key, NULL);
+            if (NULL != entry->destructor) {
+                entry->destructor(value);
+                again = true;
+            }
+        }
+    }
+}
+
+static void pool_push_idle(threads_pthreads_worker_t *w)
+{
+    pthread_mutex_lock(&pool_lock);
+    if (!pool_shutdown) {
+        w->idle = true;
+        w->next_idle = pool_idle_head;
+        pool_idle_head = w;
+        pthread_mutex_unlock(&pool_lock);
+        return;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    pthread_mutex_lock(&w->lock);
+    w->quit = true;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* A worker leaves the pool, after which pool_fini may stop waiting */
+static void pool_worker_gone(void)
+{
+    pthread_mutex_lock(&pool_lock);
+    --pool_num_workers;
+    pthread_cond_broadcast(&pool_cond);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static void pool_worker_free(threads_pthreads_worker_t *w)
+{
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+}
+
+/* Cleanup handler for a t_run that does not return: complete the
+ * thread_t so that thread_join does not wait for it forever */
+static void pool_worker_exited(void *arg)
+{
+    threads_pthreads_worker_t *w = (threads_pthreads_worker_t *) arg;
+
+    pool_worker_gone();
+    pthread_mutex_lock(&w->lock);
+    w->ret = NULL;
+    w->exited = true;
+    w->done = true;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* Called by an idle worker whose timeout expired, with its lock held */
+static bool pool_retire(threads_pthreads_worker_t *w)
+{
+    threads_pthreads_worker_t **p;
+    bool retired = false;
+
+    pthread_mutex_lock(&pool_lock);
+    if (w->idle && pool_num_workers > pool_min) {
+        p = &pool_idle_head;
+        while (*p != w) {
+            p = &(*p)->next_idle;
+        }
+        *p = w->next_idle;
+        w->idle = false;
+        --pool_num_workers;
+        pthread_cond_broadcast(&pool_cond);
+        retired = true;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return retired;
+}
+
+static void *pool_worker(void *arg)
+{
+    threads_pthreads_worker_t *w = (threads_pthreads_worker_t *) arg;
+    struct timespec deadline;
+    thread_t *t;
+    void *ret;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (NULL == w->thread || w->done) {
+            if (NULL != w->thread) {
+                /* waiting for thread_join to collect the result */
+                pthread_cond_wait(&w->cond, &w->lock);
+                continue;
+            }
+            if (w->quit) {
+                pthread_mutex_unlock(&w->lock);
+                pool_worker_free(w);
+                pool_worker_gone();
+                return NULL;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += pool_idle_timeout / 1000;
+            deadline.tv_nsec += (long) (pool_idle_timeout % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            if (ETIMEDOUT == pthread_cond_timedwait(&w->cond, &w->lock, &deadline)
+                && NULL == w->thread && !w->quit && pool_retire(w)) {
+                pthread_mutex_unlock(&w->lock);
+                pool_worker_free(w);
+                return NULL;
+            }
+        }
+        t = w->thread;
+        pthread_mutex_unlock(&w->lock);
+
+        pthread_cleanup_push(pool_worker_exited, w);
+        ret = t->t_run((object_t *) t);
+        pthread_cleanup_pop(0);
+        pool_run_destructors();
+
+        pthread_mutex_lock(&w->lock);
+        w->ret = ret;
+        w->done = true;
+        pthread_cond_broadcast(&w->cond);
+    }
+}
+
+static threads_pthreads_worker_t *pool_worker_create(void)
+{
+    threads_pthreads_worker_t *w = malloc(sizeof(*w));
+    pthread_condattr_t condattr;
+    pthread_attr_t attr;
+    int rc;
+
+    if (NULL == w) {
+        return NULL;
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    /* the idle timeout is measured on the monotonic clock */
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&w->cond, &condattr);
+    pthread_condattr_destroy(&condattr);
+    w->thread = NULL;
+    w->done = false;
+    w->ret = NULL;
+    w->exited = false;
+    w->quit = false;
+    w->idle = false;
+    w->next_idle = NULL;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    rc = pthread_create(&w->handle, &attr, pool_worker, w);
+    pthread_attr_destroy(&attr);
+    if (0 != rc) {
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+int threads_pthreads_pool_start(thread_t *t)
+{
+    threads_pthreads_worker_t *w;
+
+    if (0 >= pool_max) {
+        return ERR_NOT_AVAILABLE;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    if (pool_shutdown) {
+        pthread_mutex_unlock(&pool_lock);
+        return ERR_NOT_AVAILABLE;
+    }
+    w = pool_idle_head;
+    if (NULL != w) {
+        pool_idle_head = w->next_idle;
+        w->idle = false;
+    } else if (pool_num_workers < pool_max) {
+        ++pool_num_workers;
+    } else {
+        pthread_mutex_unlock(&pool_lock);
+        return ERR_OUT_OF_RESOURCE;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (NULL == w) {
+        w = pool_worker_create();
+        if (NULL == w) {
+            pthread_mutex_lock(&pool_lock);
+            --pool_num_workers;
+            pthread_mutex_unlock(&pool_lock);
+            return ERR_OUT_OF_RESOURCE;
+        }
+    }
+
+    /* Publish the handle before t_run can call thread_self_compare */
+    pthread_mutex_lock(&w->lock);
+    t->t_handle = w->handle;
+    t->t_pool_slot = w;
+    w->thread = t;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    return SUCCESS;
+}
+
+int threads_pthreads_pool_join(thread_t *t, void **thr_return)
+{
+    threads_pthreads_worker_t *w = (threads_pthreads_worker_t *) t->t_pool_slot;
+    bool exited;
+
+    pthread_mutex_lock(&w->lock);
+    while (!w->done) {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    if (NULL != thr_return) {
+        *thr_return = w->ret;
+    }
+    exited = w->exited;
+    w->thread = NULL;
+    w->done = false;
+    /* start the worker's idle timeout */
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+
+    t->t_handle = (pthread_t) -1;
+    t->t_pool_slot = NULL;
+    if (exited) {
+        pool_worker_free(w);
+    } else {
+        pool_push_idle(w);
+    }
+    return SUCCESS;
+}
+
+void threads_pthreads_pool_fini(void)
+{
+    threads_pthreads_worker_t *w, *next;
+    threads_pthreads_pool_keys_t *table;
+    threads_pthreads_pool_key_t *entry;
+
+    pthread_mutex_lock(&pool_lock);
+    pool_shutdown = true;
+    w = pool_idle_head;
+    pool_idle_head = NULL;
+    for (next = w; NULL != next; next = next->next_idle) {
+        next->idle = false;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    for (; NULL != w; w = next) {
+        next = w->next_idle;
+        pthread_mutex_lock(&w->lock);
+        w->quit = true;
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+
+    /* Busy workers quit as their thread_t is joined */
+    pthread_mutex_lock(&pool_lock);
+    while (0 < pool_num_workers) {
+        pthread_cond_wait(&pool_cond, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    /* No worker is left reading the key table */
+    pthread_mutex_lock(&pool_keys_lock);
+    while (NULL != (entry = pool_keys_retired)) {
+        pool_keys_retired = entry->next_retired;
+        free(entry);
+    }
+    while (NULL != (table = pool_tables_retired)) {
+        pool_tables_retired = table->next_retired;
+        free(table);
+    }
+    pthread_mutex_unlock(&pool_keys_lock);
+}
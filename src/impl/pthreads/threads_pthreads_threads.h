@@ -3,7 +3,7 @@
 #include <pthread.h>
 #include <signal.h>
 
-#include "hreads_pthreads.h"
+#include "threads_pthreads.h"
 #include "threads.h"
 
 /* Pthreads do not need to yield when idle */
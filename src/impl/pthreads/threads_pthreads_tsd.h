@@ -5,8 +5,16 @@
 
 typedef pthread_key_t tsd_key_t;
 
+/* Keys whose values pooled workers clear between two thread_t, see
+ * threads_pthreads_pool.c */
+int threads_pthreads_pool_key_add(pthread_key_t key,
+                                  void (*destructor)(void *));
+void threads_pthreads_pool_key_remove(pthread_key_t key);
+
 static inline int tsd_key_delete(tsd_key_t key) {
-  int ret = pthread_key_delete(key);
+  int ret;
+  threads_pthreads_pool_key_remove(key);
+  ret = pthread_key_delete(key);
   return 0 == ret ? SUCCESS : ERR_IN_ERRNO;
 }
 
@@ -3,7 +3,20 @@
 #include "threads.h"
 
 static int threads_qthreads_open(void);
+static int threads_qthreads_register(void);
 
+int threads_qthreads_mutex_fair = 1;
+
+int threads_qthreads_register(void)
+{
+    (void) mca_base_component_var_register(
+        &mca_threads_qthreads_component.threadsc_version, "mutex_fair",
+        "Whether mutexes hand the lock over to waiting qthreads in FIFO order (1) or let "
+        "the releasing qthread reacquire it for throughput (0)",
+        MCA_BASE_VAR_TYPE_INT, NULL, 0, 0, INFO_LVL_3, MCA_BASE_VAR_SCOPE_LOCAL,
+        &threads_qthreads_mutex_fair);
+    return SUCCESS;
+}
 
 int threads_qthreads_open(void)
 {
@@ -0,0 +1,110 @@
+#if THREADS_MULTI_BACKEND
+/* The timed wait works on the qthreads waiter queues, not on the opaque
+ * multi-backend condition: see the backend's own types, as
+ * threads_qthreads_ops.c does, whose inlined cond_timedwait calls it */
+#define THREADS_BACKEND_IMPL 1
+
+#include "threads_backend.h"
+#include "threads_qthreads.h"
+#include "threads_qthreads_mutex.h"
+#else
+#include "threads_qthreads.h"
+#include "threads.h"
+#endif
+
+#include "timer_wheel.h"
+
+/* A qthread in thread_internal_cond_timedwait, with the timer that
+ * withdraws it from the condition when the deadline passes */
+typedef struct {
+    ult_timer_t tw_timer;
+    thread_internal_cond_t *tw_cond;
+    thread_cond_waiter_t tw_waiter;
+    volatile int32_t tw_timedout;
+    /* set by the timer callback as its last access to the waiter */
+    volatile int32_t tw_fired;
+} threads_qthreads_timed_waiter_t;
+
+/* Unlink a waiter still queued on a condition, with m_lock held, and
+ * fill its word. Returns false if a signaler dequeued it first. */
+static bool threads_qthreads_cond_withdraw(thread_internal_cond_t *p_cond,
+                                           thread_cond_waiter_t *waiter)
+{
+    thread_cond_waiter_t **link = &p_cond->m_waiter_tail, *newer = NULL;
+
+    while (NULL != *link && waiter != *link) {
+        newer = *link;
+        link = &(*link)->m_prev;
+    }
+    if (NULL == *link) {
+        return false;
+    }
+    *link = waiter->m_prev;
+    if (waiter == p_cond->m_waiter_head) {
+        p_cond->m_waiter_head = newer;
+    }
+    qthread_fill(&waiter->m_feb);
+    return true;
+}
+
+/* Runs on the timer service thread, outside of any qthread; filling a
+ * word does not block */
+static void threads_qthreads_cond_timer_fire(ult_timer_t *timer)
+{
+    threads_qthreads_timed_waiter_t *tw = (threads_qthreads_timed_waiter_t *) timer;
+    thread_internal_cond_t *p_cond = tw->tw_cond;
+
+    qthread_spinlock_lock(&p_cond->m_lock);
+    if (threads_qthreads_cond_withdraw(p_cond, &tw->tw_waiter)) {
+        tw->tw_timedout = 1;
+    }
+    qthread_spinlock_unlock(&p_cond->m_lock);
+    atomic_wmb();
+    tw->tw_fired = 1;
+}
+
+int threads_qthreads_cond_timedwait(thread_internal_cond_t *p_cond, thread_internal_mutex_t *p_mutex,
+                                    const struct timespec *abstime)
+{
+    threads_qthreads_timed_waiter_t tw;
+    uint64_t deadline = (uint64_t) abstime->tv_sec * 1000000000 + (uint64_t) abstime->tv_nsec;
+    aligned_t value;
+    bool armed;
+
+    threads_ensure_init_qthreads();
+    tw.tw_cond = p_cond;
+    tw.tw_waiter.m_feb = 0;
+    tw.tw_waiter.m_prev = NULL;
+    tw.tw_timedout = 0;
+    tw.tw_fired = 0;
+    qthread_empty(&tw.tw_waiter.m_feb);
+    threads_qthreads_cond_enqueue(p_cond, &tw.tw_waiter);
+    thread_internal_mutex_unlock(p_mutex);
+
+    armed = ult_timer_now() < deadline
+            && SUCCESS == ult_timer_add(&tw.tw_timer, deadline, threads_qthreads_cond_timer_fire);
+    if (!armed) {
+        /* Past the deadline already, or no timer service: poll the
+         * clock between yields */
+        while (!qthread_feb_status(&tw.tw_waiter.m_feb) && ult_timer_now() < deadline) {
+            qthread_yield();
+        }
+        qthread_spinlock_lock(&p_cond->m_lock);
+        if (threads_qthreads_cond_withdraw(p_cond, &tw.tw_waiter)) {
+            tw.tw_timedout = 1;
+        }
+        qthread_spinlock_unlock(&p_cond->m_lock);
+    }
+    /* Leave the word full, and wait for a signaler that already owns it */
+    qthread_readFF(&value, &tw.tw_waiter.m_feb);
+
+    /* A timer that already fired may still be withdrawing us */
+    if (armed && !ult_timer_cancel(&tw.tw_timer)) {
+        while (0 == tw.tw_fired) {
+            qthread_yield();
+        }
+        atomic_rmb();
+    }
+    thread_internal_mutex_lock(p_mutex);
+    return tw.tw_timedout;
+}
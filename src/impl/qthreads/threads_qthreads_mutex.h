@@ -6,69 +6,129 @@
 
 #include "threads_qthreads.h"
 #include <stdio.h>
+#include <time.h>
 
-typedef qthread_spinlock_t thread_internal_mutex_t;
+/*
+ * Ticket lock.  In fair mode (the default, see the "mutex_fair"
+ * component variable and mutex_set_fair()) contended acquirers queue in
+ * ticket order and an unlock with queued waiters yields so that the next
+ * ticket holder runs before the releasing qthread can come back for the
+ * lock.  In throughput mode acquirers only take the lock while it is
+ * free and unlocking never yields.  Either way an unlock without waiters
+ * costs a single store.
+ */
 
-#define THREAD_INTERNAL_MUTEX_INITIALIZER QTHREAD_MUTEX_INITIALIZER
+/* Whether mutexes without a policy of their own are fair */
+extern int threads_qthreads_mutex_fair;
+
+#define THREADS_QTHREADS_MUTEX_DEFAULT 0
+#define THREADS_QTHREADS_MUTEX_THROUGHPUT 1
+#define THREADS_QTHREADS_MUTEX_FAIR 2
+
+typedef struct {
+  /* next ticket to hand out */
+  atomic_int32_t m_next;
+  /* ticket of the current owner */
+  atomic_int32_t m_serving;
+  int32_t m_policy;
+  /* recursion depth, -1 for non-recursive mutexes */
+  int32_t m_depth;
+  unsigned m_owner;
+} thread_internal_mutex_t;
+
+#define THREAD_INTERNAL_MUTEX_INITIALIZER                                      \
+  {                                                                            \
+    .m_next = 0, .m_serving = 0, .m_policy = THREADS_QTHREADS_MUTEX_DEFAULT,   \
+    .m_depth = -1, .m_owner = 0,                                               \
+  }
 #define THREAD_INTERNAL_RECURSIVE_MUTEX_INITIALIZER                            \
-  QTHREAD_RECURSIVE_MUTEX_INITIALIZER
+  {                                                                            \
+    .m_next = 0, .m_serving = 0, .m_policy = THREADS_QTHREADS_MUTEX_DEFAULT,   \
+    .m_depth = 0, .m_owner = 0,                                                \
+  }
+
+#define THREAD_INTERNAL_MUTEX_HAS_FAIRNESS 1
 
 static inline int thread_internal_mutex_init(thread_internal_mutex_t *p_mutex,
                                              bool recursive) {
   threads_ensure_init_qthreads();
-#if ENABLE_DEBUG
-  int ret = qthread_spinlock_init(p_mutex, recursive);
-  if (QTHREAD_SUCCESS != ret) {
-    show_help("help-opal-threads.txt", "mutex init failed", true);
-  }
-#else
-  qthread_spinlock_init(p_mutex, recursive);
-#endif
+  p_mutex->m_next = 0;
+  p_mutex->m_serving = 0;
+  p_mutex->m_policy = THREADS_QTHREADS_MUTEX_DEFAULT;
+  p_mutex->m_depth = recursive ? 0 : -1;
+  p_mutex->m_owner = 0;
   return SUCCESS;
 }
 
 static inline void
-thread_internal_mutex_lock(thread_internal_mutex_t *p_mutex) {
-  threads_ensure_init_qthreads();
-#if ENABLE_DEBUG
-  int ret = qthread_spinlock_lock(p_mutex);
-  if (QTHREAD_SUCCESS != ret) {
-    show_help("help-opal-threads.txt", "mutex lock failed", true);
-  }
-#else
-  qthread_spinlock_lock(p_mutex);
-#endif
+thread_internal_mutex_set_fair(thread_internal_mutex_t *p_mutex, bool fair) {
+  p_mutex->m_policy =
+      fair ? THREADS_QTHREADS_MUTEX_FAIR : THREADS_QTHREADS_MUTEX_THROUGHPUT;
+}
+
+static inline bool
+threads_qthreads_mutex_is_fair(thread_internal_mutex_t *p_mutex) {
+  return THREADS_QTHREADS_MUTEX_FAIR == p_mutex->m_policy ||
+         (THREADS_QTHREADS_MUTEX_DEFAULT == p_mutex->m_policy &&
+          threads_qthreads_mutex_fair);
 }
 
 static inline int
 thread_internal_mutex_trylock(thread_internal_mutex_t *p_mutex) {
   threads_ensure_init_qthreads();
-  int ret = qthread_spinlock_trylock(p_mutex);
-  if (QTHREAD_OPFAIL == ret) {
-    return 1;
-  } else if (QTHREAD_SUCCESS != ret) {
-#if ENABLE_DEBUG
-    show_help("help-opal-threads.txt", "mutex trylock failed", true);
-#endif
+  if (p_mutex->m_depth > 0 && qthread_id() == p_mutex->m_owner) {
+    ++p_mutex->m_depth;
+    return 0;
+  }
+  /* Only take a ticket while nobody holds or waits for the lock */
+  int32_t ticket = p_mutex->m_serving;
+  if (p_mutex->m_next != ticket ||
+      !atomic_compare_exchange_strong_acq_32(&p_mutex->m_next, &ticket,
+                                             ticket + 1)) {
     return 1;
   }
+  if (p_mutex->m_depth >= 0) {
+    p_mutex->m_owner = qthread_id();
+    p_mutex->m_depth = 1;
+  }
   return 0;
 }
 
+static inline void
+thread_internal_mutex_lock(thread_internal_mutex_t *p_mutex) {
+  if (LIKELY(0 == thread_internal_mutex_trylock(p_mutex))) {
+    return;
+  }
+  if (threads_qthreads_mutex_is_fair(p_mutex)) {
+    int32_t ticket = atomic_fetch_add_32(&p_mutex->m_next, 1);
+    while (ticket != p_mutex->m_serving) {
+      qthread_yield();
+    }
+    atomic_rmb();
+    if (p_mutex->m_depth >= 0) {
+      p_mutex->m_owner = qthread_id();
+      p_mutex->m_depth = 1;
+    }
+  } else {
+    do {
+      qthread_yield();
+    } while (0 != thread_internal_mutex_trylock(p_mutex));
+  }
+}
+
 static inline void
 thread_internal_mutex_unlock(thread_internal_mutex_t *p_mutex) {
-  threads_ensure_init_qthreads();
-  int ret;
-#if ENABLE_DEBUG
-  ret = qthread_spinlock_unlock(p_mutex);
-  if (QTHREAD_SUCCESS != ret) {
-    show_help("help-opal-threads.txt", "mutex unlock failed", true);
+  if (p_mutex->m_depth > 0 && 0 != --p_mutex->m_depth) {
+    return;
+  }
+  int32_t next = p_mutex->m_serving + 1;
+  atomic_wmb();
+  p_mutex->m_serving = next;
+  /* For fairness of locking: let the next ticket holder run. */
+  if (UNLIKELY(p_mutex->m_next != next) &&
+      threads_qthreads_mutex_is_fair(p_mutex)) {
+    qthread_yield();
   }
-#else
-  qthread_spinlock_unlock(p_mutex);
-#endif
-  /* For fairness of locking. */
-  qthread_yield();
 }
 
 static inline void
@@ -76,13 +136,17 @@ thread_internal_mutex_destroy(thread_internal_mutex_t *p_mutex) {
   /* No specific operation is needed to destroy thread_internal_mutex_t. */
 }
 
+/* A qthread blocked on a condition variable. It lives on the waiter's
+ * stack and blocks on the full/empty bit of m_feb: the word is emptied
+ * before the waiter is queued and filled by the signaler once it has
+ * dequeued the waiter, which is the last time the signaler touches it. */
 typedef struct thread_cond_waiter_t {
-  int m_signaled;
+  aligned_t m_feb;
   struct thread_cond_waiter_t *m_prev;
 } thread_cond_waiter_t;
 
 typedef struct {
-  thread_internal_mutex_t m_lock;
+  qthread_spinlock_t m_lock;
   thread_cond_waiter_t *m_waiter_head;
   thread_cond_waiter_t *m_waiter_tail;
 } thread_internal_cond_t;
@@ -100,43 +164,65 @@ static inline int thread_internal_cond_init(thread_internal_cond_t *p_cond) {
   return SUCCESS;
 }
 
-static inline void thread_internal_cond_wait(thread_internal_cond_t *p_cond,
-                                             thread_internal_mutex_t *p_mutex) {
-  threads_ensure_init_qthreads();
-  /* This thread is taking "lock", so only this thread can access this
-   * condition variable.  */
+/* Queue a waiter whose word was emptied, newest at the head */
+static inline void threads_qthreads_cond_enqueue(thread_internal_cond_t *p_cond,
+                                                 thread_cond_waiter_t *waiter) {
   qthread_spinlock_lock(&p_cond->m_lock);
-  thread_cond_waiter_t waiter = {0, NULL};
   if (NULL == p_cond->m_waiter_head) {
-    p_cond->m_waiter_tail = &waiter;
+    p_cond->m_waiter_tail = waiter;
   } else {
-    p_cond->m_waiter_head->m_prev = &waiter;
+    p_cond->m_waiter_head->m_prev = waiter;
   }
-  p_cond->m_waiter_head = &waiter;
+  p_cond->m_waiter_head = waiter;
   qthread_spinlock_unlock(&p_cond->m_lock);
-  while (1) {
-    thread_internal_mutex_unlock(p_mutex);
-    qthread_yield();
-    thread_internal_mutex_lock(p_mutex);
-    /* Check if someone woke me up. */
-    qthread_spinlock_lock(&p_cond->m_lock);
-    int signaled = waiter.m_signaled;
-    qthread_spinlock_unlock(&p_cond->m_lock);
-    if (1 == signaled) {
-      break;
-    }
-    /* Unlock the lock again. */
-  }
+}
+
+static inline void thread_internal_cond_wait(thread_internal_cond_t *p_cond,
+                                             thread_internal_mutex_t *p_mutex) {
+  threads_ensure_init_qthreads();
+  thread_cond_waiter_t waiter = {0, NULL};
+  aligned_t value;
+  /* Empty before queueing so that a signal can not be missed. */
+  qthread_empty(&waiter.m_feb);
+  threads_qthreads_cond_enqueue(p_cond, &waiter);
+  thread_internal_mutex_unlock(p_mutex);
+  /* Block until the signaler fills the word. readFF leaves it full, the
+   * default state, so the stack slot carries no FEB state afterwards. */
+  qthread_readFF(&value, &waiter.m_feb);
+  thread_internal_mutex_lock(p_mutex);
+}
+
+DECLSPEC int threads_qthreads_cond_timedwait(thread_internal_cond_t *p_cond,
+                                             thread_internal_mutex_t *p_mutex,
+                                             const struct timespec *abstime);
+
+/**
+ * Wait until signaled or until abstime on CLOCK_MONOTONIC passes.
+ *
+ * Full/empty bits have no timeout: the waiter blocks on its word, and a
+ * timer on the timer wheel withdraws it from the condition and fills
+ * the word at the deadline, see threads_qthreads_mutex.c.
+ *
+ * @return 0 once signaled, 1 on timeout
+ */
+static inline int
+thread_internal_cond_timedwait(thread_internal_cond_t *p_cond,
+                               thread_internal_mutex_t *p_mutex,
+                               const struct timespec *abstime) {
+  return threads_qthreads_cond_timedwait(p_cond, p_mutex, abstime);
 }
 
 static inline void
 thread_internal_cond_broadcast(thread_internal_cond_t *p_cond) {
+  if (NULL == p_cond->m_waiter_tail) {
+    return;
+  }
   qthread_spinlock_lock(&p_cond->m_lock);
   while (NULL != p_cond->m_waiter_tail) {
     thread_cond_waiter_t *p_cur_tail = p_cond->m_waiter_tail;
     p_cond->m_waiter_tail = p_cur_tail->m_prev;
     /* Awaken one of threads in a FIFO manner. */
-    p_cur_tail->m_signaled = 1;
+    qthread_fill(&p_cur_tail->m_feb);
   }
   /* No waiters. */
   p_cond->m_waiter_head = NULL;
@@ -144,15 +230,20 @@ thread_internal_cond_broadcast(thread_internal_cond_t *p_cond) {
 }
 
 static inline void thread_internal_cond_signal(thread_internal_cond_t *p_cond) {
+  /* Waiters queue themselves with the user mutex held, so a signaler
+   * holding it sees them without taking the queue lock. */
+  if (NULL == p_cond->m_waiter_tail) {
+    return;
+  }
   qthread_spinlock_lock(&p_cond->m_lock);
   if (NULL != p_cond->m_waiter_tail) {
     thread_cond_waiter_t *p_cur_tail = p_cond->m_waiter_tail;
     p_cond->m_waiter_tail = p_cur_tail->m_prev;
-    /* Awaken one of threads. */
-    p_cur_tail->m_signaled = 1;
     if (NULL == p_cond->m_waiter_tail) {
       p_cond->m_waiter_head = NULL;
     }
+    /* Awaken one of threads. */
+    qthread_fill(&p_cur_tail->m_feb);
   }
   qthread_spinlock_unlock(&p_cond->m_lock);
 }
@@ -161,3 +252,5 @@ static inline void
 thread_internal_cond_destroy(thread_internal_cond_t *p_cond) {
   /* No destructor is needed. */
 }
+
+#endif /* MCA_THREADS_QTHREADS_THREADS_QTHREADS_MUTEX_H */
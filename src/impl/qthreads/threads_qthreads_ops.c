@@ -0,0 +1,29 @@
+#if THREADS_MULTI_BACKEND
+
+#define THREADS_BACKEND_IMPL 1
+
+#include "threads_backend.h"
+#include "threads_qthreads.h"
+#include "threads_qthreads_mutex.h"
+#include "threads_qthreads_tsd.h"
+
+static int threads_backend_ops_key_create(tsd_key_t *key, void (*destructor)(void *))
+{
+    threads_ensure_init_qthreads();
+    qthread_key_create(key, destructor);
+    return SUCCESS;
+}
+
+static void threads_backend_ops_yield(void)
+{
+    qthread_yield();
+}
+
+#define THREADS_BACKEND_OPS threads_qthreads_backend_ops
+#define THREADS_BACKEND_OPS_NAME "qthreads"
+/* Qthreads are cooperatively scheduled so yield when idle */
+#define THREADS_BACKEND_OPS_YIELD_WHEN_IDLE true
+
+#include "threads_backend_ops.h"
+
+#endif /* THREADS_MULTI_BACKEND */
@@ -0,0 +1,343 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * Header-only C++ layer over the backend primitives.
+ *
+ * libult::mutex, libult::recursive_mutex, libult::condition_variable,
+ * libult::thread and libult::thread_local_key follow their standard
+ * library counterparts closely enough to be used with
+ * std::lock_guard, std::unique_lock and std::scoped_lock (mutexes meet
+ * the Lockable requirements).
+ *
+ * The classes are templates over a backend policy, a class of static
+ * functions on the backend's own types.  default_backend calls the
+ * thread_internal_* functions directly, so in a build with a single
+ * backend every lock, unlock, wait and signal inlines down to the
+ * backend, without the mutex_t bookkeeping (debug tracking, lock
+ * profiling, the using_threads() check) of the C macros.  In a build
+ * with several backends (THREADS_MULTI_BACKEND) the same calls go
+ * through the ops table of the backend selected at run time.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+extern "C" {
+#include "mutex.h"
+#include "threads.h"
+#include "tsd.h"
+}
+
+namespace libult {
+
+namespace backend {
+
+// The backend libult was built with
+struct internal {
+  using mutex_type = thread_internal_mutex_t;
+  using cond_type = thread_internal_cond_t;
+
+  static void mutex_init(mutex_type *m, bool recursive) noexcept {
+    thread_internal_mutex_init(m, recursive);
+  }
+  static void mutex_lock(mutex_type *m) noexcept {
+    thread_internal_mutex_lock(m);
+  }
+  static bool mutex_trylock(mutex_type *m) noexcept {
+    return 0 == thread_internal_mutex_trylock(m);
+  }
+  static void mutex_unlock(mutex_type *m) noexcept {
+    thread_internal_mutex_unlock(m);
+  }
+  static void mutex_destroy(mutex_type *m) noexcept {
+    thread_internal_mutex_destroy(m);
+  }
+
+  static void cond_init(cond_type *c) noexcept { thread_internal_cond_init(c); }
+  static void cond_wait(cond_type *c, mutex_type *m) noexcept {
+    thread_internal_cond_wait(c, m);
+  }
+  // true once signaled, false on timeout
+  static bool cond_timedwait(cond_type *c, mutex_type *m,
+                             const struct timespec *abstime) noexcept {
+    return 0 == thread_internal_cond_timedwait(c, m, abstime);
+  }
+  static void cond_signal(cond_type *c) noexcept {
+    thread_internal_cond_signal(c);
+  }
+  static void cond_broadcast(cond_type *c) noexcept {
+    thread_internal_cond_broadcast(c);
+  }
+  static void cond_destroy(cond_type *c) noexcept {
+    thread_internal_cond_destroy(c);
+  }
+
+  static void yield() noexcept { thread_yield(); }
+};
+
+} // namespace backend
+
+using default_backend = backend::internal;
+
+/**
+ * Mutex of the backend, Lockable.
+ */
+template <typename Backend = default_backend, bool Recursive = false>
+class basic_mutex {
+public:
+  using native_handle_type = typename Backend::mutex_type *;
+
+  basic_mutex() noexcept { Backend::mutex_init(&m_mutex, Recursive); }
+  basic_mutex(const basic_mutex &) = delete;
+  basic_mutex &operator=(const basic_mutex &) = delete;
+  ~basic_mutex() { Backend::mutex_destroy(&m_mutex); }
+
+  void lock() noexcept { Backend::mutex_lock(&m_mutex); }
+  bool try_lock() noexcept { return Backend::mutex_trylock(&m_mutex); }
+  void unlock() noexcept { Backend::mutex_unlock(&m_mutex); }
+
+  native_handle_type native_handle() noexcept { return &m_mutex; }
+
+private:
+  typename Backend::mutex_type m_mutex;
+};
+
+using mutex = basic_mutex<>;
+using recursive_mutex = basic_mutex<default_backend, true>;
+
+/**
+ * Condition variable of the backend, waited on with a
+ * std::unique_lock of the matching basic_mutex.
+ *
+ * Timed waits are measured on CLOCK_MONOTONIC; deadlines on other
+ * clocks are converted to it.
+ */
+template <typename Backend = default_backend> class basic_condition_variable {
+public:
+  using native_handle_type = typename Backend::cond_type *;
+  using lock_type = std::unique_lock<basic_mutex<Backend>>;
+
+  basic_condition_variable() noexcept { Backend::cond_init(&m_cond); }
+  basic_condition_variable(const basic_condition_variable &) = delete;
+  basic_condition_variable &
+  operator=(const basic_condition_variable &) = delete;
+  ~basic_condition_variable() { Backend::cond_destroy(&m_cond); }
+
+  void notify_one() noexcept { Backend::cond_signal(&m_cond); }
+  void notify_all() noexcept { Backend::cond_broadcast(&m_cond); }
+
+  void wait(lock_type &lock) noexcept {
+    Backend::cond_wait(&m_cond, lock.mutex()->native_handle());
+  }
+
+  template <typename Predicate> void wait(lock_type &lock, Predicate pred) {
+    while (!pred()) {
+      wait(lock);
+    }
+  }
+
+  template <typename Clock, typename Duration>
+  std::cv_status
+  wait_until(lock_type &lock,
+             const std::chrono::time_point<Clock, Duration> &deadline) {
+    using namespace std::chrono;
+    auto left = deadline - Clock::now();
+    struct timespec abstime;
+    clock_gettime(CLOCK_MONOTONIC, &abstime);
+    auto ns = duration_cast<nanoseconds>(left).count();
+    if (ns > 0) {
+      ns += abstime.tv_nsec;
+      abstime.tv_sec += static_cast<time_t>(ns / 1000000000);
+      abstime.tv_nsec = static_cast<long>(ns % 1000000000);
+    }
+    if (Backend::cond_timedwait(&m_cond, lock.mutex()->native_handle(),
+                                &abstime)) {
+      return std::cv_status::no_timeout;
+    }
+    return Clock::now() < deadline ? std::cv_status::no_timeout
+                                   : std::cv_status::timeout;
+  }
+
+  template <typename Clock, typename Duration, typename Predicate>
+  bool wait_until(lock_type &lock,
+                  const std::chrono::time_point<Clock, Duration> &deadline,
+                  Predicate pred) {
+    while (!pred()) {
+      if (std::cv_status::timeout == wait_until(lock, deadline)) {
+        return pred();
+      }
+    }
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  std::cv_status wait_for(lock_type &lock,
+                          const std::chrono::duration<Rep, Period> &timeout) {
+    return wait_until(lock, std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <typename Rep, typename Period, typename Predicate>
+  bool wait_for(lock_type &lock,
+                const std::chrono::duration<Rep, Period> &timeout,
+                Predicate pred) {
+    return wait_until(lock, std::chrono::steady_clock::now() + timeout,
+                      std::move(pred));
+  }
+
+  native_handle_type native_handle() noexcept { return &m_cond; }
+
+private:
+  typename Backend::cond_type m_cond;
+};
+
+using condition_variable = basic_condition_variable<>;
+
+/**
+ * Thread started with thread_start: a ULT on the ULT backends, a
+ * pooled or dedicated pthread on pthreads.  Must be joined before it
+ * is destroyed.
+ */
+class thread {
+public:
+  thread() noexcept = default;
+
+  template <typename F, typename... Args,
+            typename = std::enable_if_t<
+                !std::is_same<std::decay_t<F>, thread>::value>>
+  explicit thread(F &&f, Args &&...args) {
+    using state_type = state<std::decay_t<F>, std::decay_t<Args>...>;
+    auto *s = new state_type(std::forward<F>(f), std::forward<Args>(args)...);
+    m_thread = new thread_t;
+    OBJ_CONSTRUCT(m_thread, thread_t);
+    m_thread->t_run = run<state_type>;
+    m_thread->t_arg = s;
+    if (SUCCESS != thread_start(m_thread)) {
+      OBJ_DESTRUCT(m_thread);
+      delete m_thread;
+      m_thread = nullptr;
+      delete s;
+      throw std::system_error(std::make_error_code(
+          std::errc::resource_unavailable_try_again));
+    }
+  }
+
+  thread(thread &&other) noexcept
+      : m_thread(std::exchange(other.m_thread, nullptr)) {}
+  thread &operator=(thread &&other) noexcept {
+    if (joinable()) {
+      std::terminate();
+    }
+    m_thread = std::exchange(other.m_thread, nullptr);
+    return *this;
+  }
+  thread(const thread &) = delete;
+  thread &operator=(const thread &) = delete;
+  ~thread() {
+    if (joinable()) {
+      std::terminate();
+    }
+  }
+
+  bool joinable() const noexcept { return nullptr != m_thread; }
+
+  void join() {
+    if (!joinable()) {
+      throw std::system_error(
+          std::make_error_code(std::errc::invalid_argument));
+    }
+    thread_join(m_thread, nullptr);
+    OBJ_DESTRUCT(m_thread);
+    delete m_thread;
+    m_thread = nullptr;
+  }
+
+  thread_t *native_handle() noexcept { return m_thread; }
+
+private:
+  template <typename F, typename... Args> struct state {
+    template <typename G, typename... A>
+    explicit state(G &&g, A &&...a)
+        : fn(std::forward<G>(g)), args(std::forward<A>(a)...) {}
+    F fn;
+    std::tuple<Args...> args;
+  };
+
+  template <typename State> static void *run(object_t *arg) {
+    std::unique_ptr<State> s(
+        static_cast<State *>(reinterpret_cast<thread_t *>(arg)->t_arg));
+    std::apply(std::move(s->fn), std::move(s->args));
+    return nullptr;
+  }
+
+  thread_t *m_thread = nullptr;
+};
+
+namespace this_thread {
+
+/**
+ * Let other threads or ULTs of the backend run.
+ */
+inline void yield() noexcept { default_backend::yield(); }
+
+} // namespace this_thread
+
+/**
+ * Per-thread (per-ULT on the ULT backends) pointer to a T, deleted when
+ * its thread exits.
+ */
+template <typename T> class thread_local_key {
+public:
+  thread_local_key() {
+    if (SUCCESS != tsd_key_create(&m_key, destroy)) {
+      throw std::system_error(std::make_error_code(
+          std::errc::resource_unavailable_try_again));
+    }
+  }
+  thread_local_key(const thread_local_key &) = delete;
+  thread_local_key &operator=(const thread_local_key &) = delete;
+  /* Values still set are not deleted, as with tsd_key_delete */
+  ~thread_local_key() { tsd_key_delete(m_key); }
+
+  T *get() const noexcept {
+    void *value = nullptr;
+    tsd_get(m_key, &value);
+    return static_cast<T *>(value);
+  }
+
+  /**
+   * Replace the calling thread's value, deleting the previous one.
+   */
+  void reset(T *value = nullptr) {
+    T *previous = get();
+    if (previous != value) {
+      tsd_set(m_key, value);
+      delete previous;
+    }
+  }
+
+  /**
+   * Give up the calling thread's value without deleting it.
+   */
+  T *release() noexcept {
+    T *value = get();
+    tsd_set(m_key, nullptr);
+    return value;
+  }
+
+private:
+  static void destroy(void *value) { delete static_cast<T *>(value); }
+
+  tsd_key_t m_key;
+};
+
+} // namespace libult
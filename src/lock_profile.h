@@ -0,0 +1,148 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * @file
+ *
+ * Sampling lock contention profiler.
+ *
+ * With LIBULT_ENABLE_LOCK_PROFILE every THREAD_LOCK/THREAD_SCOPED_LOCK
+ * expansion owns a static lock_profile_site_t.  One acquisition in
+ * lock_profile_period per thread is timed: the site records whether the
+ * lock was contended, how long the caller waited and how long the lock
+ * was held, into log2 nanosecond histograms.  Unsampled acquisitions
+ * only pay a thread-local counter increment.
+ *
+ * Only the holder reads and writes a mutex's sample, and a hold ends
+ * unaccounted when the mutex is released by any other route than
+ * mutex_unlock_profiled: condition waits drop the sample, and the next
+ * unsampled acquisition discards what a plain mutex_unlock left behind.
+ *
+ * lock_profile_report() prints the sites ordered by estimated total wait
+ * time.  Setting LIBULT_LOCK_PROFILE_OUTPUT to a file name (or "-" for
+ * stderr) writes the report at exit.
+ */
+
+#define LOCK_PROFILE_BUCKETS 40
+
+typedef struct lock_profile_site_t {
+  const char *file;
+  int line;
+  atomic_int32_t registered;
+  atomic_int64_t samples;
+  atomic_int64_t contended;
+  atomic_int64_t wait_ns;
+  atomic_int64_t hold_ns;
+  /* bucket i counts durations in [2^(i-1), 2^i) nanoseconds */
+  atomic_int64_t wait_hist[LOCK_PROFILE_BUCKETS];
+  atomic_int64_t hold_hist[LOCK_PROFILE_BUCKETS];
+  struct lock_profile_site_t *next;
+} lock_profile_site_t;
+
+#define LOCK_PROFILE_SITE_INIT                                                 \
+  { .file = __FILE__, .line = __LINE__ }
+
+/* Sampling period minus one, the period is a power of two */
+DECLSPEC extern uint32_t lock_profile_sample_mask;
+
+DECLSPEC void lock_profile_register(lock_profile_site_t *site);
+DECLSPEC void lock_profile_set_period(uint32_t period);
+DECLSPEC void lock_profile_report(FILE *out);
+DECLSPEC void lock_profile_reset(void);
+
+static inline uint64_t lock_profile_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static inline void lock_profile_record(atomic_int64_t *hist,
+                                       atomic_int64_t *total, uint64_t ns) {
+  int bucket = 0 == ns ? 0 : 64 - __builtin_clzll(ns);
+  if (bucket >= LOCK_PROFILE_BUCKETS) {
+    bucket = LOCK_PROFILE_BUCKETS - 1;
+  }
+  atomic_fetch_add_64(&hist[bucket], 1);
+  atomic_fetch_add_64(total, (int64_t)ns);
+}
+
+static inline bool lock_profile_sample(void) {
+#if HAVE_THREAD_LOCAL
+  static thread_local uint32_t tick = 0;
+#else
+  static uint32_t tick = 0; /* racy, but only drives sampling */
+#endif
+  return 0 == (++tick & lock_profile_sample_mask);
+}
+
+/**
+ * Acquire a mutex on behalf of a profiled call site.
+ *
+ * @param mutex         Address of the mutex.
+ * @param site          Static profile record of the call site.
+ */
+static inline void mutex_lock_profiled(mutex_t *mutex,
+                                       lock_profile_site_t *site) {
+  uint64_t start, now;
+
+  if (LIKELY(!lock_profile_sample())) {
+    mutex_lock(mutex);
+    /* A sampled holder released the mutex by another route */
+    if (UNLIKELY(NULL != mutex->m_prof_site)) {
+      mutex->m_prof_site = NULL;
+    }
+    return;
+  }
+  if (UNLIKELY(!site->registered)) {
+    lock_profile_register(site);
+  }
+
+  start = lock_profile_now();
+  atomic_fetch_add_64(&site->samples, 1);
+  if (0 != mutex_trylock(mutex)) {
+    mutex_lock(mutex);
+    now = lock_profile_now();
+    atomic_fetch_add_64(&site->contended, 1);
+    lock_profile_record(site->wait_hist, &site->wait_ns, now - start);
+    start = now;
+  } else {
+    lock_profile_record(site->wait_hist, &site->wait_ns, 0);
+  }
+  mutex->m_prof_site = site;
+  mutex->m_prof_acquired = start;
+#if ENABLE_DEBUG
+  mutex->m_lock_file = site->file;
+  mutex->m_lock_line = site->line;
+#endif
+}
+
+/**
+ * Forget the sample of the current holder, which is about to release
+ * the mutex other than through mutex_unlock_profiled (waiting on a
+ * condition, say).  Called with the mutex held.
+ *
+ * @param mutex         Address of the mutex.
+ */
+static inline void lock_profile_drop(mutex_t *mutex) {
+  mutex->m_prof_site = NULL;
+}
+
+/**
+ * Release a mutex, accounting the hold time to the site that acquired
+ * it if that acquisition was sampled.
+ *
+ * @param mutex         Address of the mutex.
+ */
+static inline void mutex_unlock_profiled(mutex_t *mutex) {
+  lock_profile_site_t *site = mutex->m_prof_site;
+
+  if (UNLIKELY(NULL != site)) {
+    mutex->m_prof_site = NULL;
+    lock_profile_record(site->hold_hist, &site->hold_ns,
+                        lock_profile_now() - mutex->m_prof_acquired);
+  }
+  mutex_unlock(mutex);
+}
@@ -8,6 +8,8 @@
  * Functions for locking of critical sections.
  */
 
+#include "queue_lock.h"
+
 /**
  * Opaque mutex object
  */
@@ -15,6 +17,8 @@
 typedef struct mutex_t mutex_t;
 typedef struct mutex_t recursive_mutex_t;
 
+struct mutex_timed_waiter_t;
+
 struct mutex_t {
   object_t super;
   thread_internal_mutex_t m_lock;
@@ -22,10 +26,28 @@ struct mutex_t {
   int m_lock_debug;
   const char *m_lock_file;
   int m_lock_line;
+#endif
+#if THREADS_LOCK_PROFILE
+  /* call site of the current sampled acquisition, NULL if unsampled */
+  struct lock_profile_site_t *m_prof_site;
+  uint64_t m_prof_acquired;
 #endif
   atomic_lock_t m_lock_atomic;
+  /* MUTEX_ATOMIC_* kind of lock behind mutex_atomic_* */
+  int32_t m_atomic_kind;
+  queue_lock_t m_lock_queue;
+  /* callers of mutex_timedlock parked until an unlock, see timer_wheel.h */
+  atomic_lock_t m_timed_lock;
+  struct mutex_timed_waiter_t *volatile m_timed_head;
 };
 
+/* Test-and-set lock, the default */
+#define MUTEX_ATOMIC_TAS 0
+/* FIFO queue lock, waiters spin on their own cache line */
+#define MUTEX_ATOMIC_QUEUE 1
+/* Queue lock whose waiters yield to the backend after spinning */
+#define MUTEX_ATOMIC_QUEUE_YIELD 2
+
 DECLSPEC OBJ_CLASS_DECLARATION(mutex_t);
 DECLSPEC OBJ_CLASS_DECLARATION(recursive_mutex_t);
 
@@ -35,6 +57,8 @@ DECLSPEC OBJ_CLASS_DECLARATION(recursive_mutex_t);
     .super = OBJ_STATIC_INIT(mutex_t),                                         \
     .m_lock = THREAD_INTERNAL_MUTEX_INITIALIZER, .m_lock_debug = 0,            \
     .m_lock_file = NULL, .m_lock_line = 0, .m_lock_atomic = ATOMIC_LOCK_INIT,  \
+    .m_atomic_kind = MUTEX_ATOMIC_TAS, .m_lock_queue = QUEUE_LOCK_INIT,        \
+    .m_timed_lock = ATOMIC_LOCK_INIT, .m_timed_head = NULL,                    \
   }
 #else
 #define MUTEX_STATIC_INIT                                                      \
@@ -42,6 +66,8 @@ DECLSPEC OBJ_CLASS_DECLARATION(recursive_mutex_t);
     .super = OBJ_STATIC_INIT(mutex_t),                                         \
     .m_lock = THREAD_INTERNAL_MUTEX_INITIALIZER,                               \
     .m_lock_atomic = ATOMIC_LOCK_INIT,                                         \
+    .m_atomic_kind = MUTEX_ATOMIC_TAS, .m_lock_queue = QUEUE_LOCK_INIT,        \
+    .m_timed_lock = ATOMIC_LOCK_INIT, .m_timed_head = NULL,                    \
   }
 #endif
 
@@ -52,6 +78,8 @@ DECLSPEC OBJ_CLASS_DECLARATION(recursive_mutex_t);
     .super = OBJ_STATIC_INIT(mutex_t),                                         \
     .m_lock = THREAD_INTERNAL_RECURSIVE_MUTEX_INITIALIZER, .m_lock_debug = 0,  \
     .m_lock_file = NULL, .m_lock_line = 0, .m_lock_atomic = ATOMIC_LOCK_INIT,  \
+    .m_atomic_kind = MUTEX_ATOMIC_TAS, .m_lock_queue = QUEUE_LOCK_INIT,        \
+    .m_timed_lock = ATOMIC_LOCK_INIT, .m_timed_head = NULL,                    \
   }
 #else
 #define RECURSIVE_MUTEX_STATIC_INIT                                            \
@@ -59,6 +87,8 @@ DECLSPEC OBJ_CLASS_DECLARATION(recursive_mutex_t);
     .super = OBJ_STATIC_INIT(mutex_t),                                         \
     .m_lock = THREAD_INTERNAL_RECURSIVE_MUTEX_INITIALIZER,                     \
     .m_lock_atomic = ATOMIC_LOCK_INIT,                                         \
+    .m_atomic_kind = MUTEX_ATOMIC_TAS, .m_lock_queue = QUEUE_LOCK_INIT,        \
+    .m_timed_lock = ATOMIC_LOCK_INIT, .m_timed_head = NULL,                    \
   }
 #endif
 #endif /* THREAD_INTERNAL_RECURSIVE_MUTEX_INITIALIZER */
@@ -87,8 +117,53 @@ static inline void mutex_lock(mutex_t *mutex) {
  *
  * @param mutex         Address of the mutex.
  */
+/* Wake the first caller of mutex_timedlock parked on a mutex */
+DECLSPEC void mutex_timed_wake(mutex_t *mutex);
+
 static inline void mutex_unlock(mutex_t *mutex) {
   thread_internal_mutex_unlock(&mutex->m_lock);
+  /* orders the release before the check, against mutex_timedlock
+   * queueing before its last attempt */
+  atomic_mb();
+  if (UNLIKELY(NULL != mutex->m_timed_head)) {
+    mutex_timed_wake(mutex);
+  }
+}
+
+/**
+ * Choose how a mutex trades throughput for fairness.
+ *
+ * A fair mutex hands the lock over to a waiter on unlock, a throughput
+ * mutex lets the releasing thread reacquire it.  Mutexes that are never
+ * given a policy follow the backend default.  Backends without a
+ * handoff policy ignore this.
+ *
+ * @param mutex         Address of the mutex.
+ * @param fair          Whether to hand the lock over to waiters.
+ */
+static inline void mutex_set_fair(mutex_t *mutex, bool fair) {
+#if defined(THREAD_INTERNAL_MUTEX_HAS_FAIRNESS)
+  thread_internal_mutex_set_fair(&mutex->m_lock, fair);
+#else
+  (void)mutex;
+  (void)fair;
+#endif
+}
+
+/**
+ * Choose the lock behind the mutex_atomic_* functions of a mutex.
+ *
+ * The test-and-set lock is the cheapest uncontended, the queue locks
+ * hand the mutex over in FIFO order and keep each waiter spinning on
+ * its own cache line.  Must only be called while the mutex is unlocked.
+ *
+ * @param mutex         Address of the mutex.
+ * @param kind          MUTEX_ATOMIC_TAS, MUTEX_ATOMIC_QUEUE or
+ *                      MUTEX_ATOMIC_QUEUE_YIELD.
+ */
+static inline void mutex_atomic_set_kind(mutex_t *mutex, int kind) {
+  mutex->m_atomic_kind = kind;
+  queue_lock_init(&mutex->m_lock_queue, MUTEX_ATOMIC_QUEUE_YIELD == kind);
 }
 
 /**
@@ -98,6 +173,9 @@ static inline void mutex_unlock(mutex_t *mutex) {
  * @return              0 if the mutex was acquired, 1 otherwise.
  */
 static inline int mutex_atomic_trylock(mutex_t *mutex) {
+  if (MUTEX_ATOMIC_TAS != mutex->m_atomic_kind) {
+    return queue_lock_trylock(&mutex->m_lock_queue);
+  }
   return atomic_trylock(&mutex->m_lock_atomic);
 }
 
@@ -107,6 +185,10 @@ static inline int mutex_atomic_trylock(mutex_t *mutex) {
  * @param mutex         Address of the mutex.
  */
 static inline void mutex_atomic_lock(mutex_t *mutex) {
+  if (MUTEX_ATOMIC_TAS != mutex->m_atomic_kind) {
+    queue_lock_lock(&mutex->m_lock_queue);
+    return;
+  }
   atomic_lock(&mutex->m_lock_atomic);
 }
 
@@ -116,9 +198,17 @@ static inline void mutex_atomic_lock(mutex_t *mutex) {
  * @param mutex         Address of the mutex.
  */
 static inline void mutex_atomic_unlock(mutex_t *mutex) {
+  if (MUTEX_ATOMIC_TAS != mutex->m_atomic_kind) {
+    queue_lock_unlock(&mutex->m_lock_queue);
+    return;
+  }
   atomic_unlock(&mutex->m_lock_atomic);
 }
 
+#if THREADS_LOCK_PROFILE
+#include "lock_profile.h"
+#endif
+
 /**
  * Lock a mutex if using_threads() says that multiple threads may
  * be active in the process.
@@ -132,12 +222,22 @@ static inline void mutex_atomic_unlock(mutex_t *mutex) {
  * If there is no possibility that multiple threads are running in the
  * process, return immediately.
  */
+#if THREADS_LOCK_PROFILE
+#define THREAD_LOCK(mutex)                                                     \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      static lock_profile_site_t _lock_site = LOCK_PROFILE_SITE_INIT;          \
+      mutex_lock_profiled(mutex, &_lock_site);                                 \
+    }                                                                          \
+  } while (0)
+#else
 #define THREAD_LOCK(mutex)                                                     \
   do {                                                                         \
     if (UNLIKELY(using_threads())) {                                           \
       mutex_lock(mutex);                                                       \
     }                                                                          \
   } while (0)
+#endif
 
 /**
  * Try to lock a mutex if using_threads() says that multiple
@@ -170,12 +270,21 @@ static inline void mutex_atomic_unlock(mutex_t *mutex) {
  * If there is no possibility that multiple threads are running in the
  * process, return immediately without modifying the mutex.
  */
+#if THREADS_LOCK_PROFILE
+#define THREAD_UNLOCK(mutex)                                                   \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      mutex_unlock_profiled(mutex);                                            \
+    }                                                                          \
+  } while (0)
+#else
 #define THREAD_UNLOCK(mutex)                                                   \
   do {                                                                         \
     if (UNLIKELY(using_threads())) {                                           \
       mutex_unlock(mutex);                                                     \
     }                                                                          \
   } while (0)
+#endif
 
 /**
  * Lock a mutex if using_threads() says that multiple threads may
@@ -192,6 +301,19 @@ static inline void mutex_atomic_unlock(mutex_t *mutex) {
  * If there is no possibility that multiple threads are running in the
  * process, invoke the action without acquiring the lock.
  */
+#if THREADS_LOCK_PROFILE
+#define THREAD_SCOPED_LOCK(mutex, action)                                      \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      static lock_profile_site_t _lock_site = LOCK_PROFILE_SITE_INIT;          \
+      mutex_lock_profiled(mutex, &_lock_site);                                 \
+      action;                                                                  \
+      mutex_unlock_profiled(mutex);                                            \
+    } else {                                                                   \
+      action;                                                                  \
+    }                                                                          \
+  } while (0)
+#else
 #define THREAD_SCOPED_LOCK(mutex, action)                                      \
   do {                                                                         \
     if (UNLIKELY(using_threads())) {                                           \
@@ -202,11 +324,34 @@ static inline void mutex_atomic_unlock(mutex_t *mutex) {
       action;                                                                  \
     }                                                                          \
   } while (0)
+#endif
 
 typedef thread_internal_cond_t cond_t;
 #define CONDITION_STATIC_INIT THREAD_INTERNAL_COND_INITIALIZER
-int cond_init(cond_t *cond);
-int cond_wait(cond_t *cond, mutex_t *lock);
-int cond_broadcast(cond_t *cond);
-int cond_signal(cond_t *cond);
-int cond_destroy(cond_t *cond);
+
+static inline int cond_init(cond_t *cond) {
+  return thread_internal_cond_init(cond);
+}
+
+static inline int cond_wait(cond_t *cond, mutex_t *lock) {
+#if THREADS_LOCK_PROFILE
+  lock_profile_drop(lock);
+#endif
+  thread_internal_cond_wait(cond, &lock->m_lock);
+  return SUCCESS;
+}
+
+static inline int cond_broadcast(cond_t *cond) {
+  thread_internal_cond_broadcast(cond);
+  return SUCCESS;
+}
+
+static inline int cond_signal(cond_t *cond) {
+  thread_internal_cond_signal(cond);
+  return SUCCESS;
+}
+
+static inline int cond_destroy(cond_t *cond) {
+  thread_internal_cond_destroy(cond);
+  return SUCCESS;
+}
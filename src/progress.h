@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "mutex.h"
+
+/**
+ * @file
+ *
+ * Progress engine.
+ *
+ * Subsystems register the callbacks that make their operations advance,
+ * and progress() polls them.  Callbacks are kept in one list per
+ * priority; a list only grows, by chunks of PROGRESS_ENTRY_CHUNK
+ * entries, and an unregistered entry is recycled by a later
+ * registration of the same priority, so registering, unregistering and
+ * polling never take a lock.
+ *
+ * A pass of progress() polls the high and normal priority callbacks,
+ * and the low priority ones when nothing else completed anything or
+ * every PROGRESS_LOW_EVERY passes.  A callback polled every interval
+ * passes is skipped by the others, and a PROGRESS_ON_DEMAND callback is
+ * skipped while it has no outstanding work (see progress_entry_busy), in
+ * both cases after reading a single field.
+ *
+ * Calling a callback is not free of shared writes: the caller counts
+ * itself in and out of the entry's pe_running with two atomic
+ * read-modify-writes, so that progress_unregister can wait for the
+ * callers that are still inside.  Threads polling the same callbacks
+ * therefore bounce the entries' cache lines between them, at two atomics
+ * per callback per pass.  A per-thread epoch would avoid that, but a ULT
+ * may resume on another worker in the middle of a pass and thread local
+ * records cannot follow it.
+ *
+ * A wait sync bound to an entry (see wait_sync_set_progress) is waited
+ * for by polling that entry alone rather than every callback.
+ */
+
+#define PROGRESS_PRIORITY_HIGH 0
+#define PROGRESS_PRIORITY_NORMAL 1
+#define PROGRESS_PRIORITY_LOW 2
+#define PROGRESS_PRIORITIES 3
+
+/* Only polled while progress_entry_busy() calls are outstanding */
+#define PROGRESS_ON_DEMAND 0x1
+
+#define PROGRESS_ENTRY_CHUNK 16
+#define PROGRESS_LOW_EVERY 8
+
+#define PROGRESS_ENTRY_FREE 0
+#define PROGRESS_ENTRY_CLAIMED 1
+#define PROGRESS_ENTRY_LIVE 2
+
+/* Returns the number of events completed */
+typedef int (*progress_callback_t)(void);
+
+typedef struct progress_entry_t {
+  atomic_int32_t pe_state;
+  int32_t pe_priority;
+  int32_t pe_interval;
+  int32_t pe_flags;
+  progress_callback_t pe_callback;
+  struct progress_entry_t *pe_next;
+  /* outstanding work of an on-demand callback */
+  atomic_int32_t pe_busy;
+  /* threads inside the callback, two atomics per call */
+  atomic_int32_t pe_running;
+} __attribute__((aligned(64))) progress_entry_t;
+
+typedef struct progress_chunk_t {
+  progress_entry_t entries[PROGRESS_ENTRY_CHUNK];
+} progress_chunk_t;
+
+/**
+ * Register a progress callback.
+ *
+ * @param callback      Function to poll; it may be called by several
+ *                      threads at once.
+ * @param priority      PROGRESS_PRIORITY_HIGH, _NORMAL or _LOW.
+ * @param interval      Poll it every interval passes, 1 for each pass.
+ * @param flags         0 or PROGRESS_ON_DEMAND.
+ * @param entry         Set to the registration, for unregistering it or
+ *                      binding wait syncs to it.
+ *
+ * @retval SUCCESS              Callback registered
+ * @retval ERR_BAD_PARAM        No callback or no such priority
+ * @retval ERR_OUT_OF_RESOURCE  No memory for the entry
+ */
+DECLSPEC int progress_register(progress_callback_t callback, int priority,
+                               int interval, int flags,
+                               progress_entry_t **entry);
+
+/**
+ * Unregister a progress callback.  Once this returns the callback is no
+ * longer running in any thread, except in the caller if it unregisters
+ * itself; without thread local storage (HAVE_THREAD_LOCAL) a callback
+ * must not unregister itself.
+ *
+ * @retval SUCCESS              Callback unregistered
+ * @retval ERR_NOT_FOUND        The entry is not registered
+ */
+DECLSPEC int progress_unregister(progress_entry_t *entry);
+
+/**
+ * Poll the registered callbacks once.
+ *
+ * @return              Number of events completed.
+ */
+DECLSPEC int progress(void);
+
+/**
+ * Poll a single callback, whatever its interval and work.
+ *
+ * @return              Number of events completed.
+ */
+DECLSPEC int progress_entry_run(progress_entry_t *entry);
+
+/**
+ * Tell an on-demand callback it has work to poll for, until the
+ * matching progress_entry_idle().
+ */
+static inline void progress_entry_busy(progress_entry_t *entry) {
+  atomic_fetch_add_32(&entry->pe_busy, 1);
+}
+
+static inline void progress_entry_idle(progress_entry_t *entry) {
+  atomic_fetch_add_32(&entry->pe_busy, -1);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file
+ *
+ * Queue spinlock.
+ *
+ * An MCS lock in its K42 form: waiters queue up in FIFO order and each
+ * one spins on a node of its own, so a handoff only touches the cache
+ * line of the next waiter.  The lock embeds the node that stands for
+ * its holder and waiters only need theirs, on their stack, until they
+ * own the lock, so lock and unlock take no node argument and the lock
+ * can replace atomic_lock_t as is.
+ *
+ * In yield mode a waiter spins for QUEUE_LOCK_SPIN rounds and then
+ * yields to the backend scheduler between checks, which lets the ULT
+ * that holds the lock run on the same OS thread.
+ */
+
+/* Rounds a waiter spins before it starts yielding, in yield mode */
+#define QUEUE_LOCK_SPIN 128
+
+typedef struct queue_lock_node_t {
+  struct queue_lock_node_t *volatile next;
+  volatile int32_t waiting;
+} queue_lock_node_t;
+
+typedef struct queue_lock_t {
+  /* last node of the queue, NULL when the lock is free */
+  atomic_intptr_t tail;
+  /* node of the holder, its next is the first waiter */
+  queue_lock_node_t holder;
+  /* whether waiters yield after spinning */
+  int32_t yield;
+} queue_lock_t;
+
+#define QUEUE_LOCK_INIT                                                        \
+  { .tail = 0, .holder = {.next = NULL, .waiting = 0}, .yield = 0 }
+
+DECLSPEC void queue_lock_wait(queue_lock_t *lock);
+DECLSPEC void queue_lock_handoff(queue_lock_t *lock);
+
+static inline void queue_lock_init(queue_lock_t *lock, bool yield) {
+  lock->tail = 0;
+  lock->holder.next = NULL;
+  lock->holder.waiting = 0;
+  lock->yield = yield;
+}
+
+/**
+ * Try to acquire a queue lock.
+ *
+ * @return              0 if the lock was acquired, 1 otherwise.
+ */
+static inline int queue_lock_trylock(queue_lock_t *lock) {
+  intptr_t free_tail = 0;
+  return atomic_compare_exchange_strong_ptr(&lock->tail, &free_tail,
+                                            (intptr_t)&lock->holder)
+             ? 0
+             : 1;
+}
+
+static inline void queue_lock_lock(queue_lock_t *lock) {
+  if (UNLIKELY(0 != queue_lock_trylock(lock))) {
+    queue_lock_wait(lock);
+  }
+}
+
+static inline void queue_lock_unlock(queue_lock_t *lock) {
+  intptr_t holder = (intptr_t)&lock->holder;
+
+  if (LIKELY(NULL == lock->holder.next) &&
+      atomic_compare_exchange_strong_ptr(&lock->tail, &holder, 0)) {
+    return;
+  }
+  queue_lock_handoff(lock);
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <sched.h>
+#include <stdint.h>
+
+#include "mutex.h"
+
+/**
+ * @file
+ *
+ * Reader-writer lock.
+ *
+ * Readers announce themselves in one of RWLOCK_READER_SLOTS counters,
+ * each on its own cache line and picked by the core the reader runs on,
+ * so that readers on different cores never write the same line.  A
+ * reader that finds no writer is done after a single atomic increment
+ * of its core's counter.
+ *
+ * Writers are serialized by a mutex_t, raise a flag that sends new
+ * readers to a slow path, and wait for the sum of the counters to drop
+ * to zero, first yielding and then blocked.  A reader may leave on
+ * another core than it entered on: the counters only balance out as a
+ * sum, which is all the writer looks at.
+ *
+ * Starvation is bounded both ways: a pending writer holds back new
+ * readers, so it only waits for the readers already inside, and the
+ * readers held back by a writer all get in before the next writer
+ * raises its flag.
+ *
+ * Everything blocks through the backend primitives, so the lock works
+ * the same on every backend.
+ */
+
+#ifndef RWLOCK_READER_SLOTS
+#define RWLOCK_READER_SLOTS 32
+#endif
+
+typedef struct {
+  atomic_int64_t count;
+} __attribute__((aligned(64))) rwlock_slot_t;
+
+typedef struct rwlock_t {
+  object_t super;
+  /* reader counters, only meaningful as a sum */
+  rwlock_slot_t rw_slots[RWLOCK_READER_SLOTS];
+  /* a writer holds or waits for the lock, new readers stay out */
+  atomic_int32_t rw_writer;
+  /* the writer is blocked until the readers drain */
+  atomic_int32_t rw_writer_parked;
+  /* serializes writers */
+  mutex_t rw_wmutex;
+  /* protects the fields below and the blocking of both sides */
+  thread_internal_mutex_t rw_lock;
+  thread_internal_cond_t rw_readers_cond;
+  thread_internal_cond_t rw_writer_cond;
+  /* readers held back by the current writer */
+  int32_t rw_readers_waiting;
+} rwlock_t;
+
+DECLSPEC OBJ_CLASS_DECLARATION(rwlock_t);
+
+#define RWLOCK_STATIC_INIT                                                     \
+  {                                                                            \
+    .super = OBJ_STATIC_INIT(rwlock_t), .rw_writer = 0,                        \
+    .rw_writer_parked = 0, .rw_wmutex = MUTEX_STATIC_INIT,                     \
+    .rw_lock = THREAD_INTERNAL_MUTEX_INITIALIZER,                              \
+    .rw_readers_cond = THREAD_INTERNAL_COND_INITIALIZER,                       \
+    .rw_writer_cond = THREAD_INTERNAL_COND_INITIALIZER,                        \
+    .rw_readers_waiting = 0,                                                   \
+  }
+
+DECLSPEC void rwlock_rdlock_slow(rwlock_t *rw, int slot);
+DECLSPEC void rwlock_wake_writer(rwlock_t *rw);
+DECLSPEC void rwlock_wrlock(rwlock_t *rw);
+DECLSPEC int rwlock_trywrlock(rwlock_t *rw);
+DECLSPEC void rwlock_wrunlock(rwlock_t *rw);
+
+/* Counter of the core the caller runs on */
+static inline int rwlock_reader_slot(void) {
+#if defined(__linux__) && defined(__USE_GNU)
+  int cpu = sched_getcpu();
+  return cpu < 0 ? 0 : cpu & (RWLOCK_READER_SLOTS - 1);
+#elif HAVE_THREAD_LOCAL
+  /* without the core, spread the OS threads over the counters */
+  static atomic_int32_t next = 0;
+  static thread_local int slot = -1;
+  if (UNLIKELY(slot < 0)) {
+    slot = atomic_fetch_add_32(&next, 1) & (RWLOCK_READER_SLOTS - 1);
+  }
+  return slot;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Acquire a reader-writer lock for reading.
+ *
+ * @param rw            Address of the lock.
+ */
+static inline void rwlock_rdlock(rwlock_t *rw) {
+  int slot = rwlock_reader_slot();
+
+  atomic_fetch_add_64(&rw->rw_slots[slot].count, 1);
+  if (UNLIKELY(0 != rw->rw_writer)) {
+    rwlock_rdlock_slow(rw, slot);
+  }
+}
+
+/**
+ * Try to acquire a reader-writer lock for reading.
+ *
+ * @param rw            Address of the lock.
+ * @return              0 if the lock was acquired, 1 otherwise.
+ */
+static inline int rwlock_tryrdlock(rwlock_t *rw) {
+  int slot = rwlock_reader_slot();
+
+  atomic_fetch_add_64(&rw->rw_slots[slot].count, 1);
+  if (LIKELY(0 == rw->rw_writer)) {
+    return 0;
+  }
+  atomic_fetch_add_64(&rw->rw_slots[slot].count, -1);
+  if (UNLIKELY(0 != rw->rw_writer_parked)) {
+    rwlock_wake_writer(rw);
+  }
+  return 1;
+}
+
+/**
+ * Release a reader-writer lock held for reading.
+ *
+ * @param rw            Address of the lock.
+ */
+static inline void rwlock_rdunlock(rwlock_t *rw) {
+  atomic_fetch_add_64(&rw->rw_slots[rwlock_reader_slot()].count, -1);
+  if (UNLIKELY(0 != rw->rw_writer_parked)) {
+    rwlock_wake_writer(rw);
+  }
+}
+
+/**
+ * Lock a reader-writer lock for reading if using_threads() says that
+ * multiple threads may be active in the process.
+ *
+ * @param rw Pointer to a rwlock_t to lock.
+ */
+#define THREAD_RDLOCK(rw)                                                      \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      rwlock_rdlock(rw);                                                       \
+    }                                                                          \
+  } while (0)
+
+/**
+ * Unlock a reader-writer lock held for reading if using_threads()
+ * says that multiple threads may be active in the process.
+ *
+ * @param rw Pointer to a rwlock_t to unlock.
+ */
+#define THREAD_RDUNLOCK(rw)                                                    \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      rwlock_rdunlock(rw);                                                     \
+    }                                                                          \
+  } while (0)
+
+/**
+ * Lock a reader-writer lock for writing if using_threads() says that
+ * multiple threads may be active in the process.
+ *
+ * @param rw Pointer to a rwlock_t to lock.
+ */
+#define THREAD_WRLOCK(rw)                                                      \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      rwlock_wrlock(rw);                                                       \
+    }                                                                          \
+  } while (0)
+
+/**
+ * Unlock a reader-writer lock held for writing if using_threads()
+ * says that multiple threads may be active in the process.
+ *
+ * @param rw Pointer to a rwlock_t to unlock.
+ */
+#define THREAD_WRUNLOCK(rw)                                                    \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      rwlock_wrunlock(rw);                                                     \
+    }                                                                          \
+  } while (0)
+
+/**
+ * Hold a reader-writer lock for reading for the duration of the
+ * specified action, if using_threads() says that multiple threads may
+ * be active in the process.
+ *
+ * @param rw       Pointer to a rwlock_t to lock.
+ * @param action   A scope over which the lock is held.
+ */
+#define THREAD_SCOPED_RDLOCK(rw, action)                                       \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      rwlock_rdlock(rw);                                                       \
+      action;                                                                  \
+      rwlock_rdunlock(rw);                                                     \
+    } else {                                                                   \
+      action;                                                                  \
+    }                                                                          \
+  } while (0)
+
+/**
+ * Hold a reader-writer lock for writing for the duration of the
+ * specified action, if using_threads() says that multiple threads may
+ * be active in the process.
+ *
+ * @param rw       Pointer to a rwlock_t to lock.
+ * @param action   A scope over which the lock is held.
+ */
+#define THREAD_SCOPED_WRLOCK(rw, action)                                       \
+  do {                                                                         \
+    if (UNLIKELY(using_threads())) {                                           \
+      rwlock_wrlock(rw);                                                       \
+      action;                                                                  \
+      rwlock_wrunlock(rw);                                                     \
+    } else {                                                                   \
+      action;                                                                  \
+    }                                                                          \
+  } while (0)
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "mutex.h"
+
+/**
+ * @file
+ *
+ * Counting semaphore and countdown latch.
+ *
+ * The semaphore count goes below zero by the number of waiters, so an
+ * uncontended wait or post is a single atomic add.  A post that finds
+ * waiters hands one of them a wakeup token; the waiter polls for it and
+ * then blocks on the semaphore's condition, through the backend
+ * primitives.
+ *
+ * A latch releases its waiters once it has been counted down to zero.
+ * Counting down is a single atomic add, and only the last count down
+ * looks at whether anybody blocked.  A waiter sets LATCH_PARKED in the
+ * count word before it blocks, and does not return before the last
+ * count down acknowledged it with LATCH_SIGNALED, so that the latch can
+ * be released as soon as its waiters returned.
+ */
+
+typedef struct semaphore_t {
+  object_t super;
+  /* available units, minus the waiters when negative */
+  atomic_int32_t s_count;
+  /* wakeups posted and not consumed yet, under s_lock */
+  atomic_int32_t s_wakeups;
+  /* waiters blocked on s_cond, under s_lock */
+  int32_t s_parked;
+  thread_internal_mutex_t s_lock;
+  thread_internal_cond_t s_cond;
+} semaphore_t;
+
+DECLSPEC OBJ_CLASS_DECLARATION(semaphore_t);
+
+#define SEMAPHORE_STATIC_INIT(count)                                           \
+  {                                                                            \
+    .super = OBJ_STATIC_INIT(semaphore_t), .s_count = (count),                 \
+    .s_wakeups = 0, .s_parked = 0,                                             \
+    .s_lock = THREAD_INTERNAL_MUTEX_INITIALIZER,                               \
+    .s_cond = THREAD_INTERNAL_COND_INITIALIZER,                                \
+  }
+
+typedef struct latch_t {
+  object_t super;
+  /* count downs left, and the LATCH_PARKED/SIGNALED flags */
+  atomic_int32_t l_count;
+  thread_internal_mutex_t l_lock;
+  thread_internal_cond_t l_cond;
+} latch_t;
+
+DECLSPEC OBJ_CLASS_DECLARATION(latch_t);
+
+#define LATCH_SIGNALED (1 << 29)
+#define LATCH_PARKED (1 << 30)
+#define LATCH_COUNT_MASK (LATCH_SIGNALED - 1)
+
+#define LATCH_STATIC_INIT(count)                                               \
+  {                                                                            \
+    .super = OBJ_STATIC_INIT(latch_t), .l_count = (count),                     \
+    .l_lock = THREAD_INTERNAL_MUTEX_INITIALIZER,                               \
+    .l_cond = THREAD_INTERNAL_COND_INITIALIZER,                                \
+  }
+
+DECLSPEC void semaphore_wait_slow(semaphore_t *sem);
+DECLSPEC void semaphore_post_slow(semaphore_t *sem);
+DECLSPEC void latch_wait_slow(latch_t *latch);
+DECLSPEC void latch_release(latch_t *latch);
+
+/**
+ * Set the count of a semaphore nobody uses yet.
+ *
+ * @param sem           Address of the semaphore.
+ * @param count         Units available, at least 0.
+ */
+static inline void semaphore_set(semaphore_t *sem, int32_t count) {
+  sem->s_count = count;
+}
+
+/**
+ * Take a unit from a semaphore, waiting for one to be posted if none is
+ * available.
+ *
+ * @param sem           Address of the semaphore.
+ */
+static inline void semaphore_wait(semaphore_t *sem) {
+  if (UNLIKELY(atomic_fetch_add_32(&sem->s_count, -1) <= 0)) {
+    semaphore_wait_slow(sem);
+  }
+}
+
+/**
+ * Take a unit from a semaphore if one is available.
+ *
+ * @param sem           Address of the semaphore.
+ * @return              0 if a unit was taken, 1 otherwise.
+ */
+static inline int semaphore_trywait(semaphore_t *sem) {
+  int32_t count = sem->s_count;
+
+  while (count > 0) {
+    if (atomic_compare_exchange_strong_32(&sem->s_count, &count, count - 1)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Return a unit to a semaphore, waking up a waiter if there is one.
+ *
+ * @param sem           Address of the semaphore.
+ */
+static inline void semaphore_post(semaphore_t *sem) {
+  if (UNLIKELY(atomic_fetch_add_32(&sem->s_count, 1) < 0)) {
+    semaphore_post_slow(sem);
+  }
+}
+
+/**
+ * Set the count of a latch nobody uses yet.
+ *
+ * @param latch         Address of the latch.
+ * @param count         Count downs before the latch opens.
+ */
+static inline void latch_set(latch_t *latch, int32_t count) {
+  latch->l_count = count;
+}
+
+/**
+ * Count a latch down, releasing its waiters when it reaches zero.
+ *
+ * @param latch         Address of the latch.
+ * @param n             Amount to count down by.
+ */
+static inline void latch_count_down(latch_t *latch, int32_t n) {
+  /* the last count down owes a wakeup if somebody parked */
+  if (UNLIKELY(LATCH_PARKED == atomic_add_fetch_32(&latch->l_count, -n))) {
+    latch_release(latch);
+  }
+}
+
+/**
+ * Check whether a latch is open, without waiting.
+ *
+ * @param latch         Address of the latch.
+ * @return              true once the latch reached zero.
+ */
+static inline bool latch_try_wait(latch_t *latch) {
+  if (0 == (latch->l_count & LATCH_COUNT_MASK)) {
+    atomic_rmb();
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Wait until a latch is counted down to zero.
+ *
+ * @param latch         Address of the latch.
+ */
+static inline void latch_wait(latch_t *latch) {
+  if (UNLIKELY(!latch_try_wait(latch))) {
+    latch_wait_slow(latch);
+  }
+}
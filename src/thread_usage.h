@@ -31,7 +31,29 @@
  * possibility that we may have multiple threads, true will be
  * returned.
  */
-#define using_threads() uses_threads
+#if THREADS_MODE_THREADED
+#define using_threads() true
+#elif THREADS_MODE_SINGLE
+#define using_threads() false
+#else
+#define using_threads() uses_threads.value
+#endif
+
+/*
+ * Set once at startup and read by every lock and atomic below, see
+ * mutex.c.  Builds committed to a mode at configure time
+ * (LIBULT_THREAD_MODE, which defines THREADS_MODE_THREADED or
+ * THREADS_MODE_SINGLE) never read it, so the checks fold away.
+ *
+ * Padded to a whole cache line, so that no other variable the linker
+ * places next to it shares the line.
+ */
+typedef struct {
+  bool value;
+  char padding[63];
+} __attribute__((aligned(64))) thread_usage_flag_t;
+
+DECLSPEC extern thread_usage_flag_t uses_threads;
 
 /**
  * Set whether the process is using multiple threads or not.
@@ -47,10 +69,13 @@
  * support, the return value of future invocations of
  * using_threads() will be the parameter's value.  If configure
  * detected that we have no thread support, then the return from
- * using_threads() will always be false.
+ * using_threads() will always be false.  In a build committed to a
+ * mode, have is ignored and the mode is returned.
  */
 static inline bool set_using_threads(bool have) {
-  uses_threads = have;
+#if !THREADS_MODE_THREADED && !THREADS_MODE_SINGLE
+  uses_threads.value = have;
+#endif
   return using_threads();
 }
 
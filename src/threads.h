@@ -15,6 +15,9 @@ struct thread_t {
   thread_fn_t t_run;
   void *t_arg;
   pthread_t t_handle;
+  /* completion slot when run by a pooled worker, or the native ULT
+   * running it, NULL otherwise */
+  void *t_pool_slot;
 };
 
 typedef struct thread_t thread_t;
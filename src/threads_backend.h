@@ -0,0 +1,214 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @file
+ *
+ * Run-time backend selection.
+ *
+ * A build with a single backend maps thread_internal_mutex_t and friends
+ * straight onto the backend through MCA_threads_base_include_HEADER, so
+ * every operation inlines.  A build with several backends
+ * (THREADS_MULTI_BACKEND) includes this header instead: the internal
+ * types become opaque storage large enough for any compiled-in backend,
+ * and every operation goes through the threads_backend_ops_t of the
+ * backend picked at startup from the LIBULT_THREADS_BACKEND environment
+ * variable (or threads_backend_select()).
+ */
+
+struct thread_t;
+
+typedef struct threads_backend_ops_t {
+  const char *name;
+  /* whether idle waiters should yield, see THREAD_YIELD_WHEN_IDLE_DEFAULT */
+  bool yield_when_idle;
+
+  int (*mutex_init)(void *p_mutex, bool recursive);
+  void (*mutex_lock)(void *p_mutex);
+  int (*mutex_trylock)(void *p_mutex);
+  void (*mutex_unlock)(void *p_mutex);
+  void (*mutex_destroy)(void *p_mutex);
+
+  int (*cond_init)(void *p_cond);
+  void (*cond_wait)(void *p_cond, void *p_mutex);
+  int (*cond_timedwait)(void *p_cond, void *p_mutex,
+                        const struct timespec *abstime);
+  void (*cond_broadcast)(void *p_cond);
+  void (*cond_signal)(void *p_cond);
+  void (*cond_destroy)(void *p_cond);
+
+  int (*tsd_key_create)(uintptr_t *key, void (*destructor)(void *));
+  int (*tsd_key_delete)(uintptr_t key);
+  int (*tsd_set)(uintptr_t key, void *value);
+  int (*tsd_get)(uintptr_t key, void **valuep);
+
+  void (*yield)(void);
+
+  /* thread_start/thread_join/thread_self_compare, NULL for a plain
+   * pthread_create/pthread_join, see create_join.c */
+  int (*thread_start)(struct thread_t *t);
+  int (*thread_join)(struct thread_t *t, void **thr_return);
+  bool (*thread_self_compare)(struct thread_t *t);
+} threads_backend_ops_t;
+
+/* Storage reserved for a backend mutex or condition variable. Each
+ * backend checks at compile time that its own types fit. */
+#define THREADS_BACKEND_MUTEX_SIZE 64
+#define THREADS_BACKEND_COND_SIZE 64
+
+/* Ops table of the selected backend */
+DECLSPEC extern const threads_backend_ops_t *threads_backend;
+
+/**
+ * Select the backend by name ("pthreads", "qthreads", "argobots",
+ * "native").
+ *
+ * Must be called before any libult object is used; the default is
+ * taken from LIBULT_THREADS_BACKEND, or the first compiled-in backend.
+ *
+ * @retval SUCCESS        Backend selected
+ * @retval ERR_NOT_FOUND  Backend not compiled in
+ */
+DECLSPEC int threads_backend_select(const char *name);
+
+/* The backend ops TUs define THREADS_BACKEND_IMPL to see their own
+ * types instead of the opaque ones below. */
+#if THREADS_MULTI_BACKEND && !defined(THREADS_BACKEND_IMPL)
+
+/* Lazily initialized so that the static initializers need not know the
+ * backend: 0 is the static state, THREADS_BACKEND_READY once the
+ * backend object has been set up. */
+#define THREADS_BACKEND_READY 2
+
+typedef struct {
+  atomic_int32_t m_init;
+  int32_t m_recursive;
+  union {
+    char bytes[THREADS_BACKEND_MUTEX_SIZE];
+    uint64_t align;
+  } m_storage;
+} thread_internal_mutex_t;
+
+#define THREAD_INTERNAL_MUTEX_INITIALIZER                                      \
+  { .m_init = 0, .m_recursive = 0 }
+#define THREAD_INTERNAL_RECURSIVE_MUTEX_INITIALIZER                            \
+  { .m_init = 0, .m_recursive = 1 }
+
+typedef struct {
+  atomic_int32_t c_init;
+  union {
+    char bytes[THREADS_BACKEND_COND_SIZE];
+    uint64_t align;
+  } c_storage;
+} thread_internal_cond_t;
+
+#define THREAD_INTERNAL_COND_INITIALIZER                                       \
+  { .c_init = 0 }
+
+typedef uintptr_t tsd_key_t;
+
+#define THREAD_YIELD_WHEN_IDLE_DEFAULT (threads_backend->yield_when_idle)
+
+DECLSPEC void threads_backend_mutex_ensure_init(thread_internal_mutex_t *p_mutex);
+DECLSPEC void threads_backend_cond_ensure_init(thread_internal_cond_t *p_cond);
+
+static inline int thread_internal_mutex_init(thread_internal_mutex_t *p_mutex,
+                                             bool recursive) {
+  int ret = threads_backend->mutex_init(&p_mutex->m_storage, recursive);
+  p_mutex->m_recursive = recursive;
+  p_mutex->m_init = THREADS_BACKEND_READY;
+  return ret;
+}
+
+static inline void
+thread_internal_mutex_lock(thread_internal_mutex_t *p_mutex) {
+  if (UNLIKELY(THREADS_BACKEND_READY != p_mutex->m_init)) {
+    threads_backend_mutex_ensure_init(p_mutex);
+  }
+  threads_backend->mutex_lock(&p_mutex->m_storage);
+}
+
+static inline int
+thread_internal_mutex_trylock(thread_internal_mutex_t *p_mutex) {
+  if (UNLIKELY(THREADS_BACKEND_READY != p_mutex->m_init)) {
+    threads_backend_mutex_ensure_init(p_mutex);
+  }
+  return threads_backend->mutex_trylock(&p_mutex->m_storage);
+}
+
+static inline void
+thread_internal_mutex_unlock(thread_internal_mutex_t *p_mutex) {
+  threads_backend->mutex_unlock(&p_mutex->m_storage);
+}
+
+static inline void
+thread_internal_mutex_destroy(thread_internal_mutex_t *p_mutex) {
+  if (THREADS_BACKEND_READY == p_mutex->m_init) {
+    threads_backend->mutex_destroy(&p_mutex->m_storage);
+  }
+}
+
+static inline int thread_internal_cond_init(thread_internal_cond_t *p_cond) {
+  int ret = threads_backend->cond_init(&p_cond->c_storage);
+  p_cond->c_init = THREADS_BACKEND_READY;
+  return ret;
+}
+
+static inline void thread_internal_cond_wait(thread_internal_cond_t *p_cond,
+                                             thread_internal_mutex_t *p_mutex) {
+  if (UNLIKELY(THREADS_BACKEND_READY != p_cond->c_init)) {
+    threads_backend_cond_ensure_init(p_cond);
+  }
+  threads_backend->cond_wait(&p_cond->c_storage, &p_mutex->m_storage);
+}
+
+static inline int
+thread_internal_cond_timedwait(thread_internal_cond_t *p_cond,
+                               thread_internal_mutex_t *p_mutex,
+                               const struct timespec *abstime) {
+  if (UNLIKELY(THREADS_BACKEND_READY != p_cond->c_init)) {
+    threads_backend_cond_ensure_init(p_cond);
+  }
+  return threads_backend->cond_timedwait(&p_cond->c_storage,
+                                         &p_mutex->m_storage, abstime);
+}
+
+static inline void
+thread_internal_cond_broadcast(thread_internal_cond_t *p_cond) {
+  /* Nobody can be waiting on a condition that was never initialized */
+  if (THREADS_BACKEND_READY == p_cond->c_init) {
+    threads_backend->cond_broadcast(&p_cond->c_storage);
+  }
+}
+
+static inline void thread_internal_cond_signal(thread_internal_cond_t *p_cond) {
+  if (THREADS_BACKEND_READY == p_cond->c_init) {
+    threads_backend->cond_signal(&p_cond->c_storage);
+  }
+}
+
+static inline void
+thread_internal_cond_destroy(thread_internal_cond_t *p_cond) {
+  if (THREADS_BACKEND_READY == p_cond->c_init) {
+    threads_backend->cond_destroy(&p_cond->c_storage);
+  }
+}
+
+static inline int tsd_key_delete(tsd_key_t key) {
+  return threads_backend->tsd_key_delete(key);
+}
+
+static inline int tsd_set(tsd_key_t key, void *value) {
+  return threads_backend->tsd_set(key, value);
+}
+
+static inline int tsd_get(tsd_key_t key, void **valuep) {
+  return threads_backend->tsd_get(key, valuep);
+}
+
+static inline void thread_yield(void) { threads_backend->yield(); }
+
+#endif /* THREADS_MULTI_BACKEND */
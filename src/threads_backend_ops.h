@@ -0,0 +1,127 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * Ops table of one backend for run-time backend selection, see
+ * threads_backend.h.
+ *
+ * Included once by each backend's threads_<backend>_ops.c, after the
+ * backend's own mutex and tsd headers, with
+ *   THREADS_BACKEND_OPS         name of the threads_backend_ops_t to define
+ *   THREADS_BACKEND_OPS_NAME    backend name for LIBULT_THREADS_BACKEND
+ *   THREADS_BACKEND_OPS_YIELD_WHEN_IDLE
+ * and static functions threads_backend_ops_key_create() and
+ * threads_backend_ops_yield() defined.  A backend running thread_t on
+ * threads of its own also defines THREADS_BACKEND_OPS_THREAD_START,
+ * THREADS_BACKEND_OPS_THREAD_JOIN and, if a plain pthread_self()
+ * comparison does not do, THREADS_BACKEND_OPS_THREAD_SELF_COMPARE.
+ */
+
+#ifndef THREADS_BACKEND_OPS_THREAD_START
+#define THREADS_BACKEND_OPS_THREAD_START NULL
+#define THREADS_BACKEND_OPS_THREAD_JOIN NULL
+#endif
+#ifndef THREADS_BACKEND_OPS_THREAD_SELF_COMPARE
+#define THREADS_BACKEND_OPS_THREAD_SELF_COMPARE NULL
+#endif
+
+_Static_assert(sizeof(thread_internal_mutex_t) <= THREADS_BACKEND_MUTEX_SIZE,
+               "backend mutex does not fit THREADS_BACKEND_MUTEX_SIZE");
+_Static_assert(sizeof(thread_internal_cond_t) <= THREADS_BACKEND_COND_SIZE,
+               "backend condition does not fit THREADS_BACKEND_COND_SIZE");
+_Static_assert(sizeof(tsd_key_t) <= sizeof(uintptr_t),
+               "backend tsd key does not fit uintptr_t");
+
+static int threads_backend_ops_mutex_init(void *p_mutex, bool recursive) {
+  return thread_internal_mutex_init((thread_internal_mutex_t *)p_mutex,
+                                    recursive);
+}
+
+static void threads_backend_ops_mutex_lock(void *p_mutex) {
+  thread_internal_mutex_lock((thread_internal_mutex_t *)p_mutex);
+}
+
+static int threads_backend_ops_mutex_trylock(void *p_mutex) {
+  return thread_internal_mutex_trylock((thread_internal_mutex_t *)p_mutex);
+}
+
+static void threads_backend_ops_mutex_unlock(void *p_mutex) {
+  thread_internal_mutex_unlock((thread_internal_mutex_t *)p_mutex);
+}
+
+static void threads_backend_ops_mutex_destroy(void *p_mutex) {
+  thread_internal_mutex_destroy((thread_internal_mutex_t *)p_mutex);
+}
+
+static int threads_backend_ops_cond_init(void *p_cond) {
+  return thread_internal_cond_init((thread_internal_cond_t *)p_cond);
+}
+
+static void threads_backend_ops_cond_wait(void *p_cond, void *p_mutex) {
+  thread_internal_cond_wait((thread_internal_cond_t *)p_cond,
+                            (thread_internal_mutex_t *)p_mutex);
+}
+
+static int threads_backend_ops_cond_timedwait(void *p_cond, void *p_mutex,
+                                              const struct timespec *abstime) {
+  return thread_internal_cond_timedwait((thread_internal_cond_t *)p_cond,
+                                        (thread_internal_mutex_t *)p_mutex,
+                                        abstime);
+}
+
+static void threads_backend_ops_cond_broadcast(void *p_cond) {
+  thread_internal_cond_broadcast((thread_internal_cond_t *)p_cond);
+}
+
+static void threads_backend_ops_cond_signal(void *p_cond) {
+  thread_internal_cond_signal((thread_internal_cond_t *)p_cond);
+}
+
+static void threads_backend_ops_cond_destroy(void *p_cond) {
+  thread_internal_cond_destroy((thread_internal_cond_t *)p_cond);
+}
+
+static int threads_backend_ops_tsd_key_create(uintptr_t *key,
+                                              void (*destructor)(void *)) {
+  tsd_key_t k;
+  int rc = threads_backend_ops_key_create(&k, destructor);
+  *key = (uintptr_t)k;
+  return rc;
+}
+
+static int threads_backend_ops_tsd_key_delete(uintptr_t key) {
+  return tsd_key_delete((tsd_key_t)key);
+}
+
+static int threads_backend_ops_tsd_set(uintptr_t key, void *value) {
+  return tsd_set((tsd_key_t)key, value);
+}
+
+static int threads_backend_ops_tsd_get(uintptr_t key, void **valuep) {
+  return tsd_get((tsd_key_t)key, valuep);
+}
+
+const threads_backend_ops_t THREADS_BACKEND_OPS = {
+    .name = THREADS_BACKEND_OPS_NAME,
+    .yield_when_idle = THREADS_BACKEND_OPS_YIELD_WHEN_IDLE,
+    .mutex_init = threads_backend_ops_mutex_init,
+    .mutex_lock = threads_backend_ops_mutex_lock,
+    .mutex_trylock = threads_backend_ops_mutex_trylock,
+    .mutex_unlock = threads_backend_ops_mutex_unlock,
+    .mutex_destroy = threads_backend_ops_mutex_destroy,
+    .cond_init = threads_backend_ops_cond_init,
+    .cond_wait = threads_backend_ops_cond_wait,
+    .cond_timedwait = threads_backend_ops_cond_timedwait,
+    .cond_broadcast = threads_backend_ops_cond_broadcast,
+    .cond_signal = threads_backend_ops_cond_signal,
+    .cond_destroy = threads_backend_ops_cond_destroy,
+    .tsd_key_create = threads_backend_ops_tsd_key_create,
+    .tsd_key_delete = threads_backend_ops_tsd_key_delete,
+    .tsd_set = threads_backend_ops_tsd_set,
+    .tsd_get = threads_backend_ops_tsd_get,
+    .yield = threads_backend_ops_yield,
+    .thread_start = THREADS_BACKEND_OPS_THREAD_START,
+    .thread_join = THREADS_BACKEND_OPS_THREAD_JOIN,
+    .thread_self_compare = THREADS_BACKEND_OPS_THREAD_SELF_COMPARE,
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include "mutex.h"
+
+/**
+ * @file
+ *
+ * Timer wheel shared by all backends.
+ *
+ * Timers are kept in a hierarchical wheel of ULT_TIMER_LEVELS levels of
+ * ULT_TIMER_SLOTS slots; level 0 has one slot per tick, every further
+ * level covers ULT_TIMER_SLOTS times the span of the previous one, and
+ * slots of the upper levels are cascaded down as time moves on.  Adding
+ * and cancelling a timer are O(1).
+ *
+ * A service thread, started with the first timer, advances the wheel
+ * once per tick and fires all the timers that expired in that tick as a
+ * batch, outside the wheel lock.  It sleeps without a deadline while no
+ * timer is armed.
+ *
+ * Sleeps and timed waits block the calling thread or ULT on a backend
+ * condition variable that the expiring timer signals, so a sleeping ULT
+ * does not hold on to its OS thread.
+ */
+
+/* Wheel resolution */
+#define ULT_TIMER_TICK_NS 1000000
+#define ULT_TIMER_SLOT_BITS 6
+#define ULT_TIMER_SLOTS (1 << ULT_TIMER_SLOT_BITS)
+#define ULT_TIMER_LEVELS 4
+
+struct ult_timer_t;
+typedef void (*ult_timer_fn_t)(struct ult_timer_t *timer);
+
+/**
+ * Timer armed with ult_timer_add.
+ *
+ * The callback runs on the timer service thread and must not block.  It
+ * is the last access of the wheel to the timer, so the callback may
+ * release it.
+ */
+typedef struct ult_timer_t {
+  /* expiry, in ticks */
+  uint64_t t_expires;
+  ult_timer_fn_t t_fn;
+  struct ult_timer_t *t_next;
+  /* link pointing at this timer within its slot */
+  struct ult_timer_t **t_pprev;
+  /* wheel level the timer is linked in, -1 while it is not armed */
+  int t_level;
+} ult_timer_t;
+
+/**
+ * Current time on CLOCK_MONOTONIC, in nanoseconds.
+ */
+static inline uint64_t ult_timer_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Arm a timer.
+ *
+ * @param timer         Timer, not armed.
+ * @param deadline      Expiry on CLOCK_MONOTONIC, in nanoseconds. The
+ *                      timer fires in the first tick at or after it.
+ * @param fn            Callback.
+ *
+ * @retval SUCCESS              Timer armed
+ * @retval ERR_OUT_OF_RESOURCE  The service thread could not be started
+ */
+DECLSPEC int ult_timer_add(ult_timer_t *timer, uint64_t deadline,
+                           ult_timer_fn_t fn);
+
+/**
+ * Disarm a timer.
+ *
+ * @retval true   The timer was disarmed before it fired.
+ * @retval false  The timer fired or is firing; the caller has to wait
+ *                for its callback by its own means.
+ */
+DECLSPEC bool ult_timer_cancel(ult_timer_t *timer);
+
+/**
+ * Block the calling thread or ULT until a deadline.
+ *
+ * @param deadline      Wake-up time on CLOCK_MONOTONIC, in nanoseconds.
+ */
+DECLSPEC void ult_sleep_until(uint64_t deadline);
+
+/**
+ * Block the calling thread or ULT for a duration.
+ *
+ * @param ns            Nanoseconds to sleep.
+ */
+static inline void ult_sleep_for(uint64_t ns) {
+  ult_sleep_until(ult_timer_now() + ns);
+}
+
+/**
+ * Acquire a mutex, giving up at a deadline.
+ *
+ * Contended callers park in FIFO order on the mutex until mutex_unlock
+ * wakes the first of them or their deadline timer fires.  Releasing the
+ * mutex in cond_wait wakes no one; a waiter then makes a last attempt
+ * at its deadline.
+ *
+ * @param mutex         Address of the mutex.
+ * @param deadline      Deadline on CLOCK_MONOTONIC, in nanoseconds.
+ *
+ * @retval SUCCESS      The mutex was acquired
+ * @retval ERR_TIMEOUT  The deadline passed first
+ */
+DECLSPEC int mutex_timedlock(mutex_t *mutex, uint64_t deadline);
@@ -87,18 +87,43 @@ int tsd_getspecific(tsd_key_t key, void **valuep);
 
 typedef struct tsd_tracked_key_s tsd_tracked_key_t;
 
+/*
+ * Tracked keys remember the value of every thread so that they can be
+ * destroyed with the key.  The registry is lock-free: items are carved
+ * out of chunks of TSD_TRACKED_KEY_CHUNK and pushed onto the key's item
+ * list, which only grows while the key lives.  A thread that exits
+ * marks its item free instead of unlinking it, and the next thread that
+ * sets the key claims a free item back with a single compare-and-swap,
+ * so the list stays bounded by the peak number of threads.
+ */
+#define TSD_TRACKED_KEY_CHUNK 16
+
+#define TSD_ITEM_FREE 0
+#define TSD_ITEM_LIVE 1
+
 typedef struct _tsd_list_item_t {
-  list_item_t super;
   tsd_tracked_key_t *tracked_key;
   void *data;
+  /* next item of the key's registry */
+  struct _tsd_list_item_t *next;
+  /* TSD_ITEM_FREE or TSD_ITEM_LIVE */
+  atomic_int32_t state;
 } tsd_list_item_t;
-OBJ_CLASS_DECLARATION(tsd_list_item_t);
+
+typedef struct _tsd_list_chunk_t {
+  struct _tsd_list_chunk_t *next;
+  tsd_list_item_t items[TSD_TRACKED_KEY_CHUNK];
+} tsd_list_chunk_t;
 
 struct tsd_tracked_key_s {
   object_t super;
   tsd_key_t key;
-  mutex_t mutex;
-  list_t tsd_list;
+  /* head of the item registry, a tsd_list_item_t * */
+  atomic_intptr_t items;
+  /* chunks backing the items, a tsd_list_chunk_t * */
+  atomic_intptr_t chunks;
+  /* at least the number of free items, skips the scan when 0 */
+  atomic_int32_t free_items;
   void (*user_destructor)(void *);
 };
 OBJ_CLASS_DECLARATION(tsd_tracked_key_t);
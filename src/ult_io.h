@@ -0,0 +1,53 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "mutex.h"
+
+/**
+ * @file
+ *
+ * Blocking I/O that only blocks the calling ULT.
+ *
+ * On a backend that runs ULTs on shared workers (Qthreads, Argobots,
+ * native), a blocking system call stalls every ULT queued on the
+ * worker.  With THREADS_USE_IO_URING these calls are instead submitted
+ * to an io_uring shared by the process, and the caller waits on a wait
+ * sync bound to the I/O progress callback: it drives progress or parks
+ * on the backend like any other wait sync, and the completions are
+ * reaped in batches by whichever thread polls the progress engine.  The
+ * thread driving progress yields its worker whenever a pass over the
+ * ring finds nothing, so pending I/O does not keep the other ULTs of
+ * the worker from running.
+ *
+ * On the pthreads backend, without THREADS_USE_IO_URING, or when the
+ * ring cannot be set up (LIBULT_IO_URING=0, a kernel before 5.6 that
+ * lacks the read, write or accept opcodes), the calls fall back to the
+ * plain blocking system calls.
+ *
+ * All functions follow the conventions of the system calls they
+ * replace: they return -1 and set errno on failure.
+ */
+
+/* Default ring size, LIBULT_IO_URING_ENTRIES overrides it */
+#define ULT_IO_URING_ENTRIES 256
+
+/**
+ * Read from a file descriptor, like pread(), or like read() if offset is
+ * -1.
+ */
+DECLSPEC ssize_t ult_io_read(int fd, void *buf, size_t count, off_t offset);
+
+/**
+ * Write to a file descriptor, like pwrite(), or like write() if offset
+ * is -1.
+ */
+DECLSPEC ssize_t ult_io_write(int fd, const void *buf, size_t count,
+                              off_t offset);
+
+/**
+ * Accept a connection, like accept4().
+ */
+DECLSPEC int ult_io_accept(int fd, struct sockaddr *addr, socklen_t *addrlen,
+                           int flags);
@@ -1,91 +1,173 @@
-#once WAIT_SYNC_H
+#pragma once
 
 #include "opal/mca/threads/condition.h"
 #include "opal/mca/threads/mutex.h"
 #include "opal/mca/threads/threads.h"
-#include "opal/runtime/progress.h"
 #include "opal/sys/atomic.h"
+#include "progress.h"
+
+#include <stdint.h>
+#include <time.h>
 
 extern int max_thread_in_progress;
 
+/* Thread blocked in ompi_sync_wait_mt or ompi_sync_wait_many_mt, lives
+ * on the waiter's stack */
+struct wait_sync_waiter_t;
+
+/*
+ * The pending count and the signaling state share a single atomic word.
+ * A waiter sets WAIT_SYNC_PARKED before it blocks; only then does the
+ * thread completing the sync pay for a wakeup, and it acknowledges with
+ * WAIT_SYNC_SIGNALED. After that the completer no longer touches the
+ * sync, so it can be released without waiting for the signaling thread.
+ *
+ * An error update first sets WAIT_SYNC_CLAIMED, which keeps every other
+ * update off the sync, stores its status and only then drops the count
+ * to 0, so a waiter never returns before the status is final.
+ */
 typedef struct ompi_wait_sync_t {
-  atomic_int32_t count;
+  atomic_int32_t state;
   int32_t status;
-  thread_internal_cond_t condition;
-  thread_internal_mutex_t lock;
-  struct ompi_wait_sync_t *next;
-  struct ompi_wait_sync_t *prev;
-  volatile bool signaling;
+  struct wait_sync_waiter_t *waiter;
+  /* callback that completes the sync, NULL if unknown */
+  progress_entry_t *progress;
 } ompi_wait_sync_t;
 
+#define WAIT_SYNC_CLAIMED (1 << 28)
+#define WAIT_SYNC_SIGNALED (1 << 29)
+#define WAIT_SYNC_PARKED (1 << 30)
+#define WAIT_SYNC_COUNT_MASK (WAIT_SYNC_CLAIMED - 1)
+
+/**
+ * Number of updates the sync still waits for.
+ */
+static inline int32_t wait_sync_count(ompi_wait_sync_t *sync) {
+  return sync->state & WAIT_SYNC_COUNT_MASK;
+}
+
+/**
+ * Bind a sync to the progress callback that completes it, so that its
+ * waiter polls that callback instead of the whole progress engine.
+ */
+static inline void wait_sync_set_progress(ompi_wait_sync_t *sync,
+                                          progress_entry_t *entry) {
+  sync->progress = entry;
+}
+
 #define SYNC_WAIT(sync)                                                        \
   (using_threads() ? ompi_sync_wait_mt(sync) : sync_wait_st(sync))
 
-/* The loop in release handles a race condition between the signaling
- * thread and the destruction of the condition variable. The signaling
- * member will be set to false after the final signaling thread has
- * finished operating on the sync object. This is done to avoid
- * extra atomics in the signalling function and keep it as fast
- * as possible. Note that the race window is small so spinning here
- * is more optimal than sleeping since this macro is called in
- * the critical path. */
+/**
+ * Wait for a sync, giving up at deadline (CLOCK_MONOTONIC nanoseconds,
+ * see timer_wheel.h). Returns ERR_TIMEOUT if the sync is still pending
+ * by then.
+ */
+#define SYNC_WAIT_UNTIL(sync, deadline)                                        \
+  (using_threads() ? ompi_sync_wait_until_mt((sync), (deadline))              \
+                   : sync_wait_until_st((sync), (deadline)))
+
+/* Modes of a wait over several syncs */
+#define WAIT_SYNC_ANY 0
+#define WAIT_SYNC_ALL 1
+
+/**
+ * Wait over several syncs: until any of them or all of them completed
+ * (mode WAIT_SYNC_ANY or WAIT_SYNC_ALL), giving up at deadline
+ * (CLOCK_MONOTONIC nanoseconds, 0 for none). The caller blocks once
+ * rather than once per sync, and is woken up by the update that
+ * satisfies the wait.
+ *
+ * The indices of the syncs completed on return are stored into indices
+ * (count entries, may be NULL) and their number into ncompleted (may be
+ * NULL), so that the caller need not scan the syncs again. A sync may
+ * only appear once, and only be waited for by one thread at a time.
+ *
+ * Returns ERROR if a completed sync carries an error status, and
+ * ERR_TIMEOUT if the deadline passed first.
+ */
+#define SYNC_WAIT_MANY_UNTIL(syncs, count, mode, deadline, indices,            \
+                             ncompleted)                                       \
+  (using_threads() ? ompi_sync_wait_many_mt((syncs), (count), (mode),          \
+                                            (deadline), (indices),             \
+                                            (ncompleted))                      \
+                   : ompi_sync_wait_many_st((syncs), (count), (mode),          \
+                                            (deadline), (indices),             \
+                                            (ncompleted)))
+
+#define SYNC_WAIT_ANY(syncs, count, indices, ncompleted)                       \
+  SYNC_WAIT_MANY_UNTIL(syncs, count, WAIT_SYNC_ANY, 0, indices, ncompleted)
+
+#define SYNC_WAIT_ALL(syncs, count)                                            \
+  SYNC_WAIT_MANY_UNTIL(syncs, count, WAIT_SYNC_ALL, 0, NULL, NULL)
+
+/* Nothing to tear down: the completer acknowledges a parked waiter
+ * before the waiter returns, and never touches the sync afterwards. */
 #define WAIT_SYNC_RELEASE(sync)                                                \
-  if (using_threads()) {                                                       \
-    while ((sync)->signaling) {                                                \
-      if (progress_yield_when_idle) {                                          \
-        thread_yield();                                                        \
-      }                                                                        \
-      continue;                                                                \
-    }                                                                          \
-    thread_internal_cond_destroy(&(sync)->condition);                          \
-    thread_internal_mutex_destroy(&(sync)->lock);                              \
-  }
+  do {                                                                         \
+  } while (0)
 
-#define WAIT_SYNC_RELEASE_NOWAIT(sync)                                         \
-  if (using_threads()) {                                                       \
-    thread_internal_cond_destroy(&(sync)->condition);                          \
-    thread_internal_mutex_destroy(&(sync)->lock);                              \
-  }
+#define WAIT_SYNC_RELEASE_NOWAIT(sync) WAIT_SYNC_RELEASE(sync)
 
-#define WAIT_SYNC_SIGNAL(sync)                                                 \
-  if (using_threads()) {                                                       \
-    thread_internal_mutex_lock(&(sync)->lock);                                 \
-    thread_internal_cond_signal(&(sync)->condition);                           \
-    thread_internal_mutex_unlock(&(sync)->lock);                               \
-    (sync)->signaling = false;                                                 \
-  }
+/* Wake the thread parked on a completed sync */
+#define WAIT_SYNC_SIGNAL(sync) threads_base_wait_sync_signal(sync)
 
 #define WAIT_SYNC_SIGNALLED(sync)                                              \
-  { (sync)->signaling = false; }
+  do {                                                                         \
+  } while (0)
 
 /* not static for inline "wait_sync_st" */
 DECLSPEC extern ompi_wait_sync_t *threads_base_wait_sync_list;
 
 DECLSPEC int ompi_sync_wait_mt(ompi_wait_sync_t *sync);
+DECLSPEC int ompi_sync_wait_until_mt(ompi_wait_sync_t *sync,
+                                     uint64_t deadline);
+DECLSPEC int ompi_sync_wait_many_mt(ompi_wait_sync_t **syncs, int count,
+                                    int mode, uint64_t deadline, int *indices,
+                                    int *ncompleted);
+DECLSPEC int ompi_sync_wait_many_st(ompi_wait_sync_t **syncs, int count,
+                                    int mode, uint64_t deadline, int *indices,
+                                    int *ncompleted);
+DECLSPEC void threads_base_wait_sync_signal(ompi_wait_sync_t *sync);
+DECLSPEC int wait_sync_progress(ompi_wait_sync_t **syncs, int count);
+
 static inline int sync_wait_st(ompi_wait_sync_t *sync) {
   assert(NULL == threads_base_wait_sync_list);
-  assert(NULL == sync->next);
   threads_base_wait_sync_list = sync;
 
-  while (sync->count > 0) {
-    progress();
+  while (wait_sync_count(sync) > 0) {
+    wait_sync_progress(&sync, 1);
   }
   threads_base_wait_sync_list = NULL;
 
   return sync->status;
 }
 
+static inline int sync_wait_until_st(ompi_wait_sync_t *sync,
+                                     uint64_t deadline) {
+  struct timespec ts;
+
+  assert(NULL == threads_base_wait_sync_list);
+  threads_base_wait_sync_list = sync;
+
+  while (wait_sync_count(sync) > 0) {
+    wait_sync_progress(&sync, 1);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if ((uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec >= deadline) {
+      break;
+    }
+  }
+  threads_base_wait_sync_list = NULL;
+
+  return wait_sync_count(sync) > 0 ? ERR_TIMEOUT : sync->status;
+}
+
 #define WAIT_SYNC_INIT(sync, c)                                                \
   do {                                                                         \
-    (sync)->count = (c);                                                       \
-    (sync)->next = NULL;                                                       \
-    (sync)->prev = NULL;                                                       \
+    (sync)->state = (c);                                                       \
     (sync)->status = 0;                                                        \
-    (sync)->signaling = (0 != (c));                                            \
-    if (using_threads()) {                                                     \
-      thread_internal_cond_init(&(sync)->condition);                           \
-      thread_internal_mutex_init(&(sync)->lock, false);                        \
-    }                                                                          \
+    (sync)->waiter = NULL;                                                     \
+    (sync)->progress = NULL;                                                   \
   } while (0)
 
 /**
@@ -104,18 +186,52 @@ DECLSPEC void threads_base_wait_sync_global_wakeup_mt(int status);
  * reported the synchronization is completed and the signal
  * triggered. The status of the synchronization will be reported to
  * the waiting threads.
+ *
+ * The count saturates at zero and never borrows from the flag bits, and
+ * a completed sync stays completed: updates that arrive afterwards, say
+ * after an error completed it early, are ignored, leave the status the
+ * waiter returned on alone and never signal the waiter again, which may
+ * be gone by then.  Of concurrent errors, the first one wins.
+ *
+ * Completing a sync nobody is parked on costs a single atomic.
  */
 static inline void wait_sync_update(ompi_wait_sync_t *sync, int updates,
                                     int status) {
-  if (LIKELY(SUCCESS == status)) {
-    if (0 != (THREAD_ADD_FETCH32(&sync->count, -updates))) {
+  int32_t state, count, desired;
+
+  state = sync->state;
+  do {
+    count = state & WAIT_SYNC_COUNT_MASK;
+    if (0 == count || UNLIKELY(state & WAIT_SYNC_CLAIMED)) {
+      return; /* already completed, or being completed by an error */
+    }
+    if (UNLIKELY(SUCCESS != status)) {
+      desired = state | WAIT_SYNC_CLAIMED;
+    } else if (count <= updates) {
+      count = 0;
+      desired = state & ~WAIT_SYNC_COUNT_MASK;
+    } else if (0 == updates) {
       return;
+    } else {
+      count -= updates;
+      desired = (state & ~WAIT_SYNC_COUNT_MASK) | count;
     }
-  } else {
-    /* this is an error path so just use the atomic */
+  } while (!THREAD_COMPARE_EXCHANGE_STRONG_32(&sync->state, &state, desired));
+
+  if (UNLIKELY(SUCCESS != status)) {
+    /* this is an error path: the sync is ours, publish the status before
+     * the waiter can see the count at 0.  Only a waiter parking or being
+     * signaled still changes the flags. */
     sync->status = status;
     atomic_wmb();
-    atomic_swap_32(&sync->count, 0);
+    state = desired;
+    count = 0;
+    while (!THREAD_COMPARE_EXCHANGE_STRONG_32(
+        &sync->state, &state,
+        state & ~(WAIT_SYNC_COUNT_MASK | WAIT_SYNC_CLAIMED))) {
+    }
+  }
+  if (0 == count && UNLIKELY(state & WAIT_SYNC_PARKED)) {
+    WAIT_SYNC_SIGNAL(sync);
   }
-  WAIT_SYNC_SIGNAL(sync);
 }
@@ -0,0 +1,53 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+barrier_t bench_barrier;
+
+} // namespace
+
+// Back-to-back barrier episodes, one participant per benchmark thread,
+// for each waiting policy.
+template <int Policy> static void BM_barrier(benchmark::State &state) {
+  // the library synchronizes the threads around the timed loop
+  if (state.thread_index() == 0) {
+    enable_threads();
+    barrier_init(&bench_barrier, state.threads(), Policy);
+  }
+  for (auto _ : state) {
+    barrier_wait(&bench_barrier, state.thread_index());
+  }
+  if (state.thread_index() == 0) {
+    barrier_destroy(&bench_barrier);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_barrier, BARRIER_SPIN)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_barrier, BARRIER_YIELD)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_barrier, BARRIER_PARK)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
@@ -0,0 +1,51 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+cohort_lock_t *bench_cohort_locks() {
+  static cohort_lock_t *locks = [] {
+    enable_threads();
+    auto *l = new cohort_lock_t[max_bench_locks];
+    for (int i = 0; i < max_bench_locks; ++i) {
+      OBJ_CONSTRUCT(&l[i], cohort_lock_t);
+    }
+    return l;
+  }();
+  return locks;
+}
+
+} // namespace
+
+// Same sweep as BM_mutex, to compare against it on multi-socket nodes
+static void BM_cohort_lock(benchmark::State &state) {
+  cohort_lock_t *lock =
+      &bench_cohort_locks()[state.thread_index() % state.range(0)];
+  const int64_t work = state.range(1);
+  for (auto _ : state) {
+    cohort_lock_lock(lock);
+    critical_section_work(work);
+    cohort_lock_unlock(lock);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_cohort_lock)->Apply(contention_sweep);
@@ -0,0 +1,92 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+struct shared_counters {
+  int64_t values[8];
+};
+
+combiner_t *bench_combiner() {
+  static combiner_t *combiner = [] {
+    enable_threads();
+    auto *c = new combiner_t;
+    OBJ_CONSTRUCT(c, combiner_t);
+    return c;
+  }();
+  return combiner;
+}
+
+mutex_t *bench_counters_lock() {
+  static mutex_t *lock = [] {
+    enable_threads();
+    auto *l = new mutex_t;
+    OBJ_CONSTRUCT(l, mutex_t);
+    return l;
+  }();
+  return lock;
+}
+
+shared_counters counters;
+
+void update_counters(void *arg) {
+  const int64_t work = *static_cast<int64_t *>(arg);
+  for (auto &value : counters.values) {
+    ++value;
+  }
+  critical_section_work(work);
+}
+
+} // namespace
+
+// The same small shared update, through the combiner and under a mutex.
+static void BM_combiner(benchmark::State &state) {
+  combiner_t *combiner = bench_combiner();
+  int64_t work = state.range(0);
+  for (auto _ : state) {
+    combiner_execute(combiner, update_counters, &work);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_combiner)
+    ->ArgName("work")
+    ->Arg(0)
+    ->Arg(100)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
+
+static void BM_combiner_mutex_baseline(benchmark::State &state) {
+  mutex_t *lock = bench_counters_lock();
+  int64_t work = state.range(0);
+  for (auto _ : state) {
+    mutex_lock(lock);
+    update_counters(&work);
+    mutex_unlock(lock);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_combiner_mutex_baseline)
+    ->ArgName("work")
+    ->Arg(0)
+    ->Arg(100)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
@@ -0,0 +1,67 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+extern "C" {
+#include "barrier.h"
+#include "cohort_lock.h"
+#include "combiner.h"
+#include "mutex.h"
+#include "progress.h"
+#include "rwlock.h"
+#include "sema.h"
+#include "threads.h"
+#include "tsd.h"
+#include "ult_io.h"
+#include "wait_sync.h"
+}
+
+namespace libult_bench {
+
+constexpr int max_bench_threads = 256;
+
+// Number of distinct locks the threads spread over, and the number of
+// spin iterations spent inside each critical section.
+constexpr int max_bench_locks = 64;
+
+// Sweep thread counts and contention levels: all threads on one lock up
+// to one lock per thread, with empty and short critical sections.
+inline void contention_sweep(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"locks", "work"})
+      ->ArgsProduct({{1, 4, max_bench_locks}, {0, 100}})
+      ->ThreadRange(1, max_bench_threads)
+      ->UseRealTime();
+}
+
+inline void critical_section_work(int64_t work) {
+  for (int64_t i = 0; i < work; ++i) {
+    benchmark::DoNotOptimize(i);
+  }
+}
+
+// The primitives only take their multi-threaded paths once threads
+// are in use, so switch that on before any benchmark runs.
+inline bool enable_threads() {
+  static const bool threaded = set_using_threads(true);
+  return threaded;
+}
+
+} // namespace libult_bench
@@ -0,0 +1,77 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+// Two threads hand a token back and forth through one mutex and cond_t
+struct ping_pong_t {
+  mutex_t lock;
+  cond_t cond;
+  int turn;
+};
+
+ping_pong_t *bench_pairs() {
+  static ping_pong_t *pairs = [] {
+    enable_threads();
+    auto *p = new ping_pong_t[max_bench_threads / 2];
+    for (int i = 0; i < max_bench_threads / 2; ++i) {
+      OBJ_CONSTRUCT(&p[i].lock, mutex_t);
+      cond_init(&p[i].cond);
+      p[i].turn = 0;
+    }
+    return p;
+  }();
+  return pairs;
+}
+
+} // namespace
+
+// Every thread runs the same number of iterations, so both sides of a
+// pair perform the same number of hand-offs and always terminate.
+static void BM_cond_ping_pong(benchmark::State &state) {
+  ping_pong_t *pair = &bench_pairs()[state.thread_index() / 2];
+  const int me = state.thread_index() % 2;
+  for (auto _ : state) {
+    mutex_lock(&pair->lock);
+    while (pair->turn != me) {
+      cond_wait(&pair->cond, &pair->lock);
+    }
+    pair->turn = 1 - me;
+    cond_signal(&pair->cond);
+    mutex_unlock(&pair->lock);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_cond_ping_pong)
+    ->ThreadRange(2, max_bench_threads)
+    ->UseRealTime();
+
+static void BM_cond_signal_no_waiter(benchmark::State &state) {
+  ping_pong_t *pair = &bench_pairs()[state.thread_index() / 2];
+  for (auto _ : state) {
+    cond_signal(&pair->cond);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_cond_signal_no_waiter)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
@@ -0,0 +1,90 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+#include "bench_common.hpp"
+
+#if defined(__cpp_impl_coroutine)
+
+#include "coro.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+libult::executor &bench_executor() {
+  static libult::executor *ex = [] {
+    enable_threads();
+    return new libult::executor(4);
+  }();
+  return *ex;
+}
+
+libult::task<int> bench_leaf(int x) { co_return x + 1; }
+
+libult::task<int> bench_chain(int depth) {
+  int sum = 0;
+  for (int i = 0; i < depth; ++i) {
+    sum += co_await bench_leaf(i);
+  }
+  co_return sum;
+}
+
+libult::task<void> bench_lock_loop(libult::async_mutex &m, int rounds) {
+  for (int i = 0; i < rounds; ++i) {
+    co_await m.lock();
+    m.unlock();
+  }
+}
+
+} // namespace
+
+// Round trip of a task through the executor's threads, from several
+// blocking callers at once
+static void BM_coro_block_on(benchmark::State &state) {
+  libult::executor &ex = bench_executor();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ex.block_on(bench_leaf(1)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_coro_block_on)->ThreadRange(1, 16)->UseRealTime();
+
+// Cost of awaiting a task that completes without suspending: frame
+// allocation and symmetric transfer in and out
+static void BM_coro_await_task(benchmark::State &state) {
+  libult::executor &ex = bench_executor();
+  const int depth = 1024;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ex.block_on(bench_chain(depth)));
+  }
+  state.SetItemsProcessed(state.iterations() * depth);
+}
+BENCHMARK(BM_coro_await_task)->UseRealTime();
+
+// async_mutex shared by tasks of several blocking callers
+static void BM_coro_async_mutex(benchmark::State &state) {
+  static libult::async_mutex mutex;
+  libult::executor &ex = bench_executor();
+  const int rounds = 256;
+  for (auto _ : state) {
+    ex.block_on(bench_lock_loop(mutex, rounds));
+  }
+  state.SetItemsProcessed(state.iterations() * rounds);
+}
+BENCHMARK(BM_coro_async_mutex)->ThreadRange(1, 16)->UseRealTime();
+
+#endif /* defined(__cpp_impl_coroutine) */
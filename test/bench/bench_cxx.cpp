@@ -0,0 +1,87 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+#include "libult.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+libult::mutex *bench_locks() {
+  static libult::mutex *locks = [] {
+    enable_threads();
+    return new libult::mutex[max_bench_locks];
+  }();
+  return locks;
+}
+
+// Two threads hand a token back and forth, as in bench_cond.cpp
+struct ping_pong_t {
+  libult::mutex lock;
+  libult::condition_variable cond;
+  int turn = 0;
+};
+
+ping_pong_t *bench_pairs() {
+  static ping_pong_t *pairs = [] {
+    enable_threads();
+    return new ping_pong_t[max_bench_threads / 2];
+  }();
+  return pairs;
+}
+
+} // namespace
+
+// Same sweep as BM_mutex, through std::lock_guard
+static void BM_cxx_mutex(benchmark::State &state) {
+  libult::mutex *lock = &bench_locks()[state.thread_index() % state.range(0)];
+  const int64_t work = state.range(1);
+  for (auto _ : state) {
+    std::lock_guard<libult::mutex> guard(*lock);
+    critical_section_work(work);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_cxx_mutex)->Apply(contention_sweep);
+
+static void BM_cxx_cond_ping_pong(benchmark::State &state) {
+  ping_pong_t *pair = &bench_pairs()[state.thread_index() / 2];
+  const int me = state.thread_index() % 2;
+  for (auto _ : state) {
+    std::unique_lock<libult::mutex> lock(pair->lock);
+    pair->cond.wait(lock, [&] { return pair->turn == me; });
+    pair->turn = 1 - me;
+    pair->cond.notify_one();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_cxx_cond_ping_pong)
+    ->ThreadRange(2, max_bench_threads)
+    ->UseRealTime();
+
+static void BM_cxx_thread(benchmark::State &state) {
+  enable_threads();
+  for (auto _ : state) {
+    libult::thread t([] {});
+    t.join();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_cxx_thread)->UseRealTime();
@@ -0,0 +1,98 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+mutex_t *bench_locks() {
+  static mutex_t *locks = [] {
+    enable_threads();
+    auto *l = new mutex_t[max_bench_locks];
+    for (int i = 0; i < max_bench_locks; ++i) {
+      OBJ_CONSTRUCT(&l[i], mutex_t);
+    }
+    return l;
+  }();
+  return locks;
+}
+
+// Locks whose mutex_atomic_* functions use the given MUTEX_ATOMIC_* kind
+template <int Kind> mutex_t *bench_atomic_locks() {
+  static mutex_t *locks = [] {
+    enable_threads();
+    auto *l = new mutex_t[max_bench_locks];
+    for (int i = 0; i < max_bench_locks; ++i) {
+      OBJ_CONSTRUCT(&l[i], mutex_t);
+      mutex_atomic_set_kind(&l[i], Kind);
+    }
+    return l;
+  }();
+  return locks;
+}
+
+} // namespace
+
+template <void (*Lock)(mutex_t *), void (*Unlock)(mutex_t *)>
+static void BM_mutex(benchmark::State &state) {
+  mutex_t *lock = &bench_locks()[state.thread_index() % state.range(0)];
+  const int64_t work = state.range(1);
+  for (auto _ : state) {
+    Lock(lock);
+    critical_section_work(work);
+    Unlock(lock);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_mutex, mutex_lock, mutex_unlock)->Apply(contention_sweep);
+BENCHMARK_TEMPLATE(BM_mutex, mutex_atomic_lock, mutex_atomic_unlock)
+    ->Apply(contention_sweep);
+
+template <int Kind> static void BM_mutex_atomic_kind(benchmark::State &state) {
+  mutex_t *lock =
+      &bench_atomic_locks<Kind>()[state.thread_index() % state.range(0)];
+  const int64_t work = state.range(1);
+  for (auto _ : state) {
+    mutex_atomic_lock(lock);
+    critical_section_work(work);
+    mutex_atomic_unlock(lock);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_mutex_atomic_kind, MUTEX_ATOMIC_QUEUE)
+    ->Apply(contention_sweep);
+BENCHMARK_TEMPLATE(BM_mutex_atomic_kind, MUTEX_ATOMIC_QUEUE_YIELD)
+    ->Apply(contention_sweep);
+
+static void BM_mutex_trylock(benchmark::State &state) {
+  mutex_t *lock = &bench_locks()[state.thread_index() % state.range(0)];
+  const int64_t work = state.range(1);
+  int64_t acquired = 0;
+  for (auto _ : state) {
+    if (0 == mutex_trylock(lock)) {
+      critical_section_work(work);
+      mutex_unlock(lock);
+      ++acquired;
+    }
+  }
+  state.counters["acquired"] = benchmark::Counter(
+      static_cast<double>(acquired), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_mutex_trylock)->Apply(contention_sweep);
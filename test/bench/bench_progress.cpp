@@ -0,0 +1,82 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+#include <vector>
+
+using namespace libult_bench;
+
+namespace {
+
+int idle_callback() { return 0; }
+
+// Registers callbacks for the duration of a benchmark
+struct registered_callbacks {
+  std::vector<progress_entry_t *> entries;
+
+  registered_callbacks(int count, int flags) {
+    enable_threads();
+    for (int i = 0; i < count; ++i) {
+      progress_entry_t *entry;
+      progress_register(idle_callback, PROGRESS_PRIORITY_NORMAL, 1, flags,
+                        &entry);
+      entries.push_back(entry);
+    }
+  }
+
+  ~registered_callbacks() {
+    for (auto *entry : entries) {
+      progress_unregister(entry);
+    }
+  }
+};
+
+} // namespace
+
+// A pass over callbacks that are always polled, and over on-demand
+// callbacks with no work, which are skipped.
+template <int Flags> static void BM_progress_pass(benchmark::State &state) {
+  registered_callbacks callbacks(state.range(0), Flags);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(progress());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_progress_pass, 0)
+    ->ArgName("callbacks")
+    ->RangeMultiplier(4)
+    ->Range(1, 256);
+BENCHMARK_TEMPLATE(BM_progress_pass, PROGRESS_ON_DEMAND)
+    ->ArgName("callbacks")
+    ->RangeMultiplier(4)
+    ->Range(1, 256);
+
+// Registration churn from every thread
+static void BM_progress_register(benchmark::State &state) {
+  enable_threads();
+  for (auto _ : state) {
+    progress_entry_t *entry;
+    progress_register(idle_callback, PROGRESS_PRIORITY_LOW, 1, 0, &entry);
+    progress_unregister(entry);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_progress_register)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
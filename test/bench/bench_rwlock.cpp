@@ -0,0 +1,79 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+rwlock_t *bench_rwlock() {
+  static rwlock_t *lock = [] {
+    enable_threads();
+    auto *l = new rwlock_t;
+    OBJ_CONSTRUCT(l, rwlock_t);
+    return l;
+  }();
+  return lock;
+}
+
+} // namespace
+
+// Readers only: the per-core counters should keep this flat as threads
+// are added, where a mutex serializes them.
+static void BM_rwlock_read(benchmark::State &state) {
+  rwlock_t *lock = bench_rwlock();
+  const int64_t work = state.range(0);
+  for (auto _ : state) {
+    rwlock_rdlock(lock);
+    critical_section_work(work);
+    rwlock_rdunlock(lock);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_rwlock_read)
+    ->ArgName("work")
+    ->Arg(0)
+    ->Arg(100)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
+
+// One write every "period" acquisitions.
+static void BM_rwlock_mixed(benchmark::State &state) {
+  rwlock_t *lock = bench_rwlock();
+  const int64_t period = state.range(0);
+  int64_t i = 0;
+  for (auto _ : state) {
+    if (0 == ++i % period) {
+      rwlock_wrlock(lock);
+      critical_section_work(100);
+      rwlock_wrunlock(lock);
+    } else {
+      rwlock_rdlock(lock);
+      critical_section_work(100);
+      rwlock_rdunlock(lock);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_rwlock_mixed)
+    ->ArgName("period")
+    ->Arg(10)
+    ->Arg(1000)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
@@ -0,0 +1,103 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+// Two threads hand a token back and forth, one semaphore per direction;
+// compare with BM_cond_ping_pong
+struct sem_pair_t {
+  semaphore_t turn[2];
+};
+
+sem_pair_t *bench_sem_pairs() {
+  static sem_pair_t *pairs = [] {
+    enable_threads();
+    auto *p = new sem_pair_t[max_bench_threads / 2];
+    for (int i = 0; i < max_bench_threads / 2; ++i) {
+      OBJ_CONSTRUCT(&p[i].turn[0], semaphore_t);
+      OBJ_CONSTRUCT(&p[i].turn[1], semaphore_t);
+      semaphore_set(&p[i].turn[0], 1);
+    }
+    return p;
+  }();
+  return pairs;
+}
+
+semaphore_t *bench_pool(int units) {
+  static semaphore_t *pools = [] {
+    enable_threads();
+    auto *p = new semaphore_t[max_bench_locks + 1];
+    for (int i = 0; i <= max_bench_locks; ++i) {
+      OBJ_CONSTRUCT(&p[i], semaphore_t);
+      semaphore_set(&p[i], i);
+    }
+    return p;
+  }();
+  return &pools[units];
+}
+
+} // namespace
+
+static void BM_semaphore_ping_pong(benchmark::State &state) {
+  sem_pair_t *pair = &bench_sem_pairs()[state.thread_index() / 2];
+  const int me = state.thread_index() % 2;
+  for (auto _ : state) {
+    semaphore_wait(&pair->turn[me]);
+    semaphore_post(&pair->turn[1 - me]);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_semaphore_ping_pong)
+    ->ThreadRange(2, max_bench_threads)
+    ->UseRealTime();
+
+// Threads share a pool of a few units, as a bounded resource pool would
+static void BM_semaphore_pool(benchmark::State &state) {
+  semaphore_t *pool = bench_pool(state.range(0));
+  int64_t work = state.range(1);
+  for (auto _ : state) {
+    semaphore_wait(pool);
+    critical_section_work(work);
+    semaphore_post(pool);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_semaphore_pool)
+    ->ArgNames({"units", "work"})
+    ->ArgsProduct({{1, 4, max_bench_locks}, {0, 100}})
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
+
+// Uncontended count down to zero and wait, as a fan-in point of one
+static void BM_latch_uncontended(benchmark::State &state) {
+  enable_threads();
+  latch_t latch;
+  OBJ_CONSTRUCT(&latch, latch_t);
+  for (auto _ : state) {
+    latch_set(&latch, 1);
+    latch_count_down(&latch, 1);
+    latch_wait(&latch);
+  }
+  OBJ_DESTRUCT(&latch);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_latch_uncontended);
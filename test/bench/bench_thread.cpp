@@ -0,0 +1,54 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+void *bench_thread_run(object_t *) { return nullptr; }
+
+} // namespace
+
+// Spawn-and-join latency of short-lived threads, with several spawners
+// hitting the backend concurrently.
+static void BM_thread_start_join(benchmark::State &state) {
+  enable_threads();
+  thread_t thread;
+  OBJ_CONSTRUCT(&thread, thread_t);
+  thread.t_run = bench_thread_run;
+  for (auto _ : state) {
+    thread_start(&thread);
+    thread_join(&thread, nullptr);
+  }
+  OBJ_DESTRUCT(&thread);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_thread_start_join)->ThreadRange(1, 16)->UseRealTime();
+
+// Cost of thread_yield, which on the ULT backends is a round trip
+// through the scheduler whenever other work is queued.
+static void BM_thread_yield(benchmark::State &state) {
+  enable_threads();
+  for (auto _ : state) {
+    thread_yield();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_thread_yield)->ThreadRange(1, 16)->UseRealTime();
@@ -0,0 +1,61 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+using namespace libult_bench;
+
+namespace {
+
+tsd_tracked_key_t *bench_key() {
+  static tsd_tracked_key_t *key = [] {
+    enable_threads();
+    auto *k = new tsd_tracked_key_t;
+    OBJ_CONSTRUCT(k, tsd_tracked_key_t);
+    return k;
+  }();
+  return key;
+}
+
+} // namespace
+
+static void BM_tsd_tracked_key_get(benchmark::State &state) {
+  tsd_tracked_key_t *key = bench_key();
+  void *value = nullptr;
+  tsd_tracked_key_set(key, &value);
+  for (auto _ : state) {
+    tsd_tracked_key_get(key, &value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_tsd_tracked_key_get)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
+
+static void BM_tsd_tracked_key_set(benchmark::State &state) {
+  tsd_tracked_key_t *key = bench_key();
+  int value = 0;
+  for (auto _ : state) {
+    tsd_tracked_key_set(key, &value);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_tsd_tracked_key_set)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
@@ -0,0 +1,63 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace libult_bench;
+
+namespace {
+
+constexpr int io_block = 4096;
+constexpr int io_blocks = 256;
+
+// A scratch file every thread reads blocks of
+int bench_io_fd() {
+  static int fd = [] {
+    enable_threads();
+    char path[] = "/tmp/libult_bench_ioXXXXXX";
+    int f = mkstemp(path);
+    unlink(path);
+    char block[io_block] = {};
+    for (int i = 0; i < io_blocks; ++i) {
+      ult_io_write(f, block, io_block, (off_t)i * io_block);
+    }
+    return f;
+  }();
+  return fd;
+}
+
+} // namespace
+
+// Positioned reads of page-cache resident blocks: the cost of going
+// through the ring, or of the system call on pthreads.
+static void BM_ult_io_read(benchmark::State &state) {
+  int fd = bench_io_fd();
+  char block[io_block];
+  int i = state.thread_index();
+  for (auto _ : state) {
+    off_t offset = (off_t)(i++ % io_blocks) * io_block;
+    benchmark::DoNotOptimize(ult_io_read(fd, block, io_block, offset));
+  }
+  state.SetBytesProcessed(state.iterations() * io_block);
+}
+BENCHMARK(BM_ult_io_read)->ThreadRange(1, max_bench_threads)->UseRealTime();
@@ -0,0 +1,86 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include "bench_common.hpp"
+
+#include <atomic>
+
+using namespace libult_bench;
+
+namespace {
+
+// Syncs posted by the waiting threads, completed from bench_poll
+std::atomic<ompi_wait_sync_t *> pending[max_bench_threads];
+
+// Whichever waiter is elected progress manager completes everybody's
+// requests, so the benchmark measures registration, election and handoff.
+int bench_poll(void) {
+  int completed = 0;
+  for (auto &slot : pending) {
+    ompi_wait_sync_t *sync = slot.exchange(nullptr, std::memory_order_acq_rel);
+    if (nullptr != sync) {
+      wait_sync_update(sync, 1, SUCCESS);
+      ++completed;
+    }
+  }
+  return completed;
+}
+
+progress_entry_t *bench_poll_entry() {
+  static progress_entry_t *entry = [] {
+    progress_entry_t *e = nullptr;
+    progress_register(bench_poll, PROGRESS_PRIORITY_NORMAL, 1, 0, &e);
+    return e;
+  }();
+  return entry;
+}
+
+} // namespace
+
+static void BM_wait_sync_wait_complete(benchmark::State &state) {
+  enable_threads();
+  progress_entry_t *entry = bench_poll_entry();
+  ompi_wait_sync_t sync;
+  for (auto _ : state) {
+    WAIT_SYNC_INIT(&sync, 1);
+    wait_sync_set_progress(&sync, entry);
+    pending[state.thread_index()].store(&sync, std::memory_order_release);
+    SYNC_WAIT(&sync);
+    WAIT_SYNC_RELEASE(&sync);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_wait_sync_wait_complete)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
+
+// Request completed before anybody waits on it: the common fast path
+static void BM_wait_sync_update_then_wait(benchmark::State &state) {
+  enable_threads();
+  ompi_wait_sync_t sync;
+  for (auto _ : state) {
+    WAIT_SYNC_INIT(&sync, 1);
+    wait_sync_update(&sync, 1, SUCCESS);
+    SYNC_WAIT(&sync);
+    WAIT_SYNC_RELEASE(&sync);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_wait_sync_update_then_wait)
+    ->ThreadRange(1, max_bench_threads)
+    ->UseRealTime();
@@ -0,0 +1,96 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "libult.hpp"
+
+extern "C" {
+#include "barrier.h"
+}
+
+namespace {
+
+constexpr int episodes = 100;
+
+// Every participant checks, right after each episode, that all of them
+// arrived, and one of them per episode is told it completed it
+template <typename Thread> void run_barrier(int participants, int policy) {
+  barrier_t barrier;
+  std::vector<std::atomic<int>> arrived(episodes);
+  std::atomic<int> serial{0};
+  std::atomic<int> early{0};
+
+  ASSERT_EQ(SUCCESS, barrier_init(&barrier, participants, policy));
+  std::vector<Thread> threads;
+  for (int rank = 0; rank < participants; ++rank) {
+    threads.emplace_back([&, rank] {
+      for (int episode = 0; episode < episodes; ++episode) {
+        ++arrived[episode];
+        if (BARRIER_SERIAL == barrier_wait(&barrier, rank)) {
+          ++serial;
+        }
+        if (participants != arrived[episode]) {
+          ++early;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  barrier_destroy(&barrier);
+  EXPECT_EQ(0, early.load());
+  EXPECT_EQ(episodes, serial.load());
+}
+
+} // namespace
+
+TEST(Barrier, NoParticipant) {
+  barrier_t barrier;
+  EXPECT_EQ(ERR_BAD_PARAM, barrier_init(&barrier, 0, BARRIER_SPIN));
+}
+
+TEST(Barrier, SingleParticipant) {
+  barrier_t barrier;
+  ASSERT_EQ(SUCCESS, barrier_init(&barrier, 1, BARRIER_PARK));
+  for (int episode = 0; episode < episodes; ++episode) {
+    EXPECT_EQ(BARRIER_SERIAL, barrier_wait(&barrier, 0));
+  }
+  barrier_destroy(&barrier);
+}
+
+// More participants than BARRIER_FANIN, and not a power of it, so that
+// the tree has a partial node.  Spinning participants are kernel
+// threads, no more than there are CPUs: ULTs spinning on a worker would
+// starve the ones it still has to run, and oversubscribed spinners only
+// move on when preempted.
+TEST(Barrier, ReleaseSpin) {
+  int cpus = static_cast<int>(std::thread::hardware_concurrency());
+  run_barrier<std::thread>(std::min(std::max(cpus, 2), 7), BARRIER_SPIN);
+}
+TEST(Barrier, ReleaseYield) { run_barrier<libult::thread>(7, BARRIER_YIELD); }
+TEST(Barrier, ReleasePark) { run_barrier<libult::thread>(7, BARRIER_PARK); }
+TEST(Barrier, ReleaseParkDeep) {
+  run_barrier<libult::thread>(21, BARRIER_PARK);
+}
@@ -0,0 +1,102 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include "mutex.h"
+}
+
+// Only built with LIBULT_ENABLE_LOCK_PROFILE
+#if THREADS_LOCK_PROFILE
+
+namespace {
+
+class LockProfile : public ::testing::Test {
+protected:
+  void SetUp() override {
+    lock_profile_reset();
+    lock_profile_set_period(1);
+  }
+  void TearDown() override {
+    lock_profile_set_period(64);
+    lock_profile_reset();
+  }
+};
+
+// Reads the hold_p99 column of the report line of the given site, -1 if
+// the site is missing from the report
+long report_hold_p99(const lock_profile_site_t *site) {
+  char line[512], where[256];
+  long hold_p99 = -1;
+  FILE *out = tmpfile();
+
+  if (nullptr == out) {
+    return -1;
+  }
+  lock_profile_report(out);
+  rewind(out);
+  snprintf(where, sizeof(where), "%s:%d", site->file, site->line);
+  while (nullptr != fgets(line, sizeof(line), out)) {
+    unsigned long acquisitions, contended, wait_ns, wait_p50, wait_p99;
+    unsigned long hold_ns, p99;
+    double percent;
+    char at[256];
+    if ('#' != line[0] &&
+        9 == sscanf(line, "%lu %lu %lf%% %lu %lu %lu %lu %lu %255s",
+                     &acquisitions, &contended, &percent, &wait_ns, &wait_p50,
+                     &wait_p99, &hold_ns, &p99, at) &&
+        0 == strcmp(at, where)) {
+      hold_p99 = (long)p99;
+    }
+  }
+  fclose(out);
+  return hold_p99;
+}
+
+} // namespace
+
+// Holds that end in lock_profile_drop are sampled but never recorded: the
+// hold quantiles are taken over the recorded holds, not every sample
+TEST_F(LockProfile, DroppedHolds) {
+  static lock_profile_site_t site = LOCK_PROFILE_SITE_INIT;
+  mutex_t mutex;
+
+  OBJ_CONSTRUCT(&mutex, mutex_t);
+  for (int i = 0; i < 100; ++i) {
+    mutex_lock_profiled(&mutex, &site);
+    if (0 == i % 10) {
+      mutex_unlock_profiled(&mutex);
+    } else {
+      lock_profile_drop(&mutex);
+      mutex_unlock(&mutex);
+    }
+  }
+  OBJ_DESTRUCT(&mutex);
+
+  EXPECT_EQ(100, site.samples);
+  long hold_p99 = report_hold_p99(&site);
+  EXPECT_LE(0, hold_p99);
+  // a few microseconds at most, not the open-ended last bucket
+  EXPECT_GT(1L << (LOCK_PROFILE_BUCKETS - 1), hold_p99);
+}
+
+#endif
@@ -0,0 +1,368 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+extern "C" {
+#include "threads.h"
+#include "tsd.h"
+}
+
+// Only the native backend has ULTs of its own to test
+#if THREADS_NATIVE_THREAD
+
+namespace {
+
+class Native : public ::testing::Test {
+protected:
+  void SetUp() override { threads_ensure_init_native(); }
+};
+
+void *echo(void *arg) { return arg; }
+
+void *spawn_echo(void *arg) {
+  threads_native_ult_t *child;
+  void *result = nullptr;
+  if (SUCCESS != threads_native_spawn(echo, arg, &child)) {
+    return nullptr;
+  }
+  threads_native_join(child, &result);
+  return result;
+}
+
+constexpr int yield_rounds = 1000;
+std::atomic<int> yield_turn{0};
+
+// Takes every other turn with a second ULT, which only ever moves on if
+// yield lets the other one run, on this worker or another
+void *take_turns(void *arg) {
+  int me = (int)(intptr_t)arg;
+  for (int round = 0; round < yield_rounds; ++round) {
+    while (me != yield_turn % 2) {
+      threads_native_yield();
+    }
+    ++yield_turn;
+  }
+  return nullptr;
+}
+
+struct parker {
+  threads_native_ult_t *ult = nullptr;
+  std::atomic<bool> ready{false};
+  std::atomic<bool> released{false};
+};
+
+void *park_until_released(void *arg) {
+  auto *p = static_cast<parker *>(arg);
+  p->ult = threads_native_self();
+  p->ready = true;
+  while (!p->released) {
+    threads_native_park();
+  }
+  return arg;
+}
+
+void unpark(parker *p) {
+  while (!p->ready) {
+    threads_native_yield();
+  }
+  p->released = true;
+  threads_native_unpark(p->ult);
+}
+
+void *unpark_entry(void *arg) {
+  unpark(static_cast<parker *>(arg));
+  return nullptr;
+}
+
+thread_internal_mutex_t count_lock = THREAD_INTERNAL_MUTEX_INITIALIZER;
+long count = 0;
+
+void *count_up(void *) {
+  for (int i = 0; i < 10000; ++i) {
+    thread_internal_mutex_lock(&count_lock);
+    ++count;
+    if (0 == i % 64) {
+      // hold the lock across a switch now and then
+      threads_native_yield();
+    }
+    thread_internal_mutex_unlock(&count_lock);
+  }
+  return nullptr;
+}
+
+struct queue_state {
+  thread_internal_mutex_t lock = THREAD_INTERNAL_MUTEX_INITIALIZER;
+  thread_internal_cond_t cond = THREAD_INTERNAL_COND_INITIALIZER;
+  long items = 0;
+  long consumed = 0;
+};
+
+constexpr int queue_items = 10000;
+
+void *produce(void *arg) {
+  auto *q = static_cast<queue_state *>(arg);
+  for (int i = 0; i < queue_items; ++i) {
+    thread_internal_mutex_lock(&q->lock);
+    ++q->items;
+    thread_internal_cond_signal(&q->cond);
+    thread_internal_mutex_unlock(&q->lock);
+  }
+  return nullptr;
+}
+
+void *consume(void *arg) {
+  auto *q = static_cast<queue_state *>(arg);
+  for (int i = 0; i < queue_items; ++i) {
+    thread_internal_mutex_lock(&q->lock);
+    while (0 == q->items) {
+      thread_internal_cond_wait(&q->cond, &q->lock);
+    }
+    --q->items;
+    ++q->consumed;
+    thread_internal_mutex_unlock(&q->lock);
+  }
+  return nullptr;
+}
+
+struct timed_state {
+  thread_internal_mutex_t lock = THREAD_INTERNAL_MUTEX_INITIALIZER;
+  thread_internal_cond_t cond = THREAD_INTERNAL_COND_INITIALIZER;
+  bool ready = false;
+  int timedout = -1;
+  // rounds the ticker got in while the waiter was blocked
+  std::atomic<long> ticks{0};
+  std::atomic<bool> done{false};
+};
+
+timespec deadline_in(long ms) {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ++ts.tv_sec;
+    ts.tv_nsec -= 1000000000;
+  }
+  return ts;
+}
+
+void *timed_wait(void *arg) {
+  auto *t = static_cast<timed_state *>(arg);
+  timespec deadline = deadline_in(20);
+  thread_internal_mutex_lock(&t->lock);
+  t->timedout = 0;
+  while (!t->ready && 0 == t->timedout) {
+    t->timedout = thread_internal_cond_timedwait(&t->cond, &t->lock, &deadline);
+  }
+  thread_internal_mutex_unlock(&t->lock);
+  t->done = true;
+  return nullptr;
+}
+
+void *tick(void *arg) {
+  auto *t = static_cast<timed_state *>(arg);
+  while (!t->done) {
+    ++t->ticks;
+    threads_native_yield();
+  }
+  return nullptr;
+}
+
+} // namespace
+
+TEST_F(Native, SpawnJoin) {
+  threads_native_ult_t *ults[64];
+  for (intptr_t i = 0; i < 64; ++i) {
+    ASSERT_EQ(SUCCESS, threads_native_spawn(echo, (void *)i, &ults[i]));
+  }
+  for (intptr_t i = 0; i < 64; ++i) {
+    void *result = nullptr;
+    EXPECT_EQ(SUCCESS, threads_native_join(ults[i], &result));
+    EXPECT_EQ((void *)i, result);
+  }
+}
+
+TEST_F(Native, SpawnFromULT) {
+  threads_native_ult_t *ults[32];
+  for (intptr_t i = 0; i < 32; ++i) {
+    ASSERT_EQ(SUCCESS,
+              threads_native_spawn(spawn_echo, (void *)(i + 1), &ults[i]));
+  }
+  for (intptr_t i = 0; i < 32; ++i) {
+    void *result = nullptr;
+    threads_native_join(ults[i], &result);
+    EXPECT_EQ((void *)(i + 1), result);
+  }
+}
+
+TEST_F(Native, Yield) {
+  threads_native_ult_t *ults[2];
+  yield_turn = 0;
+  for (intptr_t i = 0; i < 2; ++i) {
+    ASSERT_EQ(SUCCESS, threads_native_spawn(take_turns, (void *)i, &ults[i]));
+  }
+  for (auto *ult : ults) {
+    threads_native_join(ult, nullptr);
+  }
+  EXPECT_EQ(2 * yield_rounds, yield_turn.load());
+}
+
+// An unpark that comes before the park is not lost
+TEST_F(Native, UnparkBeforePark) {
+  threads_native_ult_t *self = threads_native_self();
+  threads_native_unpark(self);
+  threads_native_park();
+  SUCCEED();
+}
+
+// Parked ULTs spread over the workers, woken by ULTs that may run on any
+// worker and by a thread foreign to the scheduler
+TEST_F(Native, UnparkAcrossWorkers) {
+  constexpr int n = 16;
+  for (int round = 0; round < 20; ++round) {
+    parker parkers[n];
+    threads_native_ult_t *ults[2 * n];
+    for (int i = 0; i < n; ++i) {
+      ASSERT_EQ(SUCCESS, threads_native_spawn(park_until_released,
+                                              &parkers[i], &ults[i]));
+    }
+    for (int i = 0; i < n / 2; ++i) {
+      ASSERT_EQ(SUCCESS,
+                threads_native_spawn(unpark_entry, &parkers[i], &ults[n + i]));
+    }
+    std::thread foreign([&] {
+      for (int i = n / 2; i < n; ++i) {
+        unpark(&parkers[i]);
+      }
+    });
+    for (int i = 0; i < n; ++i) {
+      void *result = nullptr;
+      threads_native_join(ults[i], &result);
+      EXPECT_EQ(&parkers[i], result);
+    }
+    for (int i = 0; i < n / 2; ++i) {
+      threads_native_join(ults[n + i], nullptr);
+    }
+    foreign.join();
+  }
+}
+
+TEST_F(Native, Mutex) {
+  threads_native_ult_t *ults[8];
+  count = 0;
+  for (auto *&ult : ults) {
+    ASSERT_EQ(SUCCESS, threads_native_spawn(count_up, nullptr, &ult));
+  }
+  for (auto *ult : ults) {
+    threads_native_join(ult, nullptr);
+  }
+  EXPECT_EQ(8 * 10000, count);
+}
+
+TEST_F(Native, Condition) {
+  queue_state q;
+  threads_native_ult_t *ults[8];
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_EQ(SUCCESS, threads_native_spawn(produce, &q, &ults[i]));
+    ASSERT_EQ(SUCCESS, threads_native_spawn(consume, &q, &ults[4 + i]));
+  }
+  for (auto *ult : ults) {
+    threads_native_join(ult, nullptr);
+  }
+  EXPECT_EQ(0, q.items);
+  EXPECT_EQ(4 * queue_items, q.consumed);
+}
+
+// A timed wait nobody signals times out at its deadline, parked rather
+// than keeping its worker from the ULTs queued behind it
+TEST_F(Native, TimedWaitTimesOut) {
+  timed_state t;
+  threads_native_ult_t *ults[2];
+  timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  ASSERT_EQ(SUCCESS, threads_native_spawn(timed_wait, &t, &ults[0]));
+  ASSERT_EQ(SUCCESS, threads_native_spawn(tick, &t, &ults[1]));
+  for (auto *ult : ults) {
+    threads_native_join(ult, nullptr);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  EXPECT_EQ(1, t.timedout);
+  EXPECT_LE(20 * 1000000L, (end.tv_sec - start.tv_sec) * 1000000000L +
+                               (end.tv_nsec - start.tv_nsec));
+  EXPECT_LT(0, t.ticks.load());
+}
+
+// A signal before the deadline ends the wait, and the timer it armed
+// does not outlive it
+TEST_F(Native, TimedWaitSignaled) {
+  for (int round = 0; round < 50; ++round) {
+    timed_state t;
+    threads_native_ult_t *ult;
+    ASSERT_EQ(SUCCESS, threads_native_spawn(timed_wait, &t, &ult));
+    thread_internal_mutex_lock(&t.lock);
+    t.ready = true;
+    thread_internal_cond_signal(&t.cond);
+    thread_internal_mutex_unlock(&t.lock);
+    threads_native_join(ult, nullptr);
+    EXPECT_EQ(0, t.timedout);
+  }
+}
+
+// A key created in the slot of a deleted one reads NULL, not the value
+// the deleted key left there, and runs its destructor on its own values
+// only
+TEST_F(Native, TSDSlotReuse) {
+  static std::atomic<int> destroyed{0};
+  auto destructor = [](void *) { ++destroyed; };
+  tsd_key_t first, second;
+  void *value = nullptr;
+
+  ASSERT_EQ(SUCCESS, tsd_key_create(&first, destructor));
+  EXPECT_EQ(SUCCESS, tsd_set(first, &first));
+  EXPECT_EQ(SUCCESS, tsd_key_delete(first));
+  ASSERT_EQ(SUCCESS, tsd_key_create(&second, destructor));
+  EXPECT_EQ(SUCCESS, tsd_get(second, &value));
+  EXPECT_EQ(nullptr, value);
+  EXPECT_EQ(ERR_BAD_PARAM, tsd_key_delete(first));
+
+  threads_native_ult_t *ult;
+  destroyed = 0;
+  ASSERT_EQ(SUCCESS, threads_native_spawn(
+                         [](void *arg) -> void * {
+                           tsd_key_t key = *static_cast<tsd_key_t *>(arg);
+                           void *value = nullptr;
+                           tsd_get(key, &value);
+                           tsd_set(key, arg);
+                           return value;
+                         },
+                         &second, &ult));
+  void *result = &result;
+  threads_native_join(ult, &result);
+  EXPECT_EQ(nullptr, result);
+  EXPECT_EQ(1, destroyed.load());
+  EXPECT_EQ(SUCCESS, tsd_key_delete(second));
+}
+
+#endif
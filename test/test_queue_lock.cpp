@@ -0,0 +1,148 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "libult.hpp"
+
+extern "C" {
+#include "mutex.h"
+}
+
+namespace {
+
+constexpr int rounds = 10000;
+
+struct atomic_mutex {
+  explicit atomic_mutex(int kind) {
+    OBJ_CONSTRUCT(&mutex, mutex_t);
+    mutex_atomic_set_kind(&mutex, kind);
+  }
+  ~atomic_mutex() { OBJ_DESTRUCT(&mutex); }
+
+  // Wait until a waiter other than the last one seen queued up
+  intptr_t wait_queued(intptr_t last) {
+    while (last == mutex.m_lock_queue.tail) {
+      std::this_thread::yield();
+    }
+    return mutex.m_lock_queue.tail;
+  }
+
+  mutex_t mutex;
+};
+
+// Nobody ever finds somebody else inside, and no increment is lost
+template <typename Thread> void run_exclusion(int threads, int kind) {
+  atomic_mutex m(kind);
+  long count = 0;
+  std::atomic<int> inside{0};
+  std::atomic<int> overlaps{0};
+
+  std::vector<Thread> workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([&] {
+      for (int round = 0; round < rounds; ++round) {
+        mutex_atomic_lock(&m.mutex);
+        if (0 != inside++) {
+          ++overlaps;
+        }
+        ++count;
+        --inside;
+        mutex_atomic_unlock(&m.mutex);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  EXPECT_EQ(0, overlaps.load());
+  EXPECT_EQ(static_cast<long>(threads) * rounds, count);
+}
+
+// Waiters that queued up one after the other get the lock in that order
+template <typename Thread> void run_fifo(int kind) {
+  constexpr int waiters = 4;
+  atomic_mutex m(kind);
+  std::vector<int> order;
+
+  mutex_atomic_lock(&m.mutex);
+  intptr_t tail = m.mutex.m_lock_queue.tail;
+  std::vector<Thread> threads;
+  for (int i = 0; i < waiters; ++i) {
+    threads.emplace_back([&, i] {
+      mutex_atomic_lock(&m.mutex);
+      order.push_back(i);
+      mutex_atomic_unlock(&m.mutex);
+    });
+    tail = m.wait_queued(tail);
+  }
+  mutex_atomic_unlock(&m.mutex);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3}), order);
+}
+
+// A trylock fails while the lock is held with a waiter queued, and
+// succeeds once the queue drained
+template <typename Thread> void run_trylock_queued(int kind) {
+  atomic_mutex m(kind);
+  std::atomic<bool> acquired{false};
+
+  mutex_atomic_lock(&m.mutex);
+  intptr_t tail = m.mutex.m_lock_queue.tail;
+  Thread waiter([&] {
+    mutex_atomic_lock(&m.mutex);
+    acquired = true;
+    mutex_atomic_unlock(&m.mutex);
+  });
+  m.wait_queued(tail);
+  EXPECT_EQ(1, mutex_atomic_trylock(&m.mutex));
+  mutex_atomic_unlock(&m.mutex);
+  waiter.join();
+  EXPECT_TRUE(acquired.load());
+  EXPECT_EQ(0, mutex_atomic_trylock(&m.mutex));
+  mutex_atomic_unlock(&m.mutex);
+}
+
+} // namespace
+
+// Spinning waiters are kernel threads, no more than there are CPUs, see
+// test_barrier.cpp; the yielding ones may be ULTs
+TEST(QueueLock, ExclusionSpin) {
+  int cpus = static_cast<int>(std::thread::hardware_concurrency());
+  run_exclusion<std::thread>(std::min(std::max(cpus, 2), 8), MUTEX_ATOMIC_QUEUE);
+}
+TEST(QueueLock, ExclusionYield) {
+  run_exclusion<libult::thread>(8, MUTEX_ATOMIC_QUEUE_YIELD);
+}
+
+TEST(QueueLock, FifoSpin) { run_fifo<std::thread>(MUTEX_ATOMIC_QUEUE); }
+TEST(QueueLock, FifoYield) { run_fifo<libult::thread>(MUTEX_ATOMIC_QUEUE_YIELD); }
+
+TEST(QueueLock, TrylockQueuedSpin) {
+  run_trylock_queued<std::thread>(MUTEX_ATOMIC_QUEUE);
+}
+TEST(QueueLock, TrylockQueuedYield) {
+  run_trylock_queued<libult::thread>(MUTEX_ATOMIC_QUEUE_YIELD);
+}
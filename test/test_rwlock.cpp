@@ -0,0 +1,161 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "libult.hpp"
+
+extern "C" {
+#include "rwlock.h"
+}
+
+namespace {
+
+class RWLock : public ::testing::Test {
+protected:
+  void SetUp() override { OBJ_CONSTRUCT(&rw, rwlock_t); }
+  void TearDown() override { OBJ_DESTRUCT(&rw); }
+
+  rwlock_t rw;
+};
+
+} // namespace
+
+// Writers are alone inside, readers only ever share the lock with other
+// readers, and no write is lost
+TEST_F(RWLock, Exclusion) {
+  constexpr int readers = 6;
+  constexpr int writers = 2;
+  constexpr int rounds = 2000;
+  std::atomic<int> readers_in{0};
+  std::atomic<int> writers_in{0};
+  std::atomic<int> overlaps{0};
+  long value = 0;
+
+  std::vector<libult::thread> threads;
+  for (int i = 0; i < writers; ++i) {
+    threads.emplace_back([&] {
+      for (int round = 0; round < rounds; ++round) {
+        rwlock_wrlock(&rw);
+        if (0 != writers_in++ || 0 != readers_in) {
+          ++overlaps;
+        }
+        ++value;
+        --writers_in;
+        rwlock_wrunlock(&rw);
+      }
+    });
+  }
+  for (int i = 0; i < readers; ++i) {
+    threads.emplace_back([&] {
+      for (int round = 0; round < rounds; ++round) {
+        rwlock_rdlock(&rw);
+        ++readers_in;
+        if (0 != writers_in) {
+          ++overlaps;
+        }
+        --readers_in;
+        rwlock_rdunlock(&rw);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(0, overlaps.load());
+  EXPECT_EQ(static_cast<long>(writers) * rounds, value);
+}
+
+TEST_F(RWLock, TryLock) {
+  EXPECT_EQ(0, rwlock_tryrdlock(&rw));
+  EXPECT_EQ(1, rwlock_trywrlock(&rw));
+  rwlock_rdunlock(&rw);
+  EXPECT_EQ(0, rwlock_trywrlock(&rw));
+  EXPECT_EQ(1, rwlock_tryrdlock(&rw));
+  rwlock_wrunlock(&rw);
+  EXPECT_EQ(0, rwlock_tryrdlock(&rw));
+  rwlock_rdunlock(&rw);
+}
+
+// A writer that outwaits its spin blocks until the last reader leaves,
+// and that reader wakes it up
+TEST_F(RWLock, WriterParks) {
+  std::atomic<bool> reader_out{false};
+  std::atomic<bool> early{false};
+
+  rwlock_rdlock(&rw);
+  libult::thread writer([&] {
+    rwlock_wrlock(&rw);
+    if (!reader_out) {
+      early = true;
+    }
+    rwlock_wrunlock(&rw);
+  });
+  while (0 == rw.rw_writer_parked) {
+    std::this_thread::yield();
+  }
+  reader_out = true;
+  rwlock_rdunlock(&rw);
+  writer.join();
+  EXPECT_FALSE(early.load());
+}
+
+// The readers a writer held back all get in before the next writer,
+// even one that was already waiting when the first one left
+TEST_F(RWLock, HeldBackReadersGoFirst) {
+  constexpr int readers = 4;
+  std::atomic<int> sequence{0};
+  std::vector<int> entered(readers, -1);
+  int writer_entered = -1;
+  int still_held_back = -1;
+
+  rwlock_wrlock(&rw);
+  std::vector<libult::thread> threads;
+  for (int i = 0; i < readers; ++i) {
+    threads.emplace_back([&, i] {
+      rwlock_rdlock(&rw);
+      entered[i] = sequence++;
+      rwlock_rdunlock(&rw);
+    });
+  }
+  while (readers != rw.rw_readers_waiting) {
+    std::this_thread::yield();
+  }
+  threads.emplace_back([&] {
+    rwlock_wrlock(&rw);
+    writer_entered = sequence++;
+    still_held_back = rw.rw_readers_waiting;
+    rwlock_wrunlock(&rw);
+  });
+  // give the second writer time to queue up on the first one
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  rwlock_wrunlock(&rw);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(0, still_held_back);
+  for (int i = 0; i < readers; ++i) {
+    EXPECT_LE(0, entered[i]);
+    EXPECT_LT(entered[i], writer_entered);
+  }
+}
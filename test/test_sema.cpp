@@ -0,0 +1,148 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "libult.hpp"
+
+extern "C" {
+#include "sema.h"
+}
+
+namespace {
+
+class Latch : public ::testing::Test {
+protected:
+  void SetUp() override { OBJ_CONSTRUCT(&latch, latch_t); }
+  void TearDown() override { OBJ_DESTRUCT(&latch); }
+
+  latch_t latch;
+};
+
+class Semaphore : public ::testing::Test {
+protected:
+  void SetUp() override { OBJ_CONSTRUCT(&sem, semaphore_t); }
+  void TearDown() override { OBJ_DESTRUCT(&sem); }
+
+  semaphore_t sem;
+};
+
+} // namespace
+
+TEST_F(Latch, OpenRightAway) {
+  latch_set(&latch, 0);
+  EXPECT_TRUE(latch_try_wait(&latch));
+  latch_wait(&latch);
+}
+
+// Waiters only return once the last count down came, and all of them
+// return, whether they found it open, polled or blocked
+TEST_F(Latch, Release) {
+  constexpr int waiters = 8;
+  constexpr int counts = 4;
+  std::atomic<int> counted{0};
+  std::atomic<int> released{0};
+  std::atomic<int> early{0};
+
+  latch_set(&latch, counts);
+  std::vector<libult::thread> threads;
+  for (int i = 0; i < waiters; ++i) {
+    threads.emplace_back([&] {
+      latch_wait(&latch);
+      if (counts != counted) {
+        ++early;
+      }
+      ++released;
+    });
+  }
+  for (int i = 0; i < counts; ++i) {
+    threads.emplace_back([&] {
+      ++counted;
+      latch_count_down(&latch, 1);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_TRUE(latch_try_wait(&latch));
+  EXPECT_EQ(0, early.load());
+  EXPECT_EQ(waiters, released.load());
+}
+
+// A waiter may tear the latch down as soon as it returns, even though
+// it blocked and the last count down still has to wake it up (run it
+// under AddressSanitizer to catch a count down that comes back to the
+// latch)
+TEST(LatchLifetime, WaiterDestroysLatch) {
+  for (int round = 0; round < 100; ++round) {
+    auto *latch = new latch_t;
+    OBJ_CONSTRUCT(latch, latch_t);
+    latch_set(latch, 1);
+
+    libult::thread waiter([=] {
+      latch_wait(latch);
+      OBJ_DESTRUCT(latch);
+      delete latch;
+    });
+    libult::thread counter([=] {
+      // long enough for the waiter to give up polling and block
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      latch_count_down(latch, 1);
+    });
+    counter.join();
+    waiter.join();
+  }
+}
+
+TEST_F(Semaphore, TryWait) {
+  semaphore_set(&sem, 1);
+  EXPECT_EQ(0, semaphore_trywait(&sem));
+  EXPECT_EQ(1, semaphore_trywait(&sem));
+  semaphore_post(&sem);
+  EXPECT_EQ(0, semaphore_trywait(&sem));
+}
+
+// Every post lets exactly one wait through
+TEST_F(Semaphore, PostWakesWaiters) {
+  constexpr int waiters = 8;
+  constexpr int rounds = 1000;
+  std::atomic<int> taken{0};
+
+  std::vector<libult::thread> threads;
+  for (int i = 0; i < waiters; ++i) {
+    threads.emplace_back([&] {
+      for (int round = 0; round < rounds; ++round) {
+        semaphore_wait(&sem);
+        ++taken;
+      }
+    });
+  }
+  for (int i = 0; i < waiters * rounds; ++i) {
+    semaphore_post(&sem);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(waiters * rounds, taken.load());
+  EXPECT_EQ(1, semaphore_trywait(&sem));
+}
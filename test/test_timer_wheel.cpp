@@ -0,0 +1,136 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "libult.hpp"
+
+extern "C" {
+#include "mutex.h"
+#include "timer_wheel.h"
+}
+
+namespace {
+
+constexpr uint64_t ms = 1000000;
+
+struct timed_mutex {
+  timed_mutex() { OBJ_CONSTRUCT(&mutex, mutex_t); }
+  ~timed_mutex() { OBJ_DESTRUCT(&mutex); }
+
+  // Wait until a caller of mutex_timedlock parked on the mutex
+  void wait_parked() {
+    while (NULL == mutex.m_timed_head) {
+      std::this_thread::yield();
+    }
+  }
+
+  mutex_t mutex;
+};
+
+} // namespace
+
+TEST(MutexTimedLock, FreeMutex) {
+  timed_mutex m;
+  // even past the deadline, a free mutex is taken
+  EXPECT_EQ(SUCCESS, mutex_timedlock(&m.mutex, ult_timer_now() - ms));
+  mutex_unlock(&m.mutex);
+}
+
+TEST(MutexTimedLock, TimesOutWhileHeld) {
+  timed_mutex m;
+  std::atomic<int> rc{SUCCESS};
+  std::atomic<uint64_t> waited{0};
+
+  mutex_lock(&m.mutex);
+  libult::thread waiter([&] {
+    uint64_t start = ult_timer_now();
+    rc = mutex_timedlock(&m.mutex, start + 20 * ms);
+    waited = ult_timer_now() - start;
+  });
+  waiter.join();
+  mutex_unlock(&m.mutex);
+  EXPECT_EQ(ERR_TIMEOUT, rc.load());
+  EXPECT_GE(waited.load(), 20 * ms - ULT_TIMER_TICK_NS);
+  EXPECT_EQ(nullptr, m.mutex.m_timed_head);
+}
+
+// The unlock wakes a parked waiter, long before its deadline
+TEST(MutexTimedLock, WokenByUnlock) {
+  timed_mutex m;
+  std::atomic<int> rc{ERR_TIMEOUT};
+  std::atomic<uint64_t> waited{0};
+
+  mutex_lock(&m.mutex);
+  libult::thread waiter([&] {
+    uint64_t start = ult_timer_now();
+    rc = mutex_timedlock(&m.mutex, start + 60000 * ms);
+    waited = ult_timer_now() - start;
+    mutex_unlock(&m.mutex);
+  });
+  m.wait_parked();
+  mutex_unlock(&m.mutex);
+  waiter.join();
+  EXPECT_EQ(SUCCESS, rc.load());
+  EXPECT_LT(waited.load(), 30000 * ms);
+  EXPECT_EQ(nullptr, m.mutex.m_timed_head);
+}
+
+// Timed and plain lockers never overlap, and a timed one that gave up
+// leaves nothing queued behind
+TEST(MutexTimedLock, Exclusion) {
+  constexpr int threads = 8;
+  constexpr int rounds = 2000;
+  timed_mutex m;
+  long count = 0;
+  std::atomic<long> expected{0};
+  std::atomic<int> inside{0};
+  std::atomic<int> overlaps{0};
+
+  std::vector<libult::thread> workers;
+  for (int i = 0; i < threads; ++i) {
+    workers.emplace_back([&, i] {
+      for (int round = 0; round < rounds; ++round) {
+        if (0 == (round + i) % 3) {
+          mutex_lock(&m.mutex);
+        } else if (SUCCESS != mutex_timedlock(&m.mutex, ult_timer_now() +
+                                                            (round % 4) * ms)) {
+          continue;
+        }
+        if (0 != inside++) {
+          ++overlaps;
+        }
+        ++count;
+        ++expected;
+        --inside;
+        mutex_unlock(&m.mutex);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  EXPECT_EQ(0, overlaps.load());
+  EXPECT_EQ(expected.load(), count);
+  EXPECT_EQ(nullptr, m.mutex.m_timed_head);
+}
@@ -0,0 +1,141 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "libult.hpp"
+
+extern "C" {
+#include "sema.h"
+#include "tsd.h"
+}
+
+namespace {
+
+std::atomic<int> destroyed{0};
+
+void count_destroyed(void *) { ++destroyed; }
+
+class TrackedKey : public ::testing::Test {
+protected:
+  void SetUp() override {
+    destroyed = 0;
+    OBJ_CONSTRUCT(&key, tsd_tracked_key_t);
+    tsd_tracked_key_set_destructor(&key, count_destroyed);
+  }
+  void TearDown() override {
+    if (constructed) {
+      OBJ_DESTRUCT(&key);
+    }
+  }
+
+  int chunks() const {
+    int n = 0;
+    for (auto *chunk = reinterpret_cast<tsd_list_chunk_t *>(key.chunks);
+         nullptr != chunk; chunk = chunk->next) {
+      ++n;
+    }
+    return n;
+  }
+
+  // Runs threads that all set the key at the same time, then exit as
+  // soon as released() is called
+  void run_together(int threads, const std::function<void()> &released = {}) {
+    latch_t set, go;
+    OBJ_CONSTRUCT(&set, latch_t);
+    OBJ_CONSTRUCT(&go, latch_t);
+    latch_set(&set, threads);
+    latch_set(&go, 1);
+    std::vector<libult::thread> running;
+    for (int i = 0; i < threads; ++i) {
+      running.emplace_back([&] {
+        EXPECT_EQ(SUCCESS, tsd_tracked_key_set(&key, &key));
+        latch_count_down(&set, 1);
+        latch_wait(&go);
+      });
+    }
+    latch_wait(&set);
+    latch_count_down(&go, 1);
+    if (released) {
+      released();
+    }
+    for (auto &thread : running) {
+      thread.join();
+    }
+    OBJ_DESTRUCT(&go);
+    OBJ_DESTRUCT(&set);
+  }
+
+  tsd_tracked_key_t key;
+  bool constructed = true;
+};
+
+} // namespace
+
+// Threads that come and go one after the other keep claiming back the
+// item the previous one freed, the registry does not grow
+TEST_F(TrackedKey, ChurnReusesItems) {
+  constexpr int rounds = 3 * TSD_TRACKED_KEY_CHUNK;
+  for (int round = 0; round < rounds; ++round) {
+    libult::thread thread([&] {
+      void *value = &value;
+      EXPECT_EQ(SUCCESS, tsd_tracked_key_get(&key, &value));
+      EXPECT_EQ(nullptr, value);
+      EXPECT_EQ(SUCCESS, tsd_tracked_key_set(&key, &key));
+    });
+    thread.join();
+    EXPECT_LE(0, key.free_items);
+  }
+  EXPECT_EQ(rounds, destroyed.load());
+  EXPECT_EQ(1, chunks());
+}
+
+// More threads at once than a chunk holds grow the registry by whole
+// chunks, which the next generation of threads reuses
+TEST_F(TrackedKey, ChunkGrowth) {
+  constexpr int threads = 2 * TSD_TRACKED_KEY_CHUNK + 1;
+  run_together(threads);
+  EXPECT_EQ(threads, destroyed.load());
+  EXPECT_EQ(3, chunks());
+  EXPECT_EQ(3 * TSD_TRACKED_KEY_CHUNK, key.free_items);
+
+  run_together(threads);
+  EXPECT_EQ(2 * threads, destroyed.load());
+  EXPECT_EQ(3, chunks());
+}
+
+// Threads exiting while the key is torn down race the teardown for
+// their items: every value is destroyed exactly once, by one or the
+// other
+TEST_F(TrackedKey, ExitRacesTeardown) {
+  constexpr int threads = 8;
+  for (int round = 0; round < 50; ++round) {
+    if (0 != round) {
+      destroyed = 0;
+      OBJ_CONSTRUCT(&key, tsd_tracked_key_t);
+      tsd_tracked_key_set_destructor(&key, count_destroyed);
+    }
+    run_together(threads, [&] { OBJ_DESTRUCT(&key); });
+    EXPECT_EQ(threads, destroyed.load());
+  }
+  constructed = false;
+}
@@ -0,0 +1,124 @@
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 4.0
+//       Copyright (2022) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Part of Kokkos, under the Apache License v2.0 with LLVM Exceptions.
+// See https://kokkos.org/LICENSE for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+// Contact: Jan Ciesko (jciesko@sandia.gov)
+//
+//@HEADER
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+extern "C" {
+#include "wait_sync.h"
+}
+
+namespace {
+
+class WaitSync : public ::testing::Test {
+protected:
+  void SetUp() override { set_using_threads(true); }
+};
+
+} // namespace
+
+// A completion that arrives after an error completed the sync must not
+// borrow from the flag bits
+TEST_F(WaitSync, ErrorThenSuccess) {
+  ompi_wait_sync_t sync;
+  WAIT_SYNC_INIT(&sync, 2);
+  wait_sync_update(&sync, 0, ERROR);
+  EXPECT_EQ(0, wait_sync_count(&sync));
+  wait_sync_update(&sync, 1, SUCCESS);
+  EXPECT_EQ(0, sync.state);
+  EXPECT_EQ(ERROR, SYNC_WAIT(&sync));
+}
+
+TEST_F(WaitSync, CountSaturatesAtZero) {
+  ompi_wait_sync_t sync;
+  WAIT_SYNC_INIT(&sync, 1);
+  wait_sync_update(&sync, 3, SUCCESS);
+  EXPECT_EQ(0, sync.state);
+  wait_sync_update(&sync, 0, SUCCESS);
+  EXPECT_EQ(0, sync.state);
+  EXPECT_EQ(SUCCESS, SYNC_WAIT(&sync));
+}
+
+// Two waiters, so that one of them parks while the other polls, then
+// error-then-success on both and late updates after they returned
+TEST_F(WaitSync, ErrorThenSuccessWithWaiters) {
+  for (int round = 0; round < 100; ++round) {
+    ompi_wait_sync_t syncs[2];
+    std::atomic<int> returned{0};
+    WAIT_SYNC_INIT(&syncs[0], 2);
+    WAIT_SYNC_INIT(&syncs[1], 2);
+    std::thread waiters[2];
+    for (int i = 0; i < 2; ++i) {
+      waiters[i] = std::thread([&, i] {
+        EXPECT_EQ(ERROR, SYNC_WAIT(&syncs[i]));
+        ++returned;
+      });
+    }
+    std::this_thread::yield();
+    for (int i = 0; i < 2; ++i) {
+      wait_sync_update(&syncs[i], 0, ERROR);
+      wait_sync_update(&syncs[i], 1, SUCCESS);
+    }
+    for (auto &waiter : waiters) {
+      waiter.join();
+    }
+    EXPECT_EQ(2, returned.load());
+    for (int i = 0; i < 2; ++i) {
+      wait_sync_update(&syncs[i], 1, SUCCESS);
+      EXPECT_EQ(0, wait_sync_count(&syncs[i]));
+      EXPECT_EQ(nullptr, syncs[i].waiter);
+    }
+  }
+}
+
+// An error that arrives after the sync completed must not rewrite the
+// status the waiter returned on
+TEST_F(WaitSync, LateErrorKeepsStatus) {
+  ompi_wait_sync_t sync;
+  WAIT_SYNC_INIT(&sync, 1);
+  wait_sync_update(&sync, 1, SUCCESS);
+  EXPECT_EQ(SUCCESS, SYNC_WAIT(&sync));
+  wait_sync_update(&sync, 0, ERROR);
+  EXPECT_EQ(SUCCESS, sync.status);
+  EXPECT_EQ(0, sync.state);
+}
+
+// An error racing with the last successful update: whichever completes
+// the sync, the waiter returns the status the sync keeps
+TEST_F(WaitSync, ErrorRacingCompletion) {
+  for (int round = 0; round < 1000; ++round) {
+    ompi_wait_sync_t sync;
+    std::atomic<bool> go{false};
+    int returned = SUCCESS;
+    WAIT_SYNC_INIT(&sync, 1);
+    std::thread waiter([&] { returned = SYNC_WAIT(&sync); });
+    std::thread failer([&] {
+      while (!go) {
+      }
+      wait_sync_update(&sync, 0, ERROR);
+    });
+    go = true;
+    wait_sync_update(&sync, 1, SUCCESS);
+    waiter.join();
+    failer.join();
+    EXPECT_EQ(returned, sync.status);
+    EXPECT_EQ(0, sync.state);
+  }
+}